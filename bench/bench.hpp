@@ -0,0 +1,127 @@
+#ifndef __BENCH__
+#define __BENCH__
+
+/**
+ * @file bench.hpp
+ * @brief Helpers shared by the benchmark programs: options, connecting to the
+ * AS and reporting the latencies measured.
+ */
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "shared/config.hpp"
+
+typedef std::chrono::steady_clock BenchClock;
+
+/**
+ * @brief  Milliseconds elapsed since a point in time.
+ * @param  start: The point in time.
+ * @retval The milliseconds elapsed.
+ */
+inline double elapsed_ms(BenchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start)
+	    .count();
+}
+
+/**
+ * @brief  Runs a measurement a number of times and keeps the lowest result,
+ * the run least disturbed by the rest of the machine.
+ * @param  runs: Number of runs.
+ * @param  measure: Returns the result of a run.
+ * @retval The lowest result.
+ */
+template <typename Measure>
+double best_of(int runs, Measure measure) {
+	double best = measure();
+	for (int i = 1; i < runs; i++) {
+		best = std::min(best, measure());
+	}
+	return best;
+}
+
+/**
+ * @brief  Parses a positive number given as an option, exiting if it isn't.
+ * @param  option: The option's argument.
+ * @retval The number.
+ */
+inline size_t parse_bench_count(const char *option) {
+	char *end;
+	unsigned long count = strtoul(option, &end, 10);
+	if (*option == '\0' || *end != '\0' || count == 0) {
+		fprintf(stderr, "[ERROR] Invalid count: %s\n", option);
+		exit(EXIT_FAILURE);
+	}
+	return count;
+}
+
+/**
+ * @brief  Builds the request sent as the n-th one, replacing "%d" in its
+ * pattern by n, so that requests such as bids can change as they are sent.
+ * The request ends with the protocol delimiter.
+ * @param  pattern: The request, without the delimiter.
+ * @param  n: Number of the request, starting at 1.
+ * @retval The request.
+ */
+inline std::string format_request(const std::string &pattern, size_t n) {
+	std::string request = pattern;
+	size_t at = request.find("%d");
+	if (at != std::string::npos) {
+		request.replace(at, 2, std::to_string(n));
+	}
+	request.push_back('\n');
+	return request;
+}
+
+/**
+ * @brief  Resolves the address of the AS, exiting if it can't.
+ * @param  host: Hostname of the AS.
+ * @param  port: Port of the AS.
+ * @param  type: SOCK_STREAM or SOCK_DGRAM.
+ * @retval The address, to be freed with freeaddrinfo.
+ */
+inline struct addrinfo *resolve_bench_address(const std::string &host,
+                                              const std::string &port,
+                                              int type) {
+	struct addrinfo hints = {};
+	struct addrinfo *address;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = type;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &address) != 0) {
+		fprintf(stderr, "[ERROR] Failed to resolve %s:%s\n", host.c_str(),
+		        port.c_str());
+		exit(EXIT_FAILURE);
+	}
+	return address;
+}
+
+/**
+ * @brief  Prints the throughput and the latency percentiles of a run.
+ * @param  &latencies: Latency of each request answered, in milliseconds.
+ * @param  seconds: Duration of the run.
+ * @param  failed: Requests that got no answer.
+ * @retval None
+ */
+inline void print_bench_latencies(std::vector<double> &latencies,
+                                  double seconds, size_t failed) {
+	if (latencies.empty()) {
+		printf("no answers, %zu failed\n", failed);
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	size_t count = latencies.size();
+	printf("%zu answers in %.2f s: %.0f/s, p50 %.3f ms, p99 %.3f ms, "
+	       "%zu failed\n",
+	       count, seconds, (double) count / seconds, latencies[count / 2],
+	       latencies[count * 99 / 100], failed);
+}
+
+#endif
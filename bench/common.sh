@@ -0,0 +1,38 @@
+# Sourced by the benchmark scripts, which are run from the repository root
+# once `make` and `make bench` are done.
+
+PORT=${PORT:-58099}
+ROOT=$(pwd)
+AS=${AS:-$ROOT/AS}  # Another build can be given to compare with
+SERVER_DIR=$(mktemp -d)
+trap 'stop_server; rm -rf "$SERVER_DIR"' EXIT
+
+# start_server <AS options>: starts the AS with an empty database, in a process
+# group of its own
+start_server() {
+	stop_server
+	rm -rf "${SERVER_DIR:?}"/*
+	(cd "$SERVER_DIR" &&
+		exec setsid "$AS" -p "$PORT" "$@" >/dev/null 2>&1) &
+	SERVER_PID=$!
+	sleep 0.5
+}
+
+# stop_server: stops the AS started last, with its child processes
+stop_server() {
+	if [ -n "$SERVER_PID" ]; then
+		kill -INT -- "-$SERVER_PID" 2>/dev/null
+		sleep 0.5
+		kill -KILL -- "-$SERVER_PID" 2>/dev/null
+		wait "$SERVER_PID" 2>/dev/null
+		SERVER_PID=
+	fi
+}
+
+tcp_bench() {
+	"$ROOT/bench/tcp_bench" -p "$PORT" "$@"
+}
+
+udp_bench() {
+	"$ROOT/bench/udp_bench" -p "$PORT" "$@"
+}
@@ -0,0 +1,150 @@
+/**
+ * @file dispatch.cpp
+ * @brief Measures the cost of routing a request to its handler, as
+ * RequestManager::callHandlerRequest does with a switch on the packed code,
+ * against the previous lookup of the code's string in an unordered_map of
+ * handler objects followed by a virtual call. The handlers only count the
+ * requests, so only the routing is measured.
+ *
+ * Usage: dispatch
+ */
+#include <memory>
+#include <unordered_map>
+
+#include "bench.hpp"
+#include "server/handlers.hpp"
+#include "shared/protocol.hpp"
+
+#define DISPATCH_RUNS       5
+#define DISPATCH_ITERATIONS 10000000
+
+static const char *dispatch_codes[] = {
+	CODE_LOGIN_USER,        CODE_LOGOUT_USER,      CODE_UNREGISTER_USER,
+	CODE_LIST_ALLAUC_USER,  CODE_LIST_MYB_USER,    CODE_LIST_AUC_USER,
+	CODE_SHOWREC_USER,      CODE_OPEN_AUC_CLIENT,  CODE_CLOSE_AUC_CLIENT,
+	CODE_SHOW_ASSET_CLIENT, CODE_BID_CLIENT,       CODE_SESSION_CLIENT,
+	"XYZ"};
+#define DISPATCH_CODES (sizeof(dispatch_codes) / sizeof(dispatch_codes[0]))
+
+static uint64_t handled[DISPATCH_CODES];
+
+/**
+ * @brief  Stands for a handler, in the switch.
+ * @param  &message: The request.
+ * @retval None
+ */
+template <size_t Index>
+static void count_request(MessageAdapter &message) {
+	(void) message;
+	handled[Index]++;
+}
+
+/**
+ * @brief  Stands for a handler, in the unordered_map, as the handlers were
+ * objects registered by their code.
+ */
+class CountingHandler {
+   public:
+	size_t index;
+	explicit CountingHandler(size_t i) : index(i) {}
+	virtual ~CountingHandler() = default;
+	virtual void handle(MessageAdapter &message) {
+		(void) message;
+		handled[index]++;
+	}
+};
+
+/**
+ * @brief  Routes a request with a switch on its packed code, as
+ * RequestManager::callHandlerRequest does.
+ * @param  &message: The request.
+ * @retval None
+ */
+static void route_switch(MessageAdapter &message) {
+	switch (read_protocol_code(message)) {
+		case LoginRequest::code:
+			count_request<0>(message);
+			break;
+		case LogoutRequest::code:
+			count_request<1>(message);
+			break;
+		case UnregisterRequest::code:
+			count_request<2>(message);
+			break;
+		case ListAllAuctionsRequest::code:
+			count_request<3>(message);
+			break;
+		case ListBiddedAuctionsRequest::code:
+			count_request<4>(message);
+			break;
+		case ListStartedAuctionsRequest::code:
+			count_request<5>(message);
+			break;
+		case ShowRecordRequest::code:
+			count_request<6>(message);
+			break;
+		case OpenAuctionRequest::code:
+			count_request<7>(message);
+			break;
+		case CloseAuctionRequest::code:
+			count_request<8>(message);
+			break;
+		case ShowAssetRequest::code:
+			count_request<9>(message);
+			break;
+		case BidRequest::code:
+			count_request<10>(message);
+			break;
+		case OpenSessionRequest::code:
+			count_request<11>(message);
+			break;
+		default:
+			count_request<12>(message);
+			break;
+	}
+}
+
+/**
+ * @brief  Times routing every code in turn.
+ * @param  route: Routes a request.
+ * @retval Nanoseconds per request.
+ */
+template <typename Route>
+static double time_dispatch(Route route) {
+	double ms = best_of(DISPATCH_RUNS, [&route] {
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < DISPATCH_ITERATIONS; i++) {
+			BufferMessage message(dispatch_codes[i % DISPATCH_CODES],
+			                      PROTOCOL_SIZE);
+			route(message);
+		}
+		return elapsed_ms(start);
+	});
+	return ms * 1000000 / DISPATCH_ITERATIONS;
+}
+
+int main() {
+	std::unordered_map<std::string, std::shared_ptr<CountingHandler>> handlers;
+	for (size_t i = 0; i + 1 < DISPATCH_CODES; i++) {
+		handlers.insert({dispatch_codes[i],
+		                 std::make_shared<CountingHandler>(i)});
+	}
+	std::shared_ptr<CountingHandler> wrong =
+		std::make_shared<CountingHandler>(DISPATCH_CODES - 1);
+
+	double map_ns = time_dispatch([&handlers, &wrong](MessageAdapter &message) {
+		std::string code = message.getn(PROTOCOL_SIZE);
+		auto handler = handlers.find(code);
+		if (handler == handlers.end()) {
+			wrong->handle(message);
+		} else {
+			handler->second->handle(message);
+		}
+	});
+	double switch_ns = time_dispatch(route_switch);
+
+	printf("getn, unordered_map and virtual call: %5.1f ns/request\n", map_ns);
+	printf("read_protocol_code and switch:        %5.1f ns/request\n",
+	       switch_ns);
+	return handled[0] == 0;
+}
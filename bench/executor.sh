@@ -0,0 +1,30 @@
+#!/bin/bash
+# Answers per second and latency of a mixed LST/SRC/BID workload with the
+# handlers run by the I/O threads, then by 1 to <threads> handler threads
+# (-x), doubling each time. The UDP and TCP clients run at once.
+# Usage: bench/executor.sh [threads] [requests]
+
+. "$(dirname "$0")/common.sh"
+
+THREADS=${1:-$(nproc)}
+REQUESTS=${2:-50000}
+
+# No -x first, the I/O threads run the handlers
+OPTIONS=("")
+for ((threads = 1; threads <= THREADS; threads *= 2)); do
+	OPTIONS+=("-x $threads")
+done
+
+for option in "${OPTIONS[@]}"; do
+	start_server $option
+	udp_bench -c 1 -r 2 "LIN 100001 password" "LIN 100002 password" >/dev/null
+	tcp_bench -c 1 -r 1 "OPA 100001 password car 100 99999 car.txt 1 c" \
+		>/dev/null
+	udp_bench -c 16 -r "$REQUESTS" "LST" "SRC 001" >"$SERVER_DIR.udp" &
+	tcp_bench -c 16 -r "$REQUESTS" -k "BID 100002 password 001 %d" \
+		>"$SERVER_DIR.tcp"
+	wait %%
+	printf '%-6s LST/SRC %s\n' "${option:-inline}" "$(cat "$SERVER_DIR.udp")"
+	printf '%-6s BID     %s\n' "${option:-inline}" "$(cat "$SERVER_DIR.tcp")"
+done
+rm -f "$SERVER_DIR.udp" "$SERVER_DIR.tcp"
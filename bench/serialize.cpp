@@ -0,0 +1,127 @@
+/**
+ * @file serialize.cpp
+ * @brief Measures the time taken to serialize each answer of the server into
+ * a MessageWriter, as the handlers do before sending it.
+ *
+ * Usage: serialize
+ */
+#include <string.h>
+
+#include "bench.hpp"
+#include "shared/protocol.hpp"
+
+#define SERIALIZE_RUNS       5
+#define SERIALIZE_ITERATIONS 200000
+
+static size_t sink = 0;  // Keeps the messages from being optimized away
+
+/**
+ * @brief  Prints the time taken to serialize a message.
+ * @param  *name: Name of the case.
+ * @param  &message: The message, with its fields set.
+ * @retval None
+ */
+static void bench_serialize(const char *name, ProtocolMessage &message) {
+	double ms = best_of(SERIALIZE_RUNS, [&message] {
+		BenchClock::time_point start = BenchClock::now();
+		for (int i = 0; i < SERIALIZE_ITERATIONS; i++) {
+			char buffer[MESSAGE_BUFFER_LEN];
+			MessageWriter writer(buffer, sizeof(buffer));
+			message.buildMessage(writer);
+			sink += writer.size() + (size_t) buffer[0];
+		}
+		return elapsed_ms(start);
+	});
+	printf("%-24s %6.0f ns/message\n", name,
+	       ms * 1000000 / SERIALIZE_ITERATIONS);
+}
+
+/**
+ * @brief  Lists auctions as the database does, "AID state".
+ * @param  count: Number of auctions.
+ * @retval The auctions.
+ */
+static std::vector<std::string> list_auctions(int count) {
+	std::vector<std::string> auctions;
+	for (int i = 1; i <= count; i++) {
+		char auction[AUCTION_ID_SIZE + 3];
+		snprintf(auction, sizeof(auction), "%03d %d", i, i % 2);
+		auctions.push_back(auction);
+	}
+	return auctions;
+}
+
+int main() {
+	Datetime date = {"2024", "01", "15", "12", "30", "45"};
+
+	ServerLoginUser rli;
+	rli.status = ServerLoginUser::status::OK;
+	bench_serialize("RLI OK", rli);
+
+	ServerLogout rlo;
+	rlo.status = ServerLogout::status::OK;
+	bench_serialize("RLO OK", rlo);
+
+	ServerUnregister rur;
+	rur.status = ServerUnregister::status::OK;
+	bench_serialize("RUR OK", rur);
+
+	ServerOpenAuction roa;
+	roa.status = ServerOpenAuction::status::OK;
+	roa.auction_id = 7;
+	bench_serialize("ROA OK", roa);
+
+	ServerCloseAuction rcl;
+	rcl.status = ServerCloseAuction::status::OK;
+	bench_serialize("RCL OK", rcl);
+
+	ServerListStartedAuctions rma;
+	rma.status = ServerListStartedAuctions::status::OK;
+	rma.auctions = list_auctions(10);
+	bench_serialize("RMA OK (10 auctions)", rma);
+
+	ServerListBiddedAuctions rmb;
+	rmb.status = ServerListBiddedAuctions::status::OK;
+	rmb.auctions = list_auctions(10);
+	bench_serialize("RMB OK (10 auctions)", rmb);
+
+	ServerListAllAuctions rls;
+	rls.status = ServerListAllAuctions::status::OK;
+	rls.auctions = list_auctions(100);
+	bench_serialize("RLS OK (100 auctions)", rls);
+
+	ServerShowRecord rrc;
+	rrc.status = ServerShowRecord::status::OK;
+	rrc.host_UID = 100001;
+	rrc.auction_name = "car";
+	rrc.asset_fname = "car.jpg";
+	rrc.start_value = 100;
+	rrc.start_date_time = date;
+	rrc.timeactive = 600;
+	for (uint32_t i = 0; i < 50; i++) {
+		rrc.bids.push_back(Bid{100002, 200 + i, date, i});
+	}
+	rrc.end_date_time = date;
+	rrc.end_sec_time = 600;
+	bench_serialize("RRC OK (50 bids, ended)", rrc);
+
+	ServerShowAsset rsa;
+	rsa.status = ServerShowAsset::status::OK;
+	rsa.fname = "car.jpg";
+	rsa.fdata = std::string(1024 * 1024, 'x');
+	rsa.fsize = rsa.fdata.size();
+	bench_serialize("RSA OK (1 MiB file)", rsa);
+
+	ServerBid rbd;
+	rbd.status = ServerBid::status::ACC;
+	bench_serialize("RBD ACC", rbd);
+
+	ServerOpenSession rse;
+	rse.status = ServerOpenSession::status::OK;
+	bench_serialize("RSE OK", rse);
+
+	ServerError err;
+	bench_serialize("ERR", err);
+
+	return sink == 0;
+}
@@ -0,0 +1,22 @@
+#!/bin/bash
+# Latency of SRC for an auction with a single bid and for one with <bids>
+# bids, which should be about the same.
+# Usage: bench/show_record.sh [bids] [requests]
+
+. "$(dirname "$0")/common.sh"
+
+BIDS=${1:-100000}
+REQUESTS=${2:-2000}
+
+start_server
+udp_bench -c 1 -r 2 "LIN 100001 password" "LIN 100002 password" >/dev/null
+tcp_bench -c 1 -r 2 "OPA 100001 password car 1 99999 car.txt 1 c" >/dev/null
+tcp_bench -c 1 -r 1 -k "BID 100002 password 001 2" >/dev/null
+# The first bid, 1, isn't above the start value and is refused
+printf 'placing %s bids: ' "$BIDS"
+tcp_bench -c 1 -r $((BIDS + 1)) -k "BID 100002 password 002 %d"
+
+printf 'SRC, 1 bid:       '
+udp_bench -c 1 -r "$REQUESTS" "SRC 001"
+printf 'SRC, %s bids: ' "$BIDS"
+udp_bench -c 1 -r "$REQUESTS" "SRC 002"
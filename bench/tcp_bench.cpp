@@ -0,0 +1,193 @@
+/**
+ * @file tcp_bench.cpp
+ * @brief Load generator for the TCP requests of the AS. Each client sends its
+ * requests one after the other, either on a new connection each (as the user
+ * does) or in a session, and the latency of every answer is measured.
+ *
+ * Usage: tcp_bench [-n host] [-p port] [-c clients] [-r requests] [-k]
+ *        request...
+ * The requests are sent in turn, "%d" in a request is replaced by its number.
+ * In a session an answer is read up to the end of a line, so -k is meant for
+ * requests answered in a single line.
+ */
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "bench.hpp"
+
+struct TcpBench {
+	std::string host = DEFAULT_HOSTNAME;
+	std::string port = DEFAULT_PORT;
+	size_t clients = 8;
+	size_t requests = 2000;
+	bool session = false;  // Every request of a client in one connection
+	std::vector<std::string> patterns;
+	struct addrinfo *address = NULL;
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> failed{0};
+};
+
+/**
+ * @brief  Opens a connection to the AS.
+ * @param  &bench: The benchmark.
+ * @retval The socket, -1 if it couldn't connect.
+ */
+static int connect_bench(TcpBench &bench) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		return -1;
+	}
+	if (connect(fd, bench.address->ai_addr, bench.address->ai_addrlen) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * @brief  Sends a whole request.
+ * @param  fd: The connection.
+ * @param  &request: The request.
+ * @retval true if it was sent.
+ */
+static bool send_all(int fd, const std::string &request) {
+	size_t sent = 0;
+	while (sent < request.size()) {
+		ssize_t n = send(fd, request.data() + sent, request.size() - sent,
+		                 MSG_NOSIGNAL);
+		if (n <= 0) {
+			return false;
+		}
+		sent += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+/**
+ * @brief  Reads an answer, up to its delimiter in a session or up to the end
+ * of the connection otherwise.
+ * @param  fd: The connection.
+ * @param  session: Whether the connection is in a session.
+ * @retval true if an answer was read.
+ */
+static bool receive_answer(int fd, bool session) {
+	char buffer[65536];
+	size_t received = 0;
+	while (true) {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0) {
+			return n == 0 && !session && received > 0;
+		}
+		received += static_cast<size_t>(n);
+		if (session && buffer[n - 1] == '\n') {
+			return true;
+		}
+	}
+}
+
+/**
+ * @brief  Sends requests until every request of the benchmark is taken.
+ * @param  &bench: The benchmark.
+ * @param  &latencies: Filled with the latency of each answer.
+ * @retval None
+ */
+static void run_client(TcpBench &bench, std::vector<double> &latencies) {
+	int fd = -1;
+	if (bench.session) {
+		fd = connect_bench(bench);
+		if (fd == -1 || !send_all(fd, "SES\n") || !receive_answer(fd, true)) {
+			fprintf(stderr, "[ERROR] Failed to start a session\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	size_t n;
+	while ((n = ++bench.next) <= bench.requests) {
+		std::string request = format_request(
+			bench.patterns[(n - 1) % bench.patterns.size()], n);
+		BenchClock::time_point start = BenchClock::now();
+		bool answered;
+		if (bench.session) {
+			answered = send_all(fd, request) && receive_answer(fd, true);
+		} else {
+			fd = connect_bench(bench);
+			answered = fd != -1 && send_all(fd, request) &&
+			           receive_answer(fd, false);
+			if (fd != -1) {
+				close(fd);
+			}
+		}
+		if (answered) {
+			latencies.push_back(elapsed_ms(start));
+		} else {
+			bench.failed++;
+		}
+	}
+
+	if (bench.session) {
+		close(fd);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	TcpBench bench;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:p:c:r:k")) != -1) {
+		switch (opt) {
+			case 'n':
+				bench.host = optarg;
+				break;
+			case 'p':
+				bench.port = optarg;
+				break;
+			case 'c':
+				bench.clients = parse_bench_count(optarg);
+				break;
+			case 'r':
+				bench.requests = parse_bench_count(optarg);
+				break;
+			case 'k':
+				bench.session = true;
+				break;
+			default:
+				fprintf(stderr,
+				        "Usage: %s [-n host] [-p port] [-c clients] "
+				        "[-r requests] [-k] request...\n",
+				        argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		bench.patterns.push_back(argv[i]);
+	}
+	if (bench.patterns.empty()) {
+		fprintf(stderr, "[ERROR] No request to send\n");
+		exit(EXIT_FAILURE);
+	}
+	bench.address =
+		resolve_bench_address(bench.host, bench.port, SOCK_STREAM);
+
+	std::vector<std::vector<double>> latencies(bench.clients);
+	std::vector<std::thread> clients;
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t i = 0; i < bench.clients; i++) {
+		clients.emplace_back(run_client, std::ref(bench),
+		                     std::ref(latencies[i]));
+	}
+	for (std::thread &client : clients) {
+		client.join();
+	}
+	double seconds = elapsed_ms(start) / 1000;
+
+	std::vector<double> all;
+	for (std::vector<double> &client : latencies) {
+		all.insert(all.end(), client.begin(), client.end());
+	}
+	print_bench_latencies(all, seconds, bench.failed);
+	freeaddrinfo(bench.address);
+	return 0;
+}
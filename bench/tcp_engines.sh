@@ -0,0 +1,15 @@
+#!/bin/bash
+# Connections per second and latency of each TCP engine, with one request
+# per connection as sent by the user.
+# Usage: bench/tcp_engines.sh [clients] [requests]
+
+. "$(dirname "$0")/common.sh"
+
+CLIENTS=${1:-8}
+REQUESTS=${2:-20000}
+
+for engine in fork epoll uring; do
+	start_server -e "$engine"
+	printf '%-6s ' "$engine"
+	tcp_bench -c "$CLIENTS" -r "$REQUESTS" "CLS 100001 password 001"
+done
@@ -0,0 +1,102 @@
+/**
+ * @file tcp_parse.cpp
+ * @brief Measures how fast messages carrying a file are read through
+ * TcpMessage, from a socket pair filled by another thread. The server reads
+ * the asset of an OPA into a file and the user reads the file data of an RSA
+ * into memory.
+ *
+ * Usage: tcp_parse
+ */
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "bench.hpp"
+#include "shared/protocol.hpp"
+
+#define TCP_PARSE_RUNS 5
+
+enum TcpParseCase { PARSE_OPA_TO_FILE, PARSE_OPA_TO_MEMORY, PARSE_RSA };
+
+/**
+ * @brief  Builds a message carrying a file of the given size.
+ * @param  parse_case: The message read.
+ * @param  size: Size of the file.
+ * @retval The message.
+ */
+static std::string build_file_message(TcpParseCase parse_case, size_t size) {
+	std::string data(size, 'x');
+	if (parse_case == PARSE_RSA) {
+		return "RSA OK asset.bin " + std::to_string(size) + " " + data + "\n";
+	}
+	return "OPA 100001 password car 100 600 asset.bin " + std::to_string(size) +
+	       " " + data + "\n";
+}
+
+/**
+ * @brief  Reads a message from a socket pair while another thread writes it.
+ * @param  parse_case: The message read.
+ * @param  &message: The message written.
+ * @retval Milliseconds taken to read it.
+ */
+static double parse_file_message(TcpParseCase parse_case,
+                                 const std::string &message) {
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+		perror("socketpair");
+		exit(EXIT_FAILURE);
+	}
+	std::thread writer([&message, &sockets] {
+		size_t written = 0;
+		while (written < message.size()) {
+			ssize_t n = write(sockets[1], message.data() + written,
+			                  message.size() - written);
+			if (n <= 0) {
+				break;
+			}
+			written += static_cast<size_t>(n);
+		}
+	});
+
+	BenchClock::time_point start = BenchClock::now();
+	TcpMessage tcp_message(sockets[0]);
+	if (parse_case == PARSE_RSA) {
+		ServerShowAsset answer;
+		answer.readMessage(tcp_message);
+	} else {
+		tcp_message.getn(PROTOCOL_SIZE);
+		ClientOpenAuction request;
+		if (parse_case == PARSE_OPA_TO_MEMORY) {
+			request.readMessage(tcp_message);
+		} else {
+			int fd = open("/dev/null", O_WRONLY);
+			request.readHeader(tcp_message);
+			request.readAsset(tcp_message, fd);
+			close(fd);
+		}
+	}
+	double ms = elapsed_ms(start);
+
+	writer.join();
+	close(sockets[0]);
+	close(sockets[1]);
+	return ms;
+}
+
+int main() {
+	const char *names[] = {"OPA into a file", "OPA into memory", "RSA"};
+	for (size_t size : {(size_t) 64 * 1024, (size_t) MAX_FILE_SIZE}) {
+		for (TcpParseCase parse_case :
+		     {PARSE_OPA_TO_FILE, PARSE_OPA_TO_MEMORY, PARSE_RSA}) {
+			std::string message = build_file_message(parse_case, size);
+			double ms = best_of(TCP_PARSE_RUNS, [&] {
+				return parse_file_message(parse_case, message);
+			});
+			printf("%-16s %8zu bytes: %6.0f MB/s\n", names[parse_case], size,
+			       (double) message.size() / 1000 / ms);
+		}
+	}
+	return 0;
+}
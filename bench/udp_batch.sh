@@ -0,0 +1,15 @@
+#!/bin/bash
+# UDP answers per second and latency for each batch size (-b), with many
+# requests in flight.
+# Usage: bench/udp_batch.sh [clients] [requests]
+
+. "$(dirname "$0")/common.sh"
+
+CLIENTS=${1:-32}
+REQUESTS=${2:-200000}
+
+for batch in 1 4 16 64; do
+	start_server -b "$batch"
+	printf -- '-b %-3s ' "$batch"
+	udp_bench -c "$CLIENTS" -r "$REQUESTS" "LOU 100001 password"
+done
@@ -0,0 +1,117 @@
+/**
+ * @file udp_bench.cpp
+ * @brief Load generator for the UDP requests of the AS. Each client has its
+ * own socket and keeps one request in flight, sending the next one once the
+ * answer arrives, and the latency of every answer is measured. A request
+ * without an answer after UDP_TIMEOUT seconds counts as failed.
+ *
+ * Usage: udp_bench [-n host] [-p port] [-c clients] [-r requests] request...
+ * The requests are sent in turn, "%d" in a request is replaced by its number.
+ */
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "bench.hpp"
+
+struct UdpBench {
+	std::string host = DEFAULT_HOSTNAME;
+	std::string port = DEFAULT_PORT;
+	size_t clients = 8;
+	size_t requests = 20000;
+	std::vector<std::string> patterns;
+	struct addrinfo *address = NULL;
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> failed{0};
+};
+
+/**
+ * @brief  Sends requests until every request of the benchmark is taken.
+ * @param  &bench: The benchmark.
+ * @param  &latencies: Filled with the latency of each answer.
+ * @retval None
+ */
+static void run_client(UdpBench &bench, std::vector<double> &latencies) {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct timeval timeout = {UDP_TIMEOUT, 0};
+	if (fd == -1 ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) ==
+	        -1 ||
+	    connect(fd, bench.address->ai_addr, bench.address->ai_addrlen) == -1) {
+		fprintf(stderr, "[ERROR] Failed to open a UDP socket\n");
+		exit(EXIT_FAILURE);
+	}
+
+	char answer[UDP_SOCKET_BUFFER_LEN];
+	size_t n;
+	while ((n = ++bench.next) <= bench.requests) {
+		std::string request = format_request(
+			bench.patterns[(n - 1) % bench.patterns.size()], n);
+		BenchClock::time_point start = BenchClock::now();
+		if (send(fd, request.data(), request.size(), 0) == -1 ||
+		    recv(fd, answer, sizeof(answer), 0) <= 0) {
+			bench.failed++;
+			continue;
+		}
+		latencies.push_back(elapsed_ms(start));
+	}
+	close(fd);
+}
+
+int main(int argc, char *argv[]) {
+	UdpBench bench;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:p:c:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				bench.host = optarg;
+				break;
+			case 'p':
+				bench.port = optarg;
+				break;
+			case 'c':
+				bench.clients = parse_bench_count(optarg);
+				break;
+			case 'r':
+				bench.requests = parse_bench_count(optarg);
+				break;
+			default:
+				fprintf(stderr,
+				        "Usage: %s [-n host] [-p port] [-c clients] "
+				        "[-r requests] request...\n",
+				        argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		bench.patterns.push_back(argv[i]);
+	}
+	if (bench.patterns.empty()) {
+		fprintf(stderr, "[ERROR] No request to send\n");
+		exit(EXIT_FAILURE);
+	}
+	bench.address = resolve_bench_address(bench.host, bench.port, SOCK_DGRAM);
+
+	std::vector<std::vector<double>> latencies(bench.clients);
+	std::vector<std::thread> clients;
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t i = 0; i < bench.clients; i++) {
+		clients.emplace_back(run_client, std::ref(bench),
+		                     std::ref(latencies[i]));
+	}
+	for (std::thread &client : clients) {
+		client.join();
+	}
+	double seconds = elapsed_ms(start) / 1000;
+
+	std::vector<double> all;
+	for (std::vector<double> &client : latencies) {
+		all.insert(all.end(), client.begin(), client.end());
+	}
+	print_bench_latencies(all, seconds, bench.failed);
+	freeaddrinfo(bench.address);
+	return 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/bash
+# UDP answers per second and latency with 1, 2 and 4 UDP workers, for a mix
+# of LIN and LST requests.
+# Usage: bench/udp_workers.sh [clients] [requests]
+
+. "$(dirname "$0")/common.sh"
+
+CLIENTS=${1:-32}
+REQUESTS=${2:-100000}
+
+for workers in 1 2 4; do
+	start_server -u "$workers"
+	printf -- '-u %-3s ' "$workers"
+	udp_bench -c "$CLIENTS" -r "$REQUESTS" "LIN 100001 password" "LST"
+done
@@ -0,0 +1,83 @@
+/**
+ * @file validate.cpp
+ * @brief Measures the time taken to validate the fields of a request, and to
+ * parse and validate whole requests through a BufferMessage (the delimiter
+ * search and the verifications together), as the server does with each
+ * request after reading its code.
+ *
+ * Usage: validate
+ */
+#include <string.h>
+
+#include <type_traits>
+
+#include "bench.hpp"
+#include "shared/protocol.hpp"
+#include "shared/verifications.hpp"
+
+#define VALIDATE_RUNS       15
+#define VALIDATE_ITERATIONS 200000
+
+static uint64_t sink = 0;  // Keeps the results from being optimized away
+
+/**
+ * @brief  Times parsing a request, from after its code.
+ * @param  *request: The request, with its code.
+ * @retval Nanoseconds per request.
+ */
+template <typename Message>
+static double time_parse(const char *request) {
+	size_t len = strlen(request) - PROTOCOL_SIZE;
+	double ms = best_of(VALIDATE_RUNS, [request, len] {
+		BenchClock::time_point start = BenchClock::now();
+		for (int i = 0; i < VALIDATE_ITERATIONS; i++) {
+			Message message;
+			BufferMessage buffer(request + PROTOCOL_SIZE, len);
+			if constexpr (std::is_same_v<Message, ClientOpenAuction>) {
+				message.readHeader(buffer);
+			} else {
+				message.readMessage(buffer);
+			}
+			sink += message.user_id;
+		}
+		return elapsed_ms(start);
+	});
+	return ms * 1000000 / VALIDATE_ITERATIONS;
+}
+
+/**
+ * @brief  Times validating a user id, a password, an auction id and a name.
+ * @retval Nanoseconds per set of fields.
+ */
+static double time_fields() {
+	const char *user_ids[] = {"100001", "123456", "999999", "000123"};
+	const char *passwords[] = {"password", "abcd1234", "ZZZZZZZZ", "p4ssw0rd"};
+	const char *names[] = {"painting01", "car", "sea", "x"};
+	double ms = best_of(VALIDATE_RUNS, [&] {
+		BenchClock::time_point start = BenchClock::now();
+		for (int i = 0; i < VALIDATE_ITERATIONS; i++) {
+			int k = i & 3;
+			sink += static_cast<uint64_t>(
+				verify_user_id(user_ids[k]) + verify_password(passwords[k]) +
+				verify_auction_id("007") + verify_name(names[k]));
+			asm volatile("" ::: "memory");
+		}
+		return elapsed_ms(start);
+	});
+	return ms * 1000000 / VALIDATE_ITERATIONS;
+}
+
+int main() {
+	printf("validate UID, password, AID, name: %6.1f ns\n", time_fields());
+	printf("parse and validate LIN:            %6.1f ns\n",
+	       time_parse<ClientLoginUser>("LIN 100001 password\n"));
+	printf("parse and validate BID:            %6.1f ns\n",
+	       time_parse<ClientBid>("BID 100001 password 007 500\n"));
+	printf("parse and validate CLS:            %6.1f ns\n",
+	       time_parse<ClientCloseAuction>("CLS 100001 password 007\n"));
+	printf("parse and validate OPA header:     %6.1f ns\n",
+	       time_parse<ClientOpenAuction>(
+			   "OPA 100001 password painting01 1000 3600 "
+			   "painting-of-the-sea.jpg 123456 "));
+	return sink == 0;
+}
@@ -58,7 +58,7 @@ void Client::configClient(int argc, char *argv[]) {
 	int opt;
 
 	// Treats all the options received by the client
-	while ((opt = getopt(argc, argv, "hn:p:")) != -1) {
+	while ((opt = getopt(argc, argv, "hn:p:k")) != -1) {
 		switch (opt) {
 			case 'n':
 				// Hostname
@@ -68,6 +68,10 @@ void Client::configClient(int argc, char *argv[]) {
 				// Port
 				this->_port = std::string(optarg);
 				break;
+			case 'k':
+				// Keep one TCP connection open for every TCP request
+				this->_keep_alive = true;
+				break;
 			default:
 				printError("Config error.");
 				exit(EXIT_FAILURE);
@@ -227,10 +231,42 @@ void Client::waitForUdpMessage(ProtocolMessage &message) {
  */
 int Client::sendTcpMessageAndAwaitReply(ProtocolMessage &out_message,
                                         ProtocolMessage &in_message) {
+	std::vector<ProtocolMessage *> out_messages = {&out_message};
+	std::vector<ProtocolMessage *> in_messages = {&in_message};
+	return sendTcpMessagesAndAwaitReplies(out_messages, in_messages);
+}
+
+/**
+ * @brief Sends many TCP messages and waits for their answers, which arrive in
+ * the same order. With a session every message is sent at once through the
+ * same connection before reading the answers. Otherwise each message opens its
+ * own connection.
+ * @param  &out_messages: messages to send to the server
+ * @param  &in_messages: messages to receive from the server, one for each
+ * message sent
+ * @retval 0 : success
+ * @retval -1 : failure
+ */
+int Client::sendTcpMessagesAndAwaitReplies(
+	std::vector<ProtocolMessage *> &out_messages,
+	std::vector<ProtocolMessage *> &in_messages) {
 	try {
-		openTcpSocket();
-		sendTcpMessage(out_message);
-		waitForTcpMessage(in_message);
+		if (_keep_alive && openSession()) {
+			send_tcp_messages(out_messages, _tcp_socket_fd);
+			for (ProtocolMessage *message : in_messages) {
+				message->readMessage(*_session);
+			}
+			// Successfully exchanged messages with the server.
+			return 0;
+		}
+
+		for (size_t i = 0; i < out_messages.size(); i++) {
+			openTcpSocket();
+			connectTcpSocket();
+			sendTcpMessage(*out_messages[i]);
+			waitForTcpMessage(*in_messages[i]);
+			closeTcpSocket();
+		}
 	} catch (ConnectionTimeoutException &e) {
 		printError("Couldn't send message");
 		closeTcpSocket();
@@ -253,6 +289,7 @@ int Client::sendTcpMessageAndAwaitReply(ProtocolMessage &out_message,
 		return -1;
 	} catch (MessageSendException &e) {
 		printError("Couldn't send message.");
+		closeTcpSocket();
 		return -1;
 	} catch (...) {
 		printError("Unexpected error.");
@@ -260,10 +297,52 @@ int Client::sendTcpMessageAndAwaitReply(ProtocolMessage &out_message,
 		return -1;
 	}
 	// Successfully exchanged messages with the server.
-	closeTcpSocket();
 	return 0;
 }
 
+/**
+ * @brief  Makes sure there is an open session with the server, opening a new
+ * connection if there is none or if the server closed the last one while it
+ * was idle.
+ * @throws SocketException
+ * @throws ConnectionTimeoutException
+ * @retval true if the session is open.
+ * @retval false if the server doesn't support sessions. The client then opens
+ * a connection per request.
+ */
+bool Client::openSession() {
+	if (_session != nullptr) {
+		// Nothing is expected from the server between requests, so anything
+		// readable means it closed the connection
+		char c;
+		ssize_t n = recv(_tcp_socket_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true;
+		}
+		closeTcpSocket();
+	}
+
+	openTcpSocket();
+	connectTcpSocket();
+	ClientOpenSession out_message;
+	ServerOpenSession in_message;
+	sendTcpMessage(out_message);
+	_session = std::make_unique<TcpMessage>(_tcp_socket_fd);
+	try {
+		in_message.readMessage(*_session);
+	} catch (UnexpectedMessageException &e) {
+		// Servers without sessions answer ERR
+		in_message.status = ServerOpenSession::status::ERR;
+	}
+
+	if (in_message.status != ServerOpenSession::status::OK) {
+		closeTcpSocket();
+		_keep_alive = false;
+		return false;
+	}
+	return true;
+}
+
 /**
  * @brief Opens a TCP socket.
  * @throws SocketException
@@ -298,21 +377,25 @@ void Client::openTcpSocket() {
 }
 
 /**
- * @brief  Calls the protocol function that sends a TCP message already filled
- * according to the protocol.
- * @param  &message: message to send to the server
+ * @brief  Establishes the connection of the TCP socket with the server.
  * @throws ConnectionTimeoutException
  * @retval None
  */
-void Client::sendTcpMessage(ProtocolMessage &message) {
-	// Establish connection with server
+void Client::connectTcpSocket() {
 	ssize_t n = connect(_tcp_socket_fd, _server_tcp_addr->ai_addr,
 	                    _server_tcp_addr->ai_addrlen);
 	if (n == -1) {
 		throw ConnectionTimeoutException();
 	}
+}
 
-	// Send message
+/**
+ * @brief  Calls the protocol function that sends a TCP message already filled
+ * according to the protocol.
+ * @param  &message: message to send to the server
+ * @retval None
+ */
+void Client::sendTcpMessage(ProtocolMessage &message) {
 	send_tcp_message(message, _tcp_socket_fd, false);
 }
 
@@ -327,12 +410,15 @@ void Client::waitForTcpMessage(ProtocolMessage &message) {
 };
 
 /**
- * @brief  Closes the TCP socket.
+ * @brief  Closes the TCP socket, ending the session if there is one.
  * @throws SocketException
  * @retval None
  */
 void Client::closeTcpSocket() {
-	if (close(this->_tcp_socket_fd) != 0) {
+	_session.reset();
+	int fd = this->_tcp_socket_fd;
+	this->_tcp_socket_fd = -1;
+	if (close(fd) != 0) {
 		if (errno == EBADF) {
 			// fd already closed
 			return;
@@ -13,7 +13,9 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "shared/config.hpp"
 #include "shared/protocol.hpp"
@@ -67,11 +69,17 @@ class Client {
 	struct addrinfo* _server_udp_addr = NULL;
 	struct addrinfo* _server_tcp_addr = NULL;
 
+	// TCP session, keeps one connection open for every TCP request (-k)
+	bool _keep_alive = false;
+	std::unique_ptr<TcpMessage> _session;  // Reads the answers of the session
+
 	// Internal methods
 	void resolveServerAddress(std::string& hostname, std::string& port);
 	void sendUdpMessage(ProtocolMessage& message);
 	void waitForUdpMessage(ProtocolMessage& message);
 	void openTcpSocket();
+	void connectTcpSocket();
+	bool openSession();
 	void sendTcpMessage(ProtocolMessage& message);
 	void waitForTcpMessage(ProtocolMessage& message);
 	void closeTcpSocket();
@@ -89,6 +97,9 @@ class Client {
 	                                ProtocolMessage& in_message);
 	int sendTcpMessageAndAwaitReply(ProtocolMessage& out_message,
 	                                ProtocolMessage& in_message);
+	int sendTcpMessagesAndAwaitReplies(
+		std::vector<ProtocolMessage*>& out_messages,
+		std::vector<ProtocolMessage*>& in_messages);
 };
 
 #endif
\ No newline at end of file
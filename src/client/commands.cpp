@@ -338,7 +338,8 @@ void ListStartedAuctionsCommand::handle(std::string args, Client &client) {
 		return;
 	}
 	std::string message_ok =
-		"Listing \nAuctions started by user " + client.getLoggedInUser();
+		"Listing \nAuctions started by user " +
+		std::to_string(client.getLoggedInUser());
 	message_ok += ":";
 
 	// Check status
@@ -395,7 +396,8 @@ void ListBiddedAuctionsCommand::handle(std::string args, Client &client) {
 	}
 
 	std::string message_ok =
-		"Listing \nAuctions bidded by user " + client.getLoggedInUser();
+		"Listing \nAuctions bidded by user " +
+		std::to_string(client.getLoggedInUser());
 	message_ok += ":";
 
 	// Check status of the received message
@@ -0,0 +1,95 @@
+/**
+ * @file admission.cpp
+ * @brief Implementation of the admission control of a server process.
+ */
+#include "admission.hpp"
+
+#include "shared/protocol.hpp"
+
+/**
+ * @brief  Sets the watermarks. A high watermark of 0 admits every request.
+ * @param  high: Queue depth from which requests are shed.
+ * @param  low: Queue depth at which shedding stops, below high.
+ * @retval None
+ */
+void AdmissionControl::configure(size_t high, size_t low) {
+	_high = high;
+	_low = low;
+}
+
+/**
+ * @brief  Whether watermarks were set.
+ * @retval true if requests may be shed.
+ */
+bool AdmissionControl::enabled() {
+	return _high > 0;
+}
+
+/**
+ * @brief  Bound of the queue, every request past it is shed.
+ * @retval Twice the high watermark.
+ */
+size_t AdmissionControl::capacity() {
+	return 2 * _high;
+}
+
+/**
+ * @brief  Updates the depth of the queue and starts or stops shedding when it
+ * crosses the watermarks.
+ * @param  depth: Requests waiting in the process.
+ * @retval None
+ */
+void AdmissionControl::setDepth(size_t depth) {
+	if (_high == 0) {
+		return;
+	}
+	_depth.store(depth, std::memory_order_relaxed);
+	if (depth >= _high) {
+		_shedding.store(true, std::memory_order_relaxed);
+	} else if (depth <= _low) {
+		_shedding.store(false, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * @brief  Decides whether a request is handled or shed, given its type and the
+ * depth of the queue.
+ * @param  code: Code of the request, packed by pack_protocol_code.
+ * @retval true if the request should be handled.
+ * @retval false if it should be answered with ERR right away.
+ */
+bool AdmissionControl::admit(uint32_t code) {
+	if (_high == 0 || !_shedding.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	size_t depth = _depth.load(std::memory_order_relaxed);
+	int shed_below = REQUEST_PRIORITY_READ;
+	if (depth >= capacity()) {
+		shed_below = REQUEST_PRIORITY_WRITE + 1;
+	} else if (depth >= _high + _high / 2) {
+		shed_below = REQUEST_PRIORITY_WRITE;
+	}
+	return request_priority(code) >= shed_below;
+}
+
+/**
+ * @brief  Priority of a request. Downloads are the most expensive to serve and
+ * reads can be retried without side effects, so they go first.
+ * @param  code: Code of the request, packed by pack_protocol_code.
+ * @retval REQUEST_PRIORITY_DOWNLOAD, REQUEST_PRIORITY_READ or
+ * REQUEST_PRIORITY_WRITE.
+ */
+int request_priority(uint32_t code) {
+	switch (code) {
+		case pack_protocol_code(CODE_SHOW_ASSET_CLIENT):
+			return REQUEST_PRIORITY_DOWNLOAD;
+		case pack_protocol_code(CODE_LIST_ALLAUC_USER):
+		case pack_protocol_code(CODE_SHOWREC_USER):
+		case pack_protocol_code(CODE_LIST_AUC_USER):
+		case pack_protocol_code(CODE_LIST_MYB_USER):
+			return REQUEST_PRIORITY_READ;
+		default:
+			return REQUEST_PRIORITY_WRITE;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef __ADMISSION__
+#define __ADMISSION__
+
+/**
+ * @file admission.hpp
+ * @brief Declaration of the admission control of a server process. Each
+ * process measures its own queue of requests (datagrams of a UDP batch,
+ * connections with requests, TCP children or the accept backlog) and, past
+ * the high watermark, answers the cheapest requests to retry with ERR right
+ * away instead of letting every client time out.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Request priorities, the lowest ones are shed first
+#define REQUEST_PRIORITY_DOWNLOAD 0  // SAS
+#define REQUEST_PRIORITY_READ     1  // LST, SRC, LMA, LMB
+#define REQUEST_PRIORITY_WRITE    2  // Everything else
+
+/**
+ * @brief  Watermarks of the queue of a process. Shedding starts once the queue
+ * reaches the high watermark and stops once it is back to the low watermark.
+ * While shedding, downloads are refused first, then reads once the queue is
+ * half way to twice the high watermark and every request once it gets there.
+ * The depth is set by the I/O thread and read by the handler threads.
+ */
+class AdmissionControl {
+	size_t _high = 0;  // 0 disables admission control
+	size_t _low = 0;
+	std::atomic<size_t> _depth{0};
+	std::atomic<bool> _shedding{false};
+
+   public:
+	void configure(size_t high, size_t low);
+	bool enabled();
+	size_t capacity();
+	void setDepth(size_t depth);
+	bool admit(uint32_t code);
+};
+
+int request_priority(uint32_t code);
+
+#endif
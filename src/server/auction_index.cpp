@@ -0,0 +1,244 @@
+/**
+ * @file auction_index.cpp
+ * @brief Implementation of the in-memory index of the auctions.
+ */
+#include "auction_index.hpp"
+
+#include <sys/mman.h>
+
+#include <new>
+
+#include "server.hpp"
+
+/**
+ * @brief  Finds the slot of a bidder, starting at the one its id hashes to.
+ * @param  user_id: The user's id.
+ * @param  insert: Whether to take a free slot if the user has none.
+ * @retval The slot, NULL if the user has none (or the table is full).
+ */
+IndexedBidder *AuctionIndex::findBidder(uint32_t user_id, bool insert) {
+	size_t start = (static_cast<size_t>(user_id) * 2654435761u) %
+	               AUCTION_INDEX_BIDDER_SLOTS;
+	for (size_t i = 0; i < AUCTION_INDEX_BIDDER_SLOTS; i++) {
+		IndexedBidder &bidder =
+			_bidders[(start + i) % AUCTION_INDEX_BIDDER_SLOTS];
+		if (bidder.user_id == user_id) {
+			return &bidder;
+		}
+		if (bidder.user_id == 0) {
+			if (!insert) {
+				return NULL;
+			}
+			bidder.user_id = user_id;
+			return &bidder;
+		}
+	}
+	if (insert) {
+		_bidders_full = true;
+	}
+	return NULL;
+}
+
+/**
+ * @brief  Adds an auction that was just created, or read from ASDIR.
+ * @param  aid: The auction's id.
+ * @param  host_id: The id of the user hosting it.
+ * @param  start_time: When it started, in seconds since the epoch.
+ * @param  timeactive: Seconds it is active for.
+ * @param  start_value: The starting value for bids.
+ * @retval None
+ */
+void AuctionIndex::addAuction(uint32_t aid, uint32_t host_id,
+                              uint32_t start_time, uint32_t timeactive,
+                              uint32_t start_value) {
+	if (aid == 0 || aid > AUCTION_INDEX_MAX_AID) {
+		return;
+	}
+	IndexedAuction &auction = _auctions[aid];
+	auction.used = true;
+	auction.closed = false;
+	auction.host_id = host_id;
+	auction.start_time = start_time;
+	auction.timeactive = timeactive;
+	auction.start_value = start_value;
+	auction.highest_bid = 0;
+	auction.bid_count = 0;
+	auction.recent_next = 0;
+	auction.recent_count = 0;
+	if (aid > _last_aid) {
+		_last_aid = aid;
+	}
+}
+
+/**
+ * @brief  Marks an auction as closed, once its END file is written.
+ * @param  aid: The auction's id.
+ * @retval None
+ */
+void AuctionIndex::closeAuction(uint32_t aid) {
+	IndexedAuction *indexed = auction(aid);
+	if (indexed != NULL) {
+		indexed->closed = true;
+	}
+}
+
+/**
+ * @brief  Sets the bids of an auction read from ASDIR.
+ * @param  aid: The auction's id.
+ * @param  highest_bid: Value of its highest bid, 0 if there are none.
+ * @param  bid_count: Number of bids.
+ * @retval None
+ */
+void AuctionIndex::setBids(uint32_t aid, uint32_t highest_bid,
+                           uint32_t bid_count) {
+	IndexedAuction *indexed = auction(aid);
+	if (indexed != NULL) {
+		indexed->highest_bid = highest_bid;
+		indexed->bid_count = bid_count;
+	}
+}
+
+/**
+ * @brief  Records that a user bid on an auction.
+ * @param  aid: The auction's id.
+ * @param  user_id: The bidder's id.
+ * @retval None
+ */
+void AuctionIndex::addBidder(uint32_t aid, uint32_t user_id) {
+	if (aid == 0 || aid > AUCTION_INDEX_MAX_AID) {
+		return;
+	}
+	IndexedBidder *bidder = findBidder(user_id, true);
+	if (bidder != NULL) {
+		bidder->bids[aid / 8] |= static_cast<uint8_t>(1 << (aid % 8));
+	}
+}
+
+/**
+ * @brief  Adds a bid to the latest bids of an auction, replacing the oldest
+ * one once there are AUCTION_INDEX_RECENT_BIDS.
+ * @param  aid: The auction's id.
+ * @param  &bid: The bid, later than the ones already added.
+ * @retval None
+ */
+void AuctionIndex::addRecentBid(uint32_t aid, const IndexedBid &bid) {
+	IndexedAuction *indexed = auction(aid);
+	if (indexed == NULL) {
+		return;
+	}
+	indexed->recent[indexed->recent_next] = bid;
+	indexed->recent_next =
+		(indexed->recent_next + 1) % AUCTION_INDEX_RECENT_BIDS;
+	if (indexed->recent_count < AUCTION_INDEX_RECENT_BIDS) {
+		indexed->recent_count++;
+	}
+}
+
+/**
+ * @brief  Adds a bid that was just accepted.
+ * @param  aid: The auction's id.
+ * @param  &bid: The bid.
+ * @retval None
+ */
+void AuctionIndex::addBid(uint32_t aid, const IndexedBid &bid) {
+	IndexedAuction *indexed = auction(aid);
+	if (indexed == NULL) {
+		return;
+	}
+	indexed->bid_count++;
+	if (bid.value > indexed->highest_bid) {
+		indexed->highest_bid = bid.value;
+	}
+	addBidder(aid, bid.user_id);
+	addRecentBid(aid, bid);
+}
+
+/**
+ * @brief  Latest bids of an auction, from the oldest to the latest.
+ * @param  aid: The auction's id.
+ * @param  *bids: Filled with the bids, room for AUCTION_INDEX_RECENT_BIDS.
+ * @retval Number of bids, 0 if the auction doesn't exist.
+ */
+size_t AuctionIndex::recentBids(uint32_t aid, IndexedBid *bids) {
+	IndexedAuction *indexed = auction(aid);
+	if (indexed == NULL) {
+		return 0;
+	}
+	uint32_t oldest = (indexed->recent_next + AUCTION_INDEX_RECENT_BIDS -
+	                   indexed->recent_count) %
+	                  AUCTION_INDEX_RECENT_BIDS;
+	for (uint32_t i = 0; i < indexed->recent_count; i++) {
+		bids[i] = indexed->recent[(oldest + i) % AUCTION_INDEX_RECENT_BIDS];
+	}
+	return indexed->recent_count;
+}
+
+/**
+ * @brief  State of an auction.
+ * @param  aid: The auction's id.
+ * @retval The auction, NULL if it doesn't exist.
+ */
+IndexedAuction *AuctionIndex::auction(uint32_t aid) {
+	if (aid == 0 || aid > AUCTION_INDEX_MAX_AID || !_auctions[aid].used) {
+		return NULL;
+	}
+	return &_auctions[aid];
+}
+
+/**
+ * @brief  Largest auction id in use.
+ * @retval The id, 0 if there are no auctions.
+ */
+uint32_t AuctionIndex::lastAid() {
+	return _last_aid;
+}
+
+/**
+ * @brief  Whether a user bid on an auction. Only meaningful if knowsBidder.
+ * @param  aid: The auction's id.
+ * @param  user_id: The user's id.
+ * @retval true if the user bid on it.
+ */
+bool AuctionIndex::hasBid(uint32_t aid, uint32_t user_id) {
+	IndexedBidder *bidder = findBidder(user_id, false);
+	if (bidder == NULL || aid > AUCTION_INDEX_MAX_AID) {
+		return false;
+	}
+	return (bidder->bids[aid / 8] >> (aid % 8)) & 1;
+}
+
+/**
+ * @brief  Whether the index holds every auction a user bid on. It doesn't if
+ * the user's bids didn't fit in the table of bidders.
+ * @param  user_id: The user's id.
+ * @retval true if hasBid can be used for the user.
+ */
+bool AuctionIndex::knowsBidder(uint32_t user_id) {
+	return !_bidders_full || findBidder(user_id, false) != NULL;
+}
+
+/**
+ * @brief  Maps the index. Must be called before forking so every process sees
+ * the same mapping.
+ * @throws UnrecoverableException
+ * @retval The index, without auctions.
+ */
+AuctionIndex *create_auction_index() {
+	void *mapping = mmap(NULL, sizeof(AuctionIndex), PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw UnrecoverableException("[ERROR] Failed to map auction index");
+	}
+	return new (mapping) AuctionIndex();
+}
+
+/**
+ * @brief  Unmaps the index from this process.
+ * @param  index: Index returned by create_auction_index.
+ * @retval None
+ */
+void destroy_auction_index(AuctionIndex *index) {
+	if (index != NULL) {
+		munmap(index, sizeof(AuctionIndex));
+	}
+}
@@ -0,0 +1,97 @@
+#ifndef __AUCTION_INDEX__
+#define __AUCTION_INDEX__
+
+/**
+ * @file auction_index.hpp
+ * @brief Declaration of the in-memory index of the auctions. It holds what
+ * listing the auctions needs (host, start, duration, state and bids) and the
+ * latest bids of each auction, so that LST, LMA, LMB and the bids of SRC are
+ * answered without reading ASDIR. It lives in an
+ * anonymous shared mapping created before forking, is built from ASDIR at
+ * startup and is updated along with the files, always under the lock of the
+ * database, which stays the durable copy.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+// Auction ids go from 001 to 999
+#define AUCTION_INDEX_MAX_AID 999
+
+// Size of the table of bidders, a user that doesn't fit is looked up in ASDIR
+#define AUCTION_INDEX_BIDDER_SLOTS 4096
+
+// Bids kept for each auction, the ones shown by SRC
+#define AUCTION_INDEX_RECENT_BIDS 50
+
+/**
+ * @brief  A bid. Every bid is larger than the ones before it, so the latest
+ * bids of an auction are also its highest. It is also the record of the bid
+ * logs in ASDIR.
+ */
+class IndexedBid {
+   public:
+	uint32_t user_id;
+	uint32_t value;
+	uint32_t bid_time;  // Seconds since the epoch
+	uint32_t time_passed;  // Seconds since the auction started
+};
+
+/**
+ * @brief  State of an auction.
+ */
+class IndexedAuction {
+   public:
+	bool used;
+	bool closed;  // Whether its END file exists
+	uint32_t host_id;
+	uint32_t start_time;  // Seconds since the epoch
+	uint32_t timeactive;
+	uint32_t start_value;
+	uint32_t highest_bid;  // 0 if there are no bids
+	uint32_t bid_count;
+	IndexedBid recent[AUCTION_INDEX_RECENT_BIDS];  // Ring of the latest bids
+	uint32_t recent_next;  // Slot of the next bid
+	uint32_t recent_count;
+};
+
+/**
+ * @brief  Auctions a user bid on, a bit for each auction id.
+ */
+class IndexedBidder {
+   public:
+	uint32_t user_id;  // 0 if the slot is free
+	uint8_t bids[AUCTION_INDEX_MAX_AID / 8 + 1];
+};
+
+/**
+ * @brief  Index of every auction and of the auctions each user bid on.
+ * Bidders are kept in an open addressing table that is never removed from.
+ */
+class AuctionIndex {
+	IndexedAuction _auctions[AUCTION_INDEX_MAX_AID + 1];
+	uint32_t _last_aid = 0;
+	IndexedBidder _bidders[AUCTION_INDEX_BIDDER_SLOTS];
+	bool _bidders_full = false;  // Some bidder didn't fit in the table
+
+	IndexedBidder *findBidder(uint32_t user_id, bool insert);
+
+   public:
+	void addAuction(uint32_t aid, uint32_t host_id, uint32_t start_time,
+	                uint32_t timeactive, uint32_t start_value);
+	void closeAuction(uint32_t aid);
+	void setBids(uint32_t aid, uint32_t highest_bid, uint32_t bid_count);
+	void addBidder(uint32_t aid, uint32_t user_id);
+	void addRecentBid(uint32_t aid, const IndexedBid &bid);
+	void addBid(uint32_t aid, const IndexedBid &bid);
+	size_t recentBids(uint32_t aid, IndexedBid *bids);
+	IndexedAuction *auction(uint32_t aid);
+	uint32_t lastAid();
+	bool hasBid(uint32_t aid, uint32_t user_id);
+	bool knowsBidder(uint32_t user_id);
+};
+
+AuctionIndex *create_auction_index();
+void destroy_auction_index(AuctionIndex *index);
+
+#endif
@@ -3,6 +3,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -72,31 +73,10 @@ int Database::semaphore_destroy() {
 }
 
 /**
- * @brief  Compares the auctions by their auction ids in order to sort them.
- * @param  &a: First auction.
- * @param  &b: Second auction.
- * @retval true if auction id of the first auction is smaller than the.
-   second's.
- * @retval false if otherwise.
- */
-bool CompareByAid(const AuctionListing &a, const AuctionListing &b) {
-	uint32_t a_aid = static_cast<uint32_t>(stoi(a.a_id));
-	uint32_t b_aid = static_cast<uint32_t>(stoi(b.a_id));
-	return (a_aid < b_aid);
-}
-
-/**
- * @brief  Compares the bids by their auction ids in order to sort them.
- * @param  &a: First bid.
- * @param  &b: Second bid.
- * @retval true if auction id of the first bid is smaller than the.
-   second's.
- * @retval false if otherwise.
+ * @brief  Unmaps the auction index from this process.
  */
-bool CompareByValue(const BidInfo &a, const BidInfo &b) {
-	uint32_t a_aid = static_cast<uint32_t>(stol(a.value));
-	uint32_t b_aid = static_cast<uint32_t>(stol(b.value));
-	return (a_aid < b_aid);
+Database::~Database() {
+	destroy_auction_index(_index);
 }
 
 /**
@@ -171,6 +151,7 @@ int Database::CheckUserLoggedIn(std::string user_id) {
 	if (fp == NULL) {
 		return -1;
 	}
+	fclose(fp);
 
 	return 0;
 }
@@ -198,11 +179,8 @@ int Database::CreateUserDir(std::string user_id) {
 
 	std::string hosted_dir = "ASDIR/USERS/" + user_id;
 	hosted_dir += "/HOSTED";
-	std::string bidded_dir = "ASDIR/USERS/" + user_id;
-	bidded_dir += "/BIDDED";
 
 	const char *hosted_dirname = hosted_dir.c_str();
-	const char *bidded_dirname = bidded_dir.c_str();
 
 	if (mkdir(user_id_dirname, 0700) == -1) {
 		return -1;
@@ -212,10 +190,6 @@ int Database::CreateUserDir(std::string user_id) {
 		return -1;
 	}
 
-	if (mkdir(bidded_dirname, 0700) == -1) {
-		return -1;
-	}
-
 	return 0;
 }
 
@@ -231,21 +205,15 @@ int Database::CreateAuctionDir(std::string a_id) {
 	}
 
 	std::string a_id_dir = "ASDIR/AUCTIONS/" + a_id;
-	std::string bid_dir = "ASDIR/AUCTIONS/" + a_id;
-	bid_dir += "/BIDS";
 	std::string asset_dir = "ASDIR/AUCTIONS/" + a_id;
 	asset_dir += "/ASSET";
 
 	const char *a_id_dirname = a_id_dir.c_str();
-	const char *bid_dirname = bid_dir.c_str();
 	const char *asset_dirname = asset_dir.c_str();
 
 	if (mkdir(a_id_dirname, 0700) == -1) {
 		return -1;
 	}
-	if (mkdir(bid_dirname, 0700) == -1) {
-		return -1;
-	}
 	if (mkdir(asset_dirname, 0700) == -1) {
 		return -1;
 	}
@@ -349,41 +317,6 @@ int Database::RegisterHost(std::string user_id, std::string a_id) {
 	return 0;
 }
 
-/**
- * @brief  Creates a file that corresponds to the auction the user bid on.
- * @param  user_id: The user's id.
- * @param  a_id: The auction's id.
- * @retval -1 if either id is invalid or the file isn't properly created.
- * @retval 0 if the creation is successful.
- */
-int Database::RegisterBid(std::string user_id, std::string a_id) {
-	if (verify_user_id(user_id) == -1) {
-		return -1;
-	}
-
-	if (verify_auction_id(a_id) == -1) {
-		return -1;
-	}
-
-	FILE *fp;
-
-	std::string bid_name = "ASDIR/USERS/" + user_id;
-	bid_name += "/BIDDED/";
-	bid_name += a_id;
-	bid_name += ".txt";
-
-	const char *bid_fname = bid_name.c_str();
-
-	fp = fopen(bid_fname, "w");
-	if (fp == NULL) {
-		return -1;
-	}
-
-	fclose(fp);
-
-	return 0;
-}
-
 /**
  * @brief  Checks if the login file exists.
  * @param  *login_id_fname: The path to the login file.
@@ -589,6 +522,7 @@ int Database::CreateEndFile(std::string a_id) {
 	FILE *fp;
 	StartInfo start;
 	time_t fulltime;
+	struct tm finish_tm;
 	struct tm *finish_time;
 	std::string current_date = GetCurrentDate();
 	std::string content;
@@ -613,7 +547,7 @@ int Database::CreateEndFile(std::string a_id) {
 		// calculated.
 
 		time_t total_time = static_cast<time_t>(start_time + supposed_end);
-		finish_time = gmtime(&total_time);
+		finish_time = gmtime_r(&total_time, &finish_tm);
 		sprintf(date_str, "%4u-%02u-%02u %02u:%02u:%02u",
 		        finish_time->tm_year + 1900, finish_time->tm_mon + 1,
 		        finish_time->tm_mday, finish_time->tm_hour, finish_time->tm_min,
@@ -648,15 +582,16 @@ int Database::CreateEndFile(std::string a_id) {
 }
 
 /**
- * @brief  Creates a copy of the asset.
+ * @brief  Moves a staged asset into the auction's directory. The rename is
+ * atomic, so the asset is either complete or missing.
  * @param  a_id: The auction's id.
  * @param  asset_fname: The path to the asset's image file.
- * @param  data: The asset's image data.
- * @retval -1 if the auction's id is invalid or the file isn't created properly.
+ * @param  staged_fname: The staged asset, see StageAsset.
+ * @retval -1 if the auction's id is invalid or the file isn't moved properly.
  * @retval 0 if the creation is successful.
  */
 int Database::CreateAssetFile(std::string a_id, std::string asset_fname,
-                              std::string data) {
+                              std::string staged_fname) {
 	if (verify_auction_id(a_id) == -1) {
 		return -1;
 	}
@@ -665,80 +600,248 @@ int Database::CreateAssetFile(std::string a_id, std::string asset_fname,
 	dir_name += "/ASSET/";
 	dir_name += asset_fname;
 
-	std::ofstream file;
+	if (rename(staged_fname.c_str(), dir_name.c_str()) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+// The bid log is an array of IndexedBid records, as laid out in memory
+static_assert(sizeof(IndexedBid) == 16, "Bid log records must be 16 bytes");
+
+/**
+ * @brief  Path to the bid log of an auction.
+ * @param  a_id: The auction's id.
+ * @retval The path, ASDIR/AUCTIONS/<aid>/BIDS_<aid>.log.
+ */
+static std::string bid_log_name(std::string a_id) {
+	std::string log_name = "ASDIR/AUCTIONS/" + a_id;
+	log_name += "/BIDS_";
+	log_name += a_id;
+	log_name += ".log";
+	return log_name;
+}
+
+/**
+ * @brief  Appends a bid to the auction's bid log and adds it to the auction
+ * index. The record is written with a single write to the log opened with
+ * O_APPEND, and cut off again if only part of it is written, so the log only
+ * holds whole records.
+ * @param  a_id: The auction's id, in the index.
+ * @param  &bid: The bid, larger than the ones in the log.
+ * @retval -1 if the id is invalid or the bid isn't properly written.
+ * @retval 0 if the bid is written.
+ */
+int Database::AppendBid(std::string a_id, const IndexedBid &bid) {
+	if (verify_auction_id(a_id) == -1) {
+		return -1;
+	}
 
-	file.open(dir_name, std::ofstream::trunc);
-	if (!file.good()) {
+	std::string log_name = bid_log_name(a_id);
+	int fd = open(log_name.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+	              0600);
+	if (fd == -1) {
 		return -1;
 	}
 
-	file << data;
-	file.close();
+	ssize_t written = write(fd, &bid, sizeof(bid));
+	if (written > 0 && written != static_cast<ssize_t>(sizeof(bid))) {
+		// Cut off the part of the record that was written
+		struct stat log_stat;
+		if (fstat(fd, &log_stat) == 0) {
+			int cut = ftruncate(fd, log_stat.st_size - written);
+			(void) cut;
+		}
+	}
 
+	close(fd);
+	if (written != static_cast<ssize_t>(sizeof(bid))) {
+		return -1;
+	}
+
+	_index->addBid(static_cast<uint32_t>(stoi(a_id)), bid);
 	return 0;
 }
 
 /**
- * @brief  Creates the bid file.
+ * @brief  Compares the bids by their values in order to sort them.
+ * @param  &a: First bid.
+ * @param  &b: Second bid.
+ * @retval true if the value of the first bid is smaller than the second's.
+ * @retval false if otherwise.
+ */
+static bool CompareBidsByValue(const IndexedBid &a, const IndexedBid &b) {
+	return a.value < b.value;
+}
+
+/**
+ * @brief  Maps the auction's bid log to read its bids. A partial record at
+ * the end of the log is left out.
  * @param  a_id: The auction's id.
- * @param  user_id: The user's id.
- * @param  value: The value of the bid.
- * @throws AuctionNotFound if the auction doesn't exist.
- * @retval -1 if either id is invalid, the value is invalid, the auction doesn't
- * exist, or the file isn't properly created.
- * @retval 0 if the creation is successful.
+ * @param  &bid_count: Filled with the number of bids.
+ * @retval The bids, from the first to the latest, NULL if there are none or
+ * the log can't be read. Unmapped with UnmapBidLog.
  */
-int Database::CreateBidFile(std::string a_id, std::string user_id,
-                            std::string value) {
-	if (verify_value(static_cast<uint32_t>(stol(value))) == -1) {
-		return -1;
+const IndexedBid *Database::MapBidLog(std::string a_id, size_t &bid_count) {
+	bid_count = 0;
+	std::string log_name = bid_log_name(a_id);
+	int fd = open(log_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return NULL;
 	}
 
-	if (verify_user_id(user_id) == -1) {
+	struct stat log_stat;
+	if (fstat(fd, &log_stat) == -1 ||
+	    static_cast<size_t>(log_stat.st_size) < sizeof(IndexedBid)) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t count = static_cast<size_t>(log_stat.st_size) / sizeof(IndexedBid);
+	void *mapping =
+		mmap(NULL, count * sizeof(IndexedBid), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	bid_count = count;
+	return static_cast<const IndexedBid *>(mapping);
+}
+
+/**
+ * @brief  Unmaps a bid log.
+ * @param  *bids: The bids returned by MapBidLog.
+ * @param  bid_count: The number of bids.
+ * @retval None
+ */
+void Database::UnmapBidLog(const IndexedBid *bids, size_t bid_count) {
+	if (bids != NULL) {
+		munmap(const_cast<IndexedBid *>(bids), bid_count * sizeof(IndexedBid));
+	}
+}
+
+/**
+ * @brief  Copies the bids of an auction from the layout used before the bid
+ * log, a file for each bid in its Bids directory, into its bid log. The log
+ * is written aside and synced before it is renamed into place. The previous
+ * layout is only removed (see RemoveOldBids) once every auction is copied.
+ * @param  a_id: The auction's id.
+ * @param  start_time: When the auction started, in seconds since the epoch.
+ * @retval -1 if a bid file can't be read or the log isn't properly written.
+ * @retval 0 if there was nothing to copy or the bids were copied.
+ */
+int Database::MigrateBids(std::string a_id, uint32_t start_time) {
+	std::string dir_name = "ASDIR/AUCTIONS/" + a_id;
+	dir_name += "/BIDS";
+
+	std::error_code error;
+	std::string log_name = bid_log_name(a_id);
+	if (!fs::is_directory(dir_name, error) ||
+	    access(log_name.c_str(), F_OK) == 0) {
+		return 0;
+	}
+
+	std::vector<IndexedBid> bids;
+	BidInfo bid;
+	fs::directory_iterator entries(dir_name, error);
+	if (error) {
 		return -1;
 	}
+	for (const auto &entry : entries) {
+		if (GetBid(entry.path(), bid) == -1 ||
+		    verify_user_id(bid.user_id) == -1 || bid.value.empty() ||
+		    verify_start_value(bid.value) == -1) {
+			return -1;
+		}
+		IndexedBid logged_bid;
+		logged_bid.user_id = static_cast<uint32_t>(stol(bid.user_id));
+		logged_bid.value = static_cast<uint32_t>(stol(bid.value));
+		logged_bid.bid_time = start_time + bid.time_passed;
+		logged_bid.time_passed = bid.time_passed;
+		bids.push_back(logged_bid);
+	}
+	std::sort(bids.begin(), bids.end(), CompareBidsByValue);
 
-	if (verify_auction_id(a_id) == -1) {
+	std::string tmp_name = log_name + ".tmp";
+	int fd =
+		open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
 		return -1;
 	}
-	StartInfo start;
-	FILE *fp;
-	time_t fulltime;
-	std::string current_date = GetCurrentDate();
-	uint32_t current_time = static_cast<uint32_t>(time(&fulltime));
-	if (GetStart(a_id, start) == -1) {
-		throw AuctionNotFound();
+	size_t size = bids.size() * sizeof(IndexedBid);
+	if (write(fd, bids.data(), size) != static_cast<ssize_t>(size) ||
+	    fsync(fd) == -1) {
+		close(fd);
+		unlink(tmp_name.c_str());
 		return -1;
-	};
-	uint32_t start_time = start.current_time;
-	uint32_t time_passed = current_time - start_time;
+	}
+	close(fd);
+	if (rename(tmp_name.c_str(), log_name.c_str()) == -1) {
+		unlink(tmp_name.c_str());
+		return -1;
+	}
 
-	std::string dir_name = "ASDIR/AUCTIONS/" + a_id;
-	dir_name += "/BIDS/";
-	dir_name += value;
-	dir_name += ".txt";
+	return 0;
+}
 
-	std::string content = user_id + " ";
-	content += value;
-	content += " ";
-	content += current_date;
-	content += " ";
-	content += std::to_string(time_passed);
+/**
+ * @brief  Removes the bids of an auction in the layout used before the bid
+ * log, its Bids directory and its highest bid file. Only called once the bids
+ * of every auction are in their logs.
+ * @param  a_id: The auction's id.
+ * @retval None
+ */
+void Database::RemoveOldBids(std::string a_id) {
+	std::string highest_name = "ASDIR/AUCTIONS/" + a_id;
+	highest_name += "/HIGHEST_";
+	highest_name += a_id;
+	highest_name += ".txt";
+	unlink(highest_name.c_str());
 
-	const char *file_content = content.c_str();
+	std::string dir_name = "ASDIR/AUCTIONS/" + a_id;
+	dir_name += "/BIDS";
+	std::error_code error;
+	fs::remove_all(dir_name, error);
+}
 
-	const char *dir_fname = dir_name.c_str();
+/**
+ * @brief  Adds the bids of an auction's bid log to the auction index: its
+ * highest bid, its bid count, its bidders and its latest bids.
+ * @param  a_id: The auction's id, in the index.
+ * @retval None
+ */
+void Database::LoadBids(std::string a_id) {
+	uint32_t aid = static_cast<uint32_t>(stoi(a_id));
+	size_t bid_count;
+	const IndexedBid *bids = MapBidLog(a_id, bid_count);
 
-	fp = fopen(dir_fname, "w");
-	if (fp == NULL) {
-		return -1;
+	// A record cut short by a crash would misalign the ones appended after it
+	std::string log_name = bid_log_name(a_id);
+	off_t log_size = static_cast<off_t>(bid_count * sizeof(IndexedBid));
+	struct stat log_stat;
+	if (stat(log_name.c_str(), &log_stat) == 0 &&
+	    log_stat.st_size != log_size) {
+		int cut = truncate(log_name.c_str(), log_size);
+		(void) cut;
 	}
 
-	fprintf(fp, "%s", file_content);
+	uint32_t highest_bid = 0;
+	for (size_t i = 0; i < bid_count; i++) {
+		highest_bid = std::max(highest_bid, bids[i].value);
+		_index->addBidder(aid, bids[i].user_id);
+	}
+	_index->setBids(aid, highest_bid, static_cast<uint32_t>(bid_count));
 
-	fclose(fp);
+	size_t first = bid_count > AUCTION_INDEX_RECENT_BIDS
+	                   ? bid_count - AUCTION_INDEX_RECENT_BIDS
+	                   : 0;
+	for (size_t i = first; i < bid_count; i++) {
+		_index->addRecentBid(aid, bids[i]);
+	}
 
-	return 0;
+	UnmapBidLog(bids, bid_count);
 }
 
 /**
@@ -883,11 +986,21 @@ int Database::GetBid(std::string bid_fname, BidInfo &result) {
  * @retval The date obtained.
  */
 std::string Database::GetCurrentDate() {
-	time_t fulltime;
+	return FormatDate(time(NULL));
+}
+
+/**
+ * @brief  Formats a time as a date.
+ * @param  fulltime: The time, in seconds since the epoch.
+ * @retval The date, as YYYY-MM-DD HH:MM:SS.
+ */
+std::string Database::FormatDate(time_t fulltime) {
+	struct tm current_tm;
 	struct tm *current_time;
 	char time_str[40];
-	time(&fulltime);  // Get current time in seconds starting at 1970
-	current_time = gmtime(&fulltime);  // Convert time to YYYY−MM−DD HH:MM:SS
+	// Convert time to YYYY−MM−DD HH:MM:SS (reentrant, handlers may run on
+	// several threads)
+	current_time = gmtime_r(&fulltime, &current_tm);
 	sprintf(time_str, "%4u-%02u-%02u %02u:%02u:%02u",
 	        current_time->tm_year + 1900, current_time->tm_mon + 1,
 	        current_time->tm_mday, current_time->tm_hour, current_time->tm_min,
@@ -958,6 +1071,8 @@ int Database::Close(std::string a_id) {
 		return DB_CLOSE_NOK;
 	}
 
+	_index->closeAuction(static_cast<uint32_t>(stoi(a_id)));
+
 	if (ended == 0) {
 		return DB_CLOSE_OK;
 	}
@@ -970,6 +1085,89 @@ int Database::Close(std::string a_id) {
 	return -1;
 }
 
+/**
+ * @brief  Builds the auction index from ASDIR: the start and end files and the
+ * bid log of every auction. Bids still in the previous layout are copied into
+ * the logs first, and the previous layout is removed once all of them are.
+ * @retval -1 if the bids of an auction can't be copied, nothing is removed.
+ * @retval 0 if successful.
+ */
+int Database::BuildIndex() {
+	StartInfo start;
+	std::vector<std::string> a_ids;
+
+	for (const auto &entry : fs::directory_iterator("ASDIR/AUCTIONS")) {
+		std::string a_id = entry.path();
+		a_id.erase(a_id.begin(), a_id.end() - 3);
+		if (verify_auction_id(a_id) == -1 || GetStart(a_id, start) == -1) {
+			continue;
+		}
+
+		if (MigrateBids(a_id, start.current_time) == -1) {
+			std::cout << "[ERROR] Failed to move the bids of auction " << a_id
+					  << " into its bid log" << std::endl;
+			return -1;
+		}
+		a_ids.push_back(a_id);
+
+		uint32_t aid = static_cast<uint32_t>(stoi(a_id));
+		_index->addAuction(aid, static_cast<uint32_t>(stol(start.user_id)),
+		                   start.current_time,
+		                   static_cast<uint32_t>(stol(start.timeactive)),
+		                   static_cast<uint32_t>(stol(start.start_value)));
+
+		std::string end_name = "ASDIR/AUCTIONS/" + a_id;
+		end_name += "/END_";
+		end_name += a_id;
+		end_name += ".txt";
+		if (CheckEndExists(end_name.c_str()) == 0) {
+			_index->closeAuction(aid);
+		}
+
+		LoadBids(a_id);
+	}
+
+	// Every bid is in a log, the logs also hold the bidders of the Bidded
+	// directories
+	for (const std::string &a_id : a_ids) {
+		RemoveOldBids(a_id);
+	}
+	std::error_code error;
+	for (const auto &user : fs::directory_iterator("ASDIR/USERS")) {
+		fs::remove_all(user.path() / "BIDDED", error);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Lists an auction of the index, closing it if its time is up. The
+ * lock must be held.
+ * @param  aid: The auction's id, in the index.
+ * @param  current_time: Current time, in seconds since the epoch.
+ * @retval The auction's id and whether it's still active.
+ */
+AuctionListing Database::GetListing(uint32_t aid, uint32_t current_time) {
+	IndexedAuction *indexed = _index->auction(aid);
+	AuctionListing auction;
+	auction.a_id = convert_auction_id_to_str(aid);
+
+	if (!indexed->closed) {
+		uint32_t time_passed = current_time - indexed->start_time;
+		if (time_passed >= indexed->timeactive) {
+			try {
+				Close(auction.a_id);
+			} catch (...) {
+				// Listed as ended even if its end can't be written, the
+				// caller holds the lock and still has to release it
+			}
+		} else {
+			auction.active = true;
+		}
+	}
+	return auction;
+}
+
 /**
  * @brief  Gets the path to the image of the asset.
  * @param  a_id: The auction's id.
@@ -1046,24 +1244,32 @@ int Database::CheckAuctionExists(std::string a_id) {
 }
 
 /**
- * @brief  Gets the data of the asset's image.
+ * @brief  Opens the asset's image so that it can be sent straight from the
+ * file.
  * @param  asset_fname: The path to the asset.
- * @retval The asset's image data.
+ * @param  &fsize: Filled with the size of the asset.
+ * @retval File descriptor of the asset, -1 if it can't be opened.
  */
-std::string Database::GetAssetData(std::string asset_fname) {
-	std::ifstream file(asset_fname);
-	std::stringstream buffer;
-	buffer << file.rdbuf();
-	file.close();
-	return buffer.str();
+int Database::OpenAssetFile(std::string asset_fname, size_t &fsize) {
+	int fd = open(asset_fname.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return -1;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == -1) {
+		close(fd);
+		return -1;
+	}
+	fsize = static_cast<size_t>(file_stat.st_size);
+	return fd;
 }
 
 /**
  * @brief  Creates the necessary directories for the system to function and
  * initializes the semaphore.
  * @param  sem_id: The semaphore's id.
- * @retval -1 if the semaphore isn't initialized or the directories' creation
- * fails.
+ * @retval -1 if the semaphore isn't initialized, the directories' creation
+ * fails or the bids of an auction can't be moved into its log.
  */
 int Database::CreateBaseDir(int sem_id) {
 	const char *asdir = "ASDIR";
@@ -1074,21 +1280,61 @@ int Database::CreateBaseDir(int sem_id) {
 		return -1;
 	}
 
-	if (mkdir(asdir, 0700) == -1) {
+	// Uploads left by a server that stopped mid upload are dropped
+	std::error_code error;
+	fs::remove_all(DB_UPLOADS_DIR, error);
+
+	if (mkdir(asdir, 0700) == -1 && errno != EEXIST) {
+		return -1;
+	}
+
+	if (mkdir(users, 0700) == -1 && errno != EEXIST) {
+		return -1;
+	}
+
+	if (mkdir(auctions, 0700) == -1 && errno != EEXIST) {
 		return -1;
 	}
 
-	if (mkdir(users, 0700) == -1) {
+	if (mkdir(DB_UPLOADS_DIR, 0700) == -1) {
 		return -1;
 	}
 
-	if (mkdir(auctions, 0700) == -1) {
+	// Mapped before forking, so every process updates the same index
+	_index = create_auction_index();
+	if (BuildIndex() == -1) {
 		return -1;
 	}
 
 	return 0;
 }
 
+/**
+ * @brief  Creates an empty file for the asset of an auction being opened, so
+ * that the asset can be written to disk as it is received, before the
+ * auction exists. Doesn't take the lock.
+ * @param  &staged_fname: Filled with the path of the file.
+ * @retval The file descriptor of the file, -1 if it isn't created.
+ */
+int Database::StageAsset(std::string &staged_fname) {
+	std::string fname_template = DB_UPLOADS_DIR "/XXXXXX";
+	int fd = mkostemp(&fname_template[0], O_CLOEXEC);
+	if (fd == -1) {
+		return -1;
+	}
+	staged_fname = fname_template;
+	return fd;
+}
+
+/**
+ * @brief  Deletes a staged asset that won't be used by an auction.
+ * @param  staged_fname: The staged asset, see StageAsset.
+ * @retval None
+ */
+void Database::DiscardAsset(std::string staged_fname) {
+	unlink(staged_fname.c_str());
+}
+
 /**
  * @brief  Logs the user into the system, creating a new account if the user
  * isn't yet registered.
@@ -1240,6 +1486,28 @@ int Database::Unregister(std::string user_id, std::string password) {
 	return DB_UNREGISTER_NOK;
 }
 
+/**
+ * @brief  Checks whether the user may open an auction, so that a request that
+ * will be refused is answered before its asset is received. Open checks
+ * again, the user may log out meanwhile.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @retval DB_OPEN_NOT_LOGGED_IN if the user isn't logged in.
+ * @retval DB_OPEN_CREATE_FAIL if the password is wrong.
+ * @retval DB_OPEN_ALLOWED otherwise.
+ */
+int Database::CheckOpen(std::string user_id, std::string password) {
+	int result = DB_OPEN_ALLOWED;
+	semaphore_wait();
+	if (CheckUserLoggedIn(user_id) != 0) {
+		result = DB_OPEN_NOT_LOGGED_IN;
+	} else if (CorrectPassword(user_id, password) != 1) {
+		result = DB_OPEN_CREATE_FAIL;
+	}
+	semaphore_post();
+	return result;
+}
+
 /**
  * @brief  Creates a new auction.
  * @param  user_id: The user's id.
@@ -1249,7 +1517,8 @@ int Database::Unregister(std::string user_id, std::string password) {
  * @param  start_value: The starting value of the asset.
  * @param  timeactive: The time the auction will be active for.
  * @param  fsize: The size of the data file of the asset's image.
- * @param  data: The data of the asset's image.
+ * @param  staged_fname: The asset's image, already on disk (see StageAsset).
+ * It is moved into the auction or deleted if the auction isn't created.
  * @throws UserNotLoggedIn if the user isn't logged in.
  * @retval DB_OPEN_NOT_LOGGED_IN if the user isn't logged in
  * @retval DB_OPEN_CREATE_FAIL if the password is wrong, the directory, start
@@ -1259,42 +1528,34 @@ int Database::Unregister(std::string user_id, std::string password) {
  */
 int Database::Open(std::string user_id, std::string name, std::string password,
                    std::string asset_fname, std::string start_value,
-                   std::string timeactive, size_t fsize, std::string data) {
+                   std::string timeactive, size_t fsize,
+                   std::string staged_fname) {
 	(void) fsize;
 	semaphore_wait();
 	if (CheckUserLoggedIn(user_id) != 0) {
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		throw UserNotLoggedIn();
 		return DB_OPEN_NOT_LOGGED_IN;
 	}
 	if (CorrectPassword(user_id, password) != 1) {
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		return DB_OPEN_CREATE_FAIL;
 	}
-	uint32_t aid = 0;
-	std::string new_aid;
-	uint32_t n_new_aid;
-
+	// Directories left out of the index (without a valid start file) keep
+	// their ids
+	uint32_t aid = _index->lastAid() + 1;
 	std::string dir_name = "ASDIR/AUCTIONS/";
-
-	if (fs::is_empty(dir_name)) {
-		aid = 1;
-	} else {
-		for (const auto &entry : fs::directory_iterator(dir_name)) {
-			// Goes through the entire auctions directory in order to calculate
-			// the newest auction id.
-			new_aid = entry.path();
-			new_aid.erase(new_aid.begin(), new_aid.end() - 3);
-			n_new_aid = static_cast<uint32_t>(stoi(new_aid));
-
-			if (aid <= n_new_aid) {
-				aid = n_new_aid + 1;
-			}
-		}
+	while (aid <= AUCTION_INDEX_MAX_AID &&
+	       access((dir_name + convert_auction_id_to_str(aid)).c_str(), F_OK) ==
+	           0) {
+		aid++;
 	}
 
-	if (aid > 999) {
+	if (aid > AUCTION_INDEX_MAX_AID) {
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		return DB_OPEN_CREATE_FAIL;
 	}
 
@@ -1304,6 +1565,7 @@ int Database::Open(std::string user_id, std::string name, std::string password,
 
 	if (CreateAuctionDir(c_aid) == -1) {
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		return DB_OPEN_CREATE_FAIL;
 	}
 
@@ -1311,12 +1573,14 @@ int Database::Open(std::string user_id, std::string name, std::string password,
 	                    timeactive) == -1) {
 		rmdir(a_dir_fname);
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		return DB_OPEN_CREATE_FAIL;
 	}
 
-	if (CreateAssetFile(c_aid, asset_fname, data) == -1) {
+	if (CreateAssetFile(c_aid, asset_fname, staged_fname) == -1) {
 		rmdir(a_dir_fname);
 		semaphore_post();
+		DiscardAsset(staged_fname);
 		return DB_OPEN_CREATE_FAIL;
 	}
 
@@ -1326,6 +1590,14 @@ int Database::Open(std::string user_id, std::string name, std::string password,
 		return DB_OPEN_CREATE_FAIL;
 	}
 
+	StartInfo start;
+	if (GetStart(c_aid, start) == 0) {
+		_index->addAuction(aid, static_cast<uint32_t>(stol(user_id)),
+		                   start.current_time,
+		                   static_cast<uint32_t>(stol(timeactive)),
+		                   static_cast<uint32_t>(stol(start_value)));
+	}
+
 	semaphore_post();
 	return static_cast<int>(aid);
 }
@@ -1379,7 +1651,7 @@ int Database::CloseAuction(std::string a_id, std::string user_id,
 	}
 
 	std::string dir_name = "ASDIR/AUCTIONS/" + a_id;
-	dir_name += "/END";
+	dir_name += "/END_";
 	dir_name += a_id;
 	dir_name += ".txt";
 	if (CheckEndExists(dir_name.c_str()) == 0) {
@@ -1413,195 +1685,95 @@ int Database::CloseAuction(std::string a_id, std::string user_id,
 }
 
 /**
- * @brief  Lists the auctions the user hosts.
+ * @brief  Lists the auctions the user hosts, from the auction index.
  * @param  user_id: The user's id.
- * @throws AuctionNotFound if the auction doesn't exist.
  * @retval The list of the auctions the user hosts.
  */
 AuctionList Database::MyAuctions(std::string user_id) {
-	std::string dir_name = "ASDIR/USERS/" + user_id;
-	dir_name += "/HOSTED";
-
 	AuctionList result;
-	AuctionListing auction;
-	StartInfo start;
-	time_t fulltime;
+	uint32_t host_id = static_cast<uint32_t>(stol(user_id));
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
 
 	semaphore_wait();
+	for (uint32_t aid = 1; aid <= _index->lastAid(); aid++) {
+		IndexedAuction *indexed = _index->auction(aid);
+		if (indexed != NULL && indexed->host_id == host_id) {
+			result.push_back(GetListing(aid, current_time));
+		}
+	}
+	semaphore_post();
+	return result;
+}
 
-	if (fs::is_empty(dir_name)) {
-		semaphore_post();
-		return result;  // Returns empty list which means user hosts no auctions
-	} else {
-		for (const auto &entry : fs::directory_iterator(dir_name)) {
-			// Goes through the Hosted directory in order obtain all the
-			// auctions the user hosted, closing those necessary.
-
-			std::string aid = entry.path();
-			aid.erase(aid.end() - 4, aid.end());
-			aid.erase(aid.begin(), aid.end() - 3);
-
-			auction.a_id = aid;
-			std::string aid_dir_name = "ASDIR/AUCTIONS/" + aid;
-			aid_dir_name += "/END_";
-			aid_dir_name += aid;
-			aid_dir_name += ".txt";
-
-			if (CheckEndExists(aid_dir_name.c_str()) == -1) {
-				if (GetStart(aid, start) == -1) {
-					semaphore_post();
-					throw AuctionNotFound();
-					return result;
-				};
-				uint32_t start_time = start.current_time;
-				uint32_t current_time = static_cast<uint32_t>(time(&fulltime));
-				uint32_t time_passed = current_time - start_time;
-				uint32_t timeactive =
-					static_cast<uint32_t>(stol(start.timeactive));
-
-				if (time_passed >= timeactive) {
-					Close(aid);
-					auction.active = false;
-				} else {
-					auction.active = true;
-				}
-			} else {
-				auction.active = false;
+/**
+ * @brief  Finds the auctions a user bid on in the bid logs, for a user the
+ * auction index doesn't have room for. The lock must be held.
+ * @param  bidder_id: The user's id.
+ * @retval The ids of the auctions, in order.
+ */
+std::vector<uint32_t> Database::FindBids(uint32_t bidder_id) {
+	std::vector<uint32_t> result;
+	for (uint32_t aid = 1; aid <= _index->lastAid(); aid++) {
+		if (_index->auction(aid) == NULL) {
+			continue;
+		}
+		size_t bid_count;
+		const IndexedBid *bids =
+			MapBidLog(convert_auction_id_to_str(aid), bid_count);
+		for (size_t i = 0; i < bid_count; i++) {
+			if (bids[i].user_id == bidder_id) {
+				result.push_back(aid);
+				break;
 			}
-
-			result.push_back(auction);
 		}
+		UnmapBidLog(bids, bid_count);
 	}
-
-	std::sort(result.begin(), result.end(), CompareByAid);
-	semaphore_post();
 	return result;
 }
 
 /**
- * @brief  Lists the auctions the user bid on.
+ * @brief  Lists the auctions the user bid on, from the auction index. The bid
+ * logs are read instead if the index doesn't have room for the user.
  * @param  user_id: The user's id.
- * @throws AuctionNotFound if the auction doesn't exist.
  * @retval The list of the auctions the user bid on.
  */
 AuctionList Database::MyBids(std::string user_id) {
-	std::string bidded_dir_name = "ASDIR/USERS/" + user_id;
-	bidded_dir_name += "/BIDDED";
-
 	AuctionList result;
-	AuctionListing auction;
-	StartInfo start;
-	time_t fulltime;
+	uint32_t bidder_id = static_cast<uint32_t>(stol(user_id));
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
 
 	semaphore_wait();
-
-	if (fs::is_empty(bidded_dir_name)) {
-		semaphore_post();
-		return result;  // Returns empty list which means user made no bids
-	} else {
-		for (const auto &entry : fs::directory_iterator(bidded_dir_name)) {
-			// Goes through the Bidded directory in order obtain all the
-			// auctions the user bid on, closing those necessary.
-
-			std::string aid = entry.path();
-			aid.erase(aid.end() - 4, aid.end());
-			aid.erase(aid.begin(), aid.end() - 3);
-
-			auction.a_id = aid;
-			std::string dir_name = "ASDIR/AUCTIONS/" + aid;
-			dir_name += "/END_";
-			dir_name += aid;
-			dir_name += ".txt";
-
-			if (CheckEndExists(dir_name.c_str()) == -1) {
-				if (GetStart(aid, start) == -1) {
-					semaphore_post();
-					throw AuctionNotFound();
-					return result;
-				};
-				uint32_t start_time = start.current_time;
-				uint32_t current_time = static_cast<uint32_t>(time(&fulltime));
-				uint32_t time_passed = current_time - start_time;
-				uint32_t timeactive =
-					static_cast<uint32_t>(stol(start.timeactive));
-
-				if (time_passed >= timeactive) {
-					Close(aid);
-					auction.active = false;
-				} else {
-					auction.active = true;
-				}
-			} else {
-				auction.active = false;
+	if (_index->knowsBidder(bidder_id)) {
+		for (uint32_t aid = 1; aid <= _index->lastAid(); aid++) {
+			if (_index->hasBid(aid, bidder_id)) {
+				result.push_back(GetListing(aid, current_time));
 			}
-
-			result.push_back(auction);
 		}
+		semaphore_post();
+		return result;
 	}
 
-	std::sort(result.begin(), result.end(), CompareByAid);
+	for (uint32_t aid : FindBids(bidder_id)) {
+		result.push_back(GetListing(aid, current_time));
+	}
 	semaphore_post();
 	return result;
 }
 
 /**
- * @brief  Lists all auctions.
- * @throws AuctionNotFound if the auction doesn't exist.
+ * @brief  Lists all auctions, from the auction index.
  * @retval The list containing every auction.
  */
 AuctionList Database::List() {
-	std::string Dir_name = "ASDIR/AUCTIONS";
-
 	AuctionList result;
-	AuctionListing auction;
-	StartInfo start;
-	time_t fulltime;
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
 
-	if (fs::is_empty(Dir_name)) {
-		semaphore_post();
-		return result;  // Returns empty list which means no auctions were
-		                // ever made
-	} else {
-		for (const auto &entry : fs::directory_iterator(Dir_name)) {
-			// Goes through the Auctions directory in order obtain all the
-			// auctions, closing those necessary.
-
-			std::string aid = entry.path();
-			aid.erase(aid.begin(), aid.end() - 3);
-
-			auction.a_id = aid;
-			std::string dir_name = "ASDIR/AUCTIONS/" + aid;
-			dir_name += "/END_";
-			dir_name += aid;
-			dir_name += ".txt";
-
-			if (CheckEndExists(dir_name.c_str()) == -1) {
-				if (GetStart(aid, start) == -1) {
-					semaphore_post();
-					throw AuctionNotFound();
-					return result;
-				};
-				uint32_t start_time = start.current_time;
-				uint32_t current_time = static_cast<uint32_t>(time(&fulltime));
-				uint32_t time_passed = current_time - start_time;
-				uint32_t timeactive =
-					static_cast<uint32_t>(stol(start.timeactive));
-
-				if (time_passed >= timeactive) {
-					Close(aid);
-					auction.active = false;
-				} else {
-					auction.active = true;
-				}
-			} else {
-				auction.active = false;
-			}
-
-			result.push_back(auction);
+	semaphore_wait();
+	for (uint32_t aid = 1; aid <= _index->lastAid(); aid++) {
+		if (_index->auction(aid) != NULL) {
+			result.push_back(GetListing(aid, current_time));
 		}
 	}
-
-	std::sort(result.begin(), result.end(), CompareByAid);
 	semaphore_post();
 	return result;
 }
@@ -1611,7 +1783,7 @@ AuctionList Database::List() {
  * @param  a_id: The auction's id.
  * @throws AssetDoesNotExist if the asset doesn't exist.
  * @retval DB_SHOW_ASSET_ERROR if the auction has not asset.
- * @retval Otherwise shows the asset's info.
+ * @retval Otherwise the asset's info, with the asset open for reading.
  */
 AssetInfo Database::ShowAsset(std::string a_id) {
 	AssetInfo asset;
@@ -1625,8 +1797,12 @@ AssetInfo Database::ShowAsset(std::string a_id) {
 		return DB_SHOW_ASSET_ERROR;
 	}
 
-	asset.fdata = GetAssetData(asset_dir);
-	asset.fsize = (asset.fdata).size();
+	// Opened under the lock, the file stays readable if replaced afterwards
+	asset.fd = OpenAssetFile(asset_dir, asset.fsize);
+	if (asset.fd == -1) {
+		semaphore_post();
+		throw AssetDoesNotExist();
+	}
 
 	asset_dir.erase(asset_dir.begin(), asset_dir.begin() + 25);
 	asset.asset_fname = asset_dir;
@@ -1649,7 +1825,7 @@ AssetInfo Database::ShowAsset(std::string a_id) {
  * @retval DB_BID_NOK if the user isn't logged in, the password is wrong, the
  * auction doesn't exist, the user attempts to bid on an auction they hosted,
  * the auction is already closed, or the bid's value is too low.
- * @retval DB_BID_REFUSE if the bid isn't created successfully.
+ * @retval DB_BID_REFUSE if the bid isn't stored, it is answered as refused.
  * @retval DB_BID_ACCEPT if the bid is successfully created.
  */
 int Database::Bid(std::string user_id, std::string password, std::string a_id,
@@ -1664,89 +1840,53 @@ int Database::Bid(std::string user_id, std::string password, std::string a_id,
 		semaphore_post();
 		return DB_BID_NOK;
 	}
-	if (CheckAuctionExists(a_id) == -1) {
+	IndexedAuction *indexed = NULL;
+	if (verify_auction_id(a_id) == 0) {
+		indexed = _index->auction(static_cast<uint32_t>(stoi(a_id)));
+	}
+	if (indexed == NULL) {
 		semaphore_post();
 		throw AuctionNotFound();
 		return DB_BID_NOK;
 	}
-	if (CheckAuctionBelongs(a_id, user_id) == 0) {
+	if (indexed->host_id == static_cast<uint32_t>(stol(user_id))) {
 		semaphore_post();
 		throw BidOnSelf();
 		return DB_BID_NOK;
 	}
 
-	BidInfo bid;
-	StartInfo start;
-	long value = stol(bid_value);
-
-	std::string end_dir_name = "ASDIR/AUCTIONS/" + a_id;
-	end_dir_name += "/END_";
-	end_dir_name += a_id;
-	end_dir_name += ".txt";
-
-	if (CheckEndExists(end_dir_name.c_str()) == 0) {
+	if (indexed->closed) {
 		semaphore_post();
 		throw AuctionAlreadyClosed();
 		return DB_BID_NOK;
 	}
 
-	if (GetStart(a_id, start) == -1) {
-		semaphore_post();
-		throw AuctionNotFound();
-		return DB_BID_NOK;
-	};
-
-	time_t fulltime;
-	uint32_t start_time = start.current_time;
-	uint32_t current_time = static_cast<uint32_t>(time(&fulltime));
-	uint32_t time_passed = current_time - start_time;
-	uint32_t timeactive = static_cast<uint32_t>(stol(start.timeactive));
-	if (time_passed >= timeactive) {
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
+	uint32_t time_passed = current_time - indexed->start_time;
+	if (time_passed >= indexed->timeactive) {
 		Close(a_id);
+		semaphore_post();
 		throw AuctionAlreadyClosed();
 		return DB_BID_NOK;
 	}
 
-	std::string bid_dir_name = "ASDIR/AUCTIONS/" + a_id;
-	bid_dir_name += "/BIDS/";
-
-	std::string bid_fname;
-
-	if (fs::is_empty(bid_dir_name)) {
-		// If the value isn't greater than the starting value of the asset it's
-		// not a correct bid.
-
-		long old_value = stol(start.start_value);
-
-		if (old_value >= value) {
-			semaphore_post();
-			throw LargerBidAlreadyExists();
-			return DB_BID_NOK;
-		}
-	} else {
-		for (const auto &entry : fs::directory_iterator(bid_dir_name)) {
-			// If the value isn't greater than an existing bid it's not a
-			// correct bid.
-
-			bid_fname = entry.path();
-
-			GetBid(bid_fname, bid);
-			long old_value = stol(bid.value);
-
-			if (old_value >= value) {
-				semaphore_post();
-				throw LargerBidAlreadyExists();
-				return DB_BID_NOK;
-			}
-		}
-	}
-
-	if (RegisterBid(user_id, a_id) == -1) {
+	// The bid must be larger than the highest one, or than the starting value
+	// if there are none
+	long value = stol(bid_value);
+	long highest = indexed->bid_count > 0 ? indexed->highest_bid
+	                                      : indexed->start_value;
+	if (highest >= value) {
 		semaphore_post();
-		return DB_BID_REFUSE;
+		throw LargerBidAlreadyExists();
+		return DB_BID_NOK;
 	}
 
-	if (CreateBidFile(a_id, user_id, bid_value) == -1) {
+	IndexedBid bid;
+	bid.user_id = static_cast<uint32_t>(stol(user_id));
+	bid.value = static_cast<uint32_t>(value);
+	bid.bid_time = current_time;
+	bid.time_passed = time_passed;
+	if (verify_value(bid.value) == -1 || AppendBid(a_id, bid) == -1) {
 		semaphore_post();
 		return DB_BID_REFUSE;
 	}
@@ -1763,13 +1903,10 @@ int Database::Bid(std::string user_id, std::string password, std::string a_id,
  * @retval The acutin's information and the most recent 50 bids on it.
  */
 AuctionRecord Database::ShowRecord(std::string a_id) {
-	BidInfo bid;
 	time_t fulltime;
 	StartInfo start;
 	EndInfo end;
-	uint32_t n = 0;
 	AuctionRecord result;
-	BidList list;
 
 	semaphore_wait();
 	if (GetStart(a_id, start) == -1) {
@@ -1811,24 +1948,18 @@ AuctionRecord Database::ShowRecord(std::string a_id) {
 		result.active = true;
 	}
 
-	std::string dir_name = "ASDIR/AUCTIONS/" + a_id;
-	dir_name += "/BIDS";
-
-	std::string bid_fname;
-	for (const auto &entry : fs::directory_iterator(dir_name)) {
-		n++;
-		bid_fname = entry.path();
-		GetBid(bid_fname, bid);
-		list.push_back(bid);
-	}
-
-	std::sort(list.begin(), list.end(), CompareByValue);
-
-	if (n > 50) {
-		list.erase(list.begin(), list.end() - 50);
+	// The latest bids are the highest ones, kept in the auction index
+	IndexedBid recent[AUCTION_INDEX_RECENT_BIDS];
+	size_t n = _index->recentBids(static_cast<uint32_t>(stoi(a_id)), recent);
+	for (size_t i = 0; i < n; i++) {
+		BidInfo bid;
+		bid.user_id = convert_user_id_to_str(recent[i].user_id);
+		bid.value = std::to_string(recent[i].value);
+		bid.current_date = FormatDate(recent[i].bid_time);
+		bid.time_passed = recent[i].time_passed;
+		result.list.push_back(bid);
 	}
 
-	result.list = list;
 	semaphore_post();
 	return result;
 }
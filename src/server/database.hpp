@@ -25,6 +25,8 @@
 #include <string>
 #include <vector>
 
+#include "auction_index.hpp"
+
 #define DB_LOGIN_NOK      -1
 #define DB_LOGIN_OK       0
 #define DB_LOGIN_REGISTER 2
@@ -41,6 +43,7 @@
 #define DB_CLOSE_OK            0
 #define DB_CLOSE_ENDED_ALREADY 2
 
+#define DB_OPEN_ALLOWED       0
 #define DB_OPEN_NOT_LOGGED_IN -1
 #define DB_OPEN_CREATE_FAIL   -2
 
@@ -48,6 +51,9 @@
 
 #define DB_SHOW_ASSET_ERROR asset
 
+// Assets being received, moved into their auction once it is created
+#define DB_UPLOADS_DIR "ASDIR/UPLOADS"
+
 #define DB_BID_NOK    -2
 #define DB_BID_REFUSE -1
 #define DB_BID_ACCEPT 0
@@ -177,7 +183,7 @@ typedef struct {
 typedef struct {
 	std::string asset_fname;
 	size_t fsize;
-	std::string fdata;
+	int fd;  // Open asset, closed by whoever sends it
 } AssetInfo;
 
 /**
@@ -208,18 +214,17 @@ typedef struct {
 	uint32_t end_timeelapsed;
 } AuctionRecord;
 
-bool CompareByAid(const AuctionListing &a, const AuctionListing &b);
-bool CompareByValue(const BidInfo &a, const BidInfo &b);
-
 /**
  * @brief  Class that represents a database instance. Contains all the functions
  * necessary to create new files and interact with the existing ones in order to
- * simulate the users and auctions.
+ * simulate the users and auctions. This is the ASDIR backend, the default one,
+ * other backends (see wal_database.hpp) override its virtual functions.
  */
 class Database {
    protected:
 	sem_t *_sem;
 	int _lock_id;
+	AuctionIndex *_index = NULL;  // Shared by every process, see BuildIndex
 
 	// Internal functions
 	int semaphore_init(int port_n);
@@ -233,7 +238,6 @@ class Database {
 	int CreateLogin(std::string user_id);
 	int CreatePassword(std::string user_id, std::string password);
 	int RegisterHost(std::string user_id, std::string a_id);
-	int RegisterBid(std::string user_id, std::string a_id);
 	int CheckLoginExists(const char *login_id_fname);
 	int EraseLogin(std::string user_id);
 	int CheckPasswordExists(const char *password_fname);
@@ -245,37 +249,51 @@ class Database {
 	int CheckEndExists(const char *end_fname);
 	int CreateEndFile(std::string a_id);
 	int CreateAssetFile(std::string a_id, std::string asset_fname,
-	                    std::string data);
-	int CreateBidFile(std::string a_id, std::string user_id, std::string value);
+	                    std::string staged_fname);
+	virtual int AppendBid(std::string a_id, const IndexedBid &bid);
+	const IndexedBid *MapBidLog(std::string a_id, size_t &bid_count);
+	void UnmapBidLog(const IndexedBid *bids, size_t bid_count);
+	int MigrateBids(std::string a_id, uint32_t start_time);
+	void RemoveOldBids(std::string a_id);
+	void LoadBids(std::string a_id);
 	int GetStart(std::string a_id, StartInfo &result);
 	int GetEnd(const char *end_fname, EndInfo &end);
 	int GetBid(std::string bid_fname, BidInfo &result);
 	std::string GetCurrentDate();
-	int CorrectPassword(std::string user_id, std::string password);
+	std::string FormatDate(time_t fulltime);
+	virtual int CorrectPassword(std::string user_id, std::string password);
 	std::string GetAssetDir(std::string a_id);
 	int CheckAuctionExists(std::string a_id);
 	int CheckAuctionBelongs(std::string a_id, std::string user_id);
-	std::string GetAssetData(std::string asset_fname);
-	int Close(std::string a_id);
+	int OpenAssetFile(std::string asset_fname, size_t &fsize);
+	virtual int Close(std::string a_id);
+	virtual std::vector<uint32_t> FindBids(uint32_t bidder_id);
+	int BuildIndex();
+	AuctionListing GetListing(uint32_t aid, uint32_t current_time);
 
    public:
-	int CreateBaseDir(int sem_id);
-	int CheckUserLoggedIn(std::string user_id);
-	int LoginUser(std::string user_id, std::string password);
-	int Logout(std::string user_id, std::string password);
-	int Unregister(std::string user_id, std::string password);
-	int Open(std::string user_id, std::string name, std::string password,
-	         std::string asset_fname, std::string start_value,
-	         std::string timeactive, size_t fsize, std::string data);
-	int CloseAuction(std::string a_id, std::string user_id,
-	                 std::string password);
+	virtual ~Database();
+	virtual int CreateBaseDir(int sem_id);
+	virtual int StageAsset(std::string &staged_fname);
+	void DiscardAsset(std::string staged_fname);
+	virtual int CheckUserLoggedIn(std::string user_id);
+	virtual int LoginUser(std::string user_id, std::string password);
+	virtual int Logout(std::string user_id, std::string password);
+	virtual int Unregister(std::string user_id, std::string password);
+	int CheckOpen(std::string user_id, std::string password);
+	virtual int Open(std::string user_id, std::string name,
+	                 std::string password, std::string asset_fname,
+	                 std::string start_value, std::string timeactive,
+	                 size_t fsize, std::string staged_fname);
+	virtual int CloseAuction(std::string a_id, std::string user_id,
+	                         std::string password);
 	AuctionList MyAuctions(std::string user_id);
 	AuctionList MyBids(std::string user_id);
 	AuctionList List();
-	AssetInfo ShowAsset(std::string a_id);
+	virtual AssetInfo ShowAsset(std::string a_id);
 	int Bid(std::string user_id, std::string password, std::string a_id,
 	        std::string value);
-	AuctionRecord ShowRecord(std::string a_id);
+	virtual AuctionRecord ShowRecord(std::string a_id);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,821 @@
+/**
+ * @file event_loop.cpp
+ * @brief Implementation of the epoll based TCP engine.
+ */
+#include "event_loop.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#include "handlers.hpp"
+#include "output.hpp"
+
+#define EPOLL_MAX_EVENTS      64
+#define EPOLL_WAIT_TIMEOUT_MS 1000
+#define EVENT_LOOP_READ_LEN   65536
+
+// -------------------------------------
+// | Request framing				   |
+// -------------------------------------
+
+/**
+ * @brief  Finds the end of the header of an OPA request, up to its file data.
+ * @param  *data: Bytes received, starting with an OPA request.
+ * @param  len: Number of bytes received.
+ * @param  &fsize: Set to the size of the file data, or to SIZE_MAX if the
+ * header is malformed and should be handled as it is.
+ * @retval Length of the header (or of the malformed part), 0 if it isn't
+ * complete yet.
+ */
+size_t frame_opa_header(const char *data, size_t len, size_t &fsize) {
+	// OPA UID password name start_value timeactive Fname Fsize Fdata
+	fsize = SIZE_MAX;
+	size_t spaces = 0;
+	size_t fsize_start = 0;
+	size_t pos = PROTOCOL_SIZE;
+	for (; pos < len && pos <= TCP_MAX_HEADER_LEN; pos++) {
+		if (data[pos] == '\n') {
+			return pos + 1;
+		}
+		if (data[pos] == ' ' && ++spaces == OPA_HEADER_FIELDS) {
+			fsize_start = pos + 1;
+		} else if (data[pos] == ' ' && spaces > OPA_HEADER_FIELDS) {
+			break;
+		}
+	}
+	if (spaces <= OPA_HEADER_FIELDS) {
+		return pos > TCP_MAX_HEADER_LEN ? len : 0;
+	}
+
+	// pos is the space between Fsize and the file data
+	if (pos == fsize_start || pos - fsize_start > MAX_FILE_SIZE_LENGTH) {
+		return pos + 1;
+	}
+	size_t size = 0;
+	for (size_t i = fsize_start; i < pos; i++) {
+		if (!isdigit(data[i])) {
+			return pos + 1;
+		}
+		size = size * 10 + static_cast<size_t>(data[i] - '0');
+	}
+	if (size <= MAX_FILE_SIZE) {
+		fsize = size;
+	}
+	return pos + 1;
+}
+
+/**
+ * @brief  Finds the end of the first request in the bytes received from a
+ * connection. Requests end with a delimiter, except OPA whose file data may
+ * contain delimiters and so its size is taken from the Fsize header field.
+ * Malformed requests are framed as they are so that the handler answers them.
+ * @param  *data: Bytes received.
+ * @param  len: Number of bytes received.
+ * @retval Length of the first request or 0 if it isn't complete yet.
+ */
+size_t frame_tcp_request(const char *data, size_t len) {
+	if (len >= PROTOCOL_SIZE &&
+	    memcmp(data, CODE_OPEN_AUC_CLIENT, PROTOCOL_SIZE) == 0) {
+		size_t fsize;
+		size_t header_len = frame_opa_header(data, len, fsize);
+		if (header_len == 0 || fsize == SIZE_MAX) {
+			return header_len;
+		}
+		size_t total = header_len + fsize + 1;
+		return len >= total ? total : 0;
+	}
+
+	const char *delimiter = static_cast<const char *>(memchr(data, '\n', len));
+	if (delimiter != NULL) {
+		return static_cast<size_t>(delimiter - data) + 1;
+	}
+	return len > TCP_MAX_HEADER_LEN ? len : 0;
+}
+
+/**
+ * @brief  Tells whether the first request received is an OPA whose file data
+ * can't be told apart from the requests after it, as its Fsize is malformed or
+ * over the size limit.
+ * @param  *data: Bytes received.
+ * @param  len: Length of the first request, as framed.
+ * @retval true if the file data of the request can't be framed.
+ */
+bool tcp_asset_unframed(const char *data, size_t len) {
+	if (len < PROTOCOL_SIZE ||
+	    memcmp(data, CODE_OPEN_AUC_CLIENT, PROTOCOL_SIZE) != 0) {
+		return false;
+	}
+	size_t fsize;
+	size_t header_len = frame_opa_header(data, len, fsize);
+	return header_len > 0 && fsize == SIZE_MAX && data[header_len - 1] != '\n';
+}
+
+/**
+ * @brief  Writes the asset of an OPA request at the start of the bytes
+ * received to a staged file as it arrives, so that the request is never held
+ * in memory whole. The header is kept aside and handed to the handler with
+ * the end of the request once the asset is received. The header is checked
+ * first: the asset of a request that will be refused, or that can't be
+ * written, is dropped as it arrives instead.
+ * @param  &server: Server instance.
+ * @param  &connection: Connection that received bytes.
+ * @param  &request_len: Set to the length of the rest of the request once the
+ * asset is received (its delimiter), 0 until then.
+ * @retval true if an asset is being received.
+ * @retval false if the request is framed as usual.
+ */
+bool receive_tcp_asset(Server &server, Connection &connection,
+                       size_t &request_len) {
+	AssetUpload &upload = connection.upload;
+	if (upload.header.empty()) {
+		if (connection.in.size() < PROTOCOL_SIZE ||
+		    memcmp(connection.in.data(), CODE_OPEN_AUC_CLIENT,
+		           PROTOCOL_SIZE) != 0) {
+			return false;
+		}
+		size_t fsize;
+		size_t header_len = frame_opa_header(connection.in.data(),
+		                                     connection.in.size(), fsize);
+		if (header_len == 0 || fsize == SIZE_MAX) {
+			return false;
+		}
+		upload.header = connection.in.substr(0, header_len);
+		upload.left = fsize;
+		connection.in.erase(0, header_len);
+		if (accept_open_auction_asset(server, upload.header)) {
+			upload.fd = server._database->StageAsset(upload.path);
+			if (upload.fd == -1) {
+				upload.path.clear();
+			}
+		}
+	}
+
+	size_t len = std::min(upload.left, connection.in.size());
+	size_t written = 0;
+	while (written < len && upload.fd != -1) {
+		ssize_t n = write(upload.fd, connection.in.data() + written,
+		                  len - written);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			// Drop the rest, the handler answers NOK
+			close(upload.fd);
+			upload.fd = -1;
+			server._database->DiscardAsset(upload.path);
+			upload.path.clear();
+			break;
+		}
+		written += static_cast<size_t>(n);
+	}
+	connection.in.erase(0, len);
+	upload.left -= len;
+	if (upload.left == 0 && upload.fd != -1) {
+		close(upload.fd);
+		upload.fd = -1;
+	}
+
+	request_len = upload.left == 0 ? std::min<size_t>(connection.in.size(), 1)
+	                               : 0;
+	return true;
+}
+
+/**
+ * @brief  Tells whether a connection has requests to hand to the handlers.
+ * The part of an OPA asset received is written to its staged file first, so
+ * the handlers only get the request once the whole asset is received.
+ * @param  &server: Server instance.
+ * @param  &connection: Connection that received bytes.
+ * @retval true if a whole request is received or the client stopped sending.
+ * @retval false if the first request isn't complete yet.
+ */
+bool tcp_requests_ready(Server &server, Connection &connection) {
+	size_t request_len;
+	if (!receive_tcp_asset(server, connection, request_len)) {
+		request_len =
+			frame_tcp_request(connection.in.data(), connection.in.size());
+	}
+	return request_len > 0 || connection.eof;
+}
+
+/**
+ * @brief  Closes and deletes the staged asset of a connection, unless the
+ * handler took it.
+ * @param  &server: Server instance.
+ * @param  &connection: Connection receiving an asset.
+ * @retval None
+ */
+void discard_tcp_asset(Server &server, Connection &connection) {
+	AssetUpload &upload = connection.upload;
+	if (upload.fd != -1) {
+		close(upload.fd);
+	}
+	if (!upload.path.empty()) {
+		server._database->DiscardAsset(upload.path);
+	}
+	upload = AssetUpload();
+}
+
+/**
+ * @brief  Calls the handler of the first request received in a connection. The
+ * answer is queued after the answers still waiting to be written.
+ * @param  &server: Server instance.
+ * @param  &manager: Request manager instance.
+ * @param  &connection: Connection with a complete request.
+ * @param  request_len: Length of the request.
+ * @retval true if the request was answered.
+ * @retval false if the handler failed or gave up without an answer.
+ */
+bool dispatch_tcp_request(Server &server, RequestManager &manager,
+                          Connection &connection, size_t request_len) {
+	// Read in place, the bytes are erased once handled
+	std::string_view request(connection.in.data(), request_len);
+	std::string joined;
+	AssetUpload *upload = NULL;
+	if (!connection.upload.header.empty()) {
+		// The asset in between is in the staged file, or was dropped
+		upload = &connection.upload;
+		joined = upload->header;
+		joined.append(request);
+		request = joined;
+	}
+
+	BufferMessage message(request.data(), request.size());
+	connection.address.reply = &connection.out;
+	connection.address.files = &connection.files;
+	connection.address.upload = upload;
+	connection.address.answered = false;
+	bool handled = true;
+	try {
+		manager.callHandlerRequest(message, server, connection.address,
+		                           TCP_MESSAGE);
+	} catch (std::exception &e) {
+		printError("Handling tcp request.");
+		handled = false;
+	}
+	connection.address.upload = NULL;
+	connection.in.erase(0, request_len);
+	if (upload != NULL) {
+		discard_tcp_asset(server, connection);
+	}
+	return handled && connection.address.answered;
+}
+
+/**
+ * @brief  Handles the complete requests received in a connection. Without a
+ * session only the first request of the connection is handled, as in the fork
+ * engine. In a session every request received is handled and its answer
+ * queued in order, so a client may send many requests without waiting.
+ * @param  &server: Server instance.
+ * @param  &manager: Request manager instance.
+ * @param  &connection: Connection that received bytes.
+ * @retval TCP_REQUESTS_WAIT, TCP_REQUESTS_WRITE or TCP_REQUESTS_CLOSE.
+ */
+int handle_tcp_requests(Server &server, RequestManager &manager,
+                        Connection &connection) {
+	while (connection.requests == 0 || connection.address.session) {
+		size_t request_len;
+		bool asset = receive_tcp_asset(server, connection, request_len);
+		if (!asset) {
+			request_len =
+				frame_tcp_request(connection.in.data(), connection.in.size());
+		}
+		if (request_len == 0) {
+			if (!connection.eof || (connection.in.empty() && !asset)) {
+				break;
+			}
+			// Client stopped sending mid request, the handler answers ERR.
+			request_len = connection.in.size();
+		}
+
+		// The file data would be read as requests, the session ends with the
+		// answer instead
+		bool unframed =
+			!asset && tcp_asset_unframed(connection.in.data(), request_len);
+		connection.requests++;
+		if (!dispatch_tcp_request(server, manager, connection, request_len)) {
+			if (!connection.address.session) {
+				return TCP_REQUESTS_CLOSE;
+			}
+			// Every request gets an answer so that the next ones stay in order
+			ServerError error;
+			server.sendTcpMessage(error, connection.address);
+		}
+		if (unframed) {
+			connection.address.session = false;
+		}
+	}
+
+	if (connection.out_offset < connection.out.size()) {
+		return TCP_REQUESTS_WRITE;
+	}
+	if (connection.eof ||
+	    (connection.requests > 0 && !connection.address.session)) {
+		return TCP_REQUESTS_CLOSE;
+	}
+	return TCP_REQUESTS_WAIT;
+}
+
+/**
+ * @brief  Moves the next part of the first file queued into the answers, for
+ * engines that can only send from memory. The answers already written are
+ * dropped first, so the answers hold at most one part of the file at a time.
+ * Must be called once the answers before the file are written.
+ * @param  &connection: Connection with a file queued.
+ * @retval true if a part of the file was read.
+ * @retval false if the file couldn't be read.
+ */
+bool read_reply_file(Connection &connection) {
+	for (ReplyFile &file : connection.files) {
+		file.at -= connection.out_offset;
+	}
+	connection.out.erase(0, connection.out_offset);
+	connection.out_offset = 0;
+
+	ReplyFile &file = connection.files.front();
+	size_t len = std::min(file.size, static_cast<size_t>(TCP_FILE_CHUNK_LEN));
+	connection.out.insert(file.at, len, '\0');
+	ssize_t n = pread(file.fd, &connection.out[file.at], len, file.offset);
+	if (n <= 0) {
+		// Also when the file got shorter than its announced size
+		return false;
+	}
+	connection.out.erase(file.at + static_cast<size_t>(n),
+	                     len - static_cast<size_t>(n));
+
+	for (ReplyFile &queued : connection.files) {
+		queued.at += static_cast<size_t>(n);
+	}
+	file.offset += n;
+	file.size -= static_cast<size_t>(n);
+	if (file.size == 0) {
+		close(file.fd);
+		connection.files.pop_front();
+	}
+	return true;
+}
+
+/**
+ * @brief  Closes the files still queued in a connection.
+ * @param  &connection: Connection being closed.
+ * @retval None
+ */
+void close_reply_files(Connection &connection) {
+	for (ReplyFile &file : connection.files) {
+		close(file.fd);
+	}
+	connection.files.clear();
+}
+
+// -------------------------------------
+// | Event loop						   |
+// -------------------------------------
+
+/**
+ * @brief  Creates the epoll instance and starts listening for connections.
+ * @param  &server: Server instance.
+ * @param  &manager: Request manager instance.
+ * @throws UnrecoverableException
+ */
+TcpEventLoop::TcpEventLoop(Server &server, RequestManager &manager)
+	: _server(server), _manager(manager) {
+	_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (_epoll_fd == -1) {
+		throw UnrecoverableException("[TCP] Failed to create epoll instance");
+	}
+
+	int flags = fcntl(_server._tcp_socket_fd, F_GETFL, 0);
+	if (flags == -1 ||
+	    fcntl(_server._tcp_socket_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		throw UnrecoverableException(
+			"[TCP] Failed to set listening socket as non-blocking");
+	}
+
+	setAccepting(true);
+
+	if (_server._executor != nullptr) {
+		_completions = std::make_unique<CompletionQueue>();
+		watch(_completions->fd(), EPOLL_CTL_ADD, EPOLLIN);
+	}
+}
+
+/**
+ * @brief  Closes every connection still open and the epoll instance.
+ */
+TcpEventLoop::~TcpEventLoop() {
+	for (auto &entry : _connections) {
+		close(entry.first);
+		close_reply_files(entry.second);
+		discard_tcp_asset(_server, entry.second);
+	}
+	if (_epoll_fd != -1) {
+		close(_epoll_fd);
+	}
+}
+
+/**
+ * @brief  Adds, modifies or removes a file descriptor from the epoll instance.
+ * @param  fd: File descriptor.
+ * @param  op: EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL.
+ * @param  events: Events to wait for.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpEventLoop::watch(int fd, int op, uint32_t events) {
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = events;
+	event.data.fd = fd;
+	if (epoll_ctl(_epoll_fd, op, fd, &event) == -1) {
+		throw UnrecoverableException("[TCP] Failed to update epoll interest");
+	}
+}
+
+/**
+ * @brief  Starts or stops waiting for new connections. Accepting stops while
+ * the connection limit is reached so that new clients wait in the backlog.
+ * @param  accepting: Whether to wait for new connections.
+ * @retval None
+ */
+void TcpEventLoop::setAccepting(bool accepting) {
+	if (accepting == _accepting) {
+		return;
+	}
+	watch(_server._tcp_socket_fd, accepting ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+	      EPOLLIN);
+	_accepting = accepting;
+}
+
+/**
+ * @brief  Counts a connection in the queue of the admission control or takes
+ * it out. A connection is in the queue from the moment bytes wait for it
+ * until its requests are handled, or found incomplete. Idle connections, such
+ * as sessions waiting for their next request, aren't requests waiting.
+ * @param  &connection: The connection.
+ * @param  pending: Whether it has requests waiting or being handled.
+ * @retval None
+ */
+void TcpEventLoop::setPending(Connection &connection, bool pending) {
+	if (connection.pending == pending) {
+		return;
+	}
+	connection.pending = pending;
+	_pending = pending ? _pending + 1 : _pending - 1;
+	_server._admission.setDepth(_pending);
+}
+
+/**
+ * @brief  Runs the event loop until an unrecoverable error happens.
+ * @retval None
+ */
+void TcpEventLoop::run() {
+	uint32_t ex_trial = 0;
+	while (true) {
+		try {
+			waitForEvents();
+			ex_trial = 0;
+		} catch (std::exception &e) {
+			std::cerr
+				<< "[TCP] Encountered unrecoverable error while running the "
+				   "server. Retrying..."
+				<< std::endl
+				<< e.what() << std::endl;
+			ex_trial++;
+		}
+		if (ex_trial >= EXCEPTION_RETRY_MAX) {
+			std::cerr << "[TCP] Max trials reached, shutting down..."
+					  << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * @brief  Waits for events on the listening socket and the open connections
+ * and dispatches them.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpEventLoop::waitForEvents() {
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+	int n = epoll_wait(_epoll_fd, events, EPOLL_MAX_EVENTS,
+	                   EPOLL_WAIT_TIMEOUT_MS);
+	if (sig_int) {
+		// Also when the signal arrived outside epoll_wait
+		terminate(_server, TCP_MESSAGE);
+	}
+	if (n < 0) {
+		if (errno == EINTR) {
+			return;
+		}
+		throw UnrecoverableException("[TCP] Failed to wait for events");
+	}
+
+	// The connections with bytes waiting are the queue of the requests
+	for (int i = 0; i < n; i++) {
+		auto entry = _connections.find(events[i].data.fd);
+		if (entry != _connections.end() &&
+		    entry->second.state == CONNECTION_READING) {
+			setPending(entry->second, true);
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		int fd = events[i].data.fd;
+		if (fd == _server._tcp_socket_fd) {
+			acceptConnections();
+			continue;
+		}
+		if (_completions != nullptr && fd == _completions->fd()) {
+			finishRequests();
+			continue;
+		}
+
+		auto entry = _connections.find(fd);
+		if (entry == _connections.end()) {
+			continue;
+		}
+		Connection &connection = entry->second;
+		if (connection.state == CONNECTION_READING) {
+			readConnection(connection);
+		} else if (connection.state == CONNECTION_WRITING) {
+			writeConnection(connection);
+		}
+	}
+
+	expireConnections();
+}
+
+/**
+ * @brief  Accepts every pending connection up to the connection limit.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpEventLoop::acceptConnections() {
+	while (_connections.size() < TCP_MAX_CONNECTIONS) {
+		Address addr_from;
+		addr_from.size = sizeof(addr_from.addr);
+		int connection_fd = accept4(
+			_server._tcp_socket_fd, (struct sockaddr *) &addr_from.addr,
+			&addr_from.size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (connection_fd < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			if (errno == EMFILE || errno == ENFILE) {
+				// Out of descriptors, try again once a connection closes.
+				printError("Out of file descriptors, pausing accept.");
+				setAccepting(false);
+				return;
+			}
+			throw UnrecoverableException(
+				"[ERROR] Failed to accept a connection");
+		}
+
+		if (!admit_tcp_connection(_server, addr_from, connection_fd)) {
+			continue;
+		}
+
+		addr_from.socket = connection_fd;
+		Connection &connection = _connections[connection_fd];
+		connection.fd = connection_fd;
+		connection.address = addr_from;
+		connection.last_active = time(NULL);
+		watch(connection_fd, EPOLL_CTL_ADD, EPOLLIN);
+	}
+	setAccepting(false);
+}
+
+/**
+ * @brief  Reads the available bytes of a connection and handles the request
+ * once it is complete.
+ * @param  &connection: Connection to read from.
+ * @retval None
+ */
+void TcpEventLoop::readConnection(Connection &connection) {
+	char buffer[EVENT_LOOP_READ_LEN];
+	ssize_t n = read(connection.fd, buffer, EVENT_LOOP_READ_LEN);
+	if (n > 0) {
+		connection.in.append(buffer, static_cast<size_t>(n));
+	} else if (n == 0) {
+		connection.eof = true;
+	} else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+		setPending(connection, false);
+		return;
+	} else {
+		closeConnection(connection.fd);
+		return;
+	}
+	connection.last_active = time(NULL);
+	handleRequests(connection);
+}
+
+/**
+ * @brief  Handles the complete requests received in a connection, on this
+ * thread or on a handler thread. A handler thread only gets the connection
+ * once a whole request is received, so a request arriving in parts or the
+ * asset of an OPA doesn't cost a trip to one for every read.
+ * @param  &connection: Connection that received bytes.
+ * @retval None
+ */
+void TcpEventLoop::handleRequests(Connection &connection) {
+	if (_completions == nullptr) {
+		setPending(connection, true);
+		onRequestsHandled(connection,
+		                  handle_tcp_requests(_server, _manager, connection));
+		return;
+	}
+	bool ready = tcp_requests_ready(_server, connection);
+	setPending(connection, ready);
+	if (!ready) {
+		return;
+	}
+
+	// Not watched until handled, the thread owns the buffers meanwhile. It is
+	// removed rather than left without events, since a hang up would still
+	// be reported on every wait.
+	connection.state = CONNECTION_HANDLING;
+	watch(connection.fd, EPOLL_CTL_DEL, 0);
+	_server._executor->submit([this, &connection] {
+		int result = handle_tcp_requests(_server, _manager, connection);
+		_completions->push(static_cast<uint64_t>(connection.fd), result);
+	});
+}
+
+/**
+ * @brief  Starts writing the answers of the requests handled, closes the
+ * connection or goes back to reading.
+ * @param  &connection: Connection whose requests were handled.
+ * @param  result: TCP_REQUESTS_WAIT, TCP_REQUESTS_WRITE or TCP_REQUESTS_CLOSE.
+ * @retval None
+ */
+void TcpEventLoop::onRequestsHandled(Connection &connection, int result) {
+	setPending(connection, false);
+	if (connection.state == CONNECTION_HANDLING) {
+		connection.state = CONNECTION_READING;
+		if (result != TCP_REQUESTS_CLOSE) {
+			watch(connection.fd, EPOLL_CTL_ADD, EPOLLIN);
+		}
+	}
+
+	switch (result) {
+		case TCP_REQUESTS_WRITE:
+			connection.state = CONNECTION_WRITING;
+			writeConnection(connection);
+			break;
+		case TCP_REQUESTS_CLOSE:
+			closeConnection(connection.fd);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * @brief  Collects the results of the handler threads.
+ * @retval None
+ */
+void TcpEventLoop::finishRequests() {
+	uint64_t count;
+	if (read(_completions->fd(), &count, sizeof(count)) == -1 &&
+	    errno != EAGAIN) {
+		throw UnrecoverableException("[TCP] Failed to read eventfd");
+	}
+	for (auto &done : _completions->take()) {
+		auto entry = _connections.find(static_cast<int>(done.first));
+		if (entry != _connections.end()) {
+			onRequestsHandled(entry->second, done.second);
+		}
+	}
+}
+
+/**
+ * @brief  Writes as much of the pending answers as the socket takes. Files
+ * queued in between them are sent with sendfile() once the answers before
+ * them are written. Once everything is sent, a connection in a session goes
+ * back to reading and the others are closed.
+ * @param  &connection: Connection to write to.
+ * @retval None
+ */
+void TcpEventLoop::writeConnection(Connection &connection) {
+	while (connection.out_offset < connection.out.size()) {
+		size_t end = connection.out.size();
+		if (!connection.files.empty()) {
+			end = connection.files.front().at;
+		}
+
+		ssize_t n;
+		if (connection.out_offset < end) {
+			// Held back while a file follows, so they leave together
+			int flags = end < connection.out.size() ? MSG_MORE : 0;
+			n = send(connection.fd,
+			         connection.out.data() + connection.out_offset,
+			         end - connection.out_offset, flags | MSG_NOSIGNAL);
+			if (n > 0) {
+				connection.out_offset += static_cast<size_t>(n);
+			}
+		} else {
+			// 0 if the file got shorter than its announced size
+			ReplyFile &file = connection.files.front();
+			n = sendfile(connection.fd, file.fd, &file.offset, file.size);
+			if (n > 0) {
+				file.size -= static_cast<size_t>(n);
+				if (file.size == 0) {
+					close(file.fd);
+					connection.files.pop_front();
+				}
+			}
+		}
+
+		if (n > 0) {
+			connection.last_active = time(NULL);
+		} else if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			watch(connection.fd, EPOLL_CTL_MOD, EPOLLOUT);
+			return;
+		} else {
+			closeConnection(connection.fd);
+			return;
+		}
+	}
+
+	if (!connection.address.session || connection.eof) {
+		closeConnection(connection.fd);
+		return;
+	}
+	connection.out.clear();
+	connection.out_offset = 0;
+	connection.state = CONNECTION_READING;
+	watch(connection.fd, EPOLL_CTL_MOD, EPOLLIN);
+
+	// Requests sent while the answers were written
+	if (!connection.in.empty()) {
+		handleRequests(connection);
+	}
+}
+
+/**
+ * @brief  Closes a connection and resumes accepting if it was paused.
+ * @param  fd: File descriptor of the connection.
+ * @retval None
+ */
+void TcpEventLoop::closeConnection(int fd) {
+	close(fd);  // Also removes it from the epoll instance
+	auto entry = _connections.find(fd);
+	if (entry != _connections.end()) {
+		setPending(entry->second, false);
+		close_reply_files(entry->second);
+		discard_tcp_asset(_server, entry->second);
+		_connections.erase(entry);
+	}
+	if (_connections.size() < TCP_MAX_CONNECTIONS) {
+		setAccepting(true);
+	}
+}
+
+/**
+ * @brief  Closes the connections that have been idle longer than the read or
+ * write timeouts. Runs at most once per second.
+ * @retval None
+ */
+void TcpEventLoop::expireConnections() {
+	time_t now = time(NULL);
+	if (now == _last_sweep) {
+		return;
+	}
+	_last_sweep = now;
+
+	std::vector<int> expired;
+	for (auto &entry : _connections) {
+		Connection &connection = entry.second;
+		if (connection.state == CONNECTION_HANDLING) {
+			continue;
+		}
+		time_t timeout = connection.state == CONNECTION_READING
+		                     ? TCP_READ_TIMEOUT_SECONDS
+		                     : TCP_WRITE_TIMEOUT_SECONDS;
+		if (now - connection.last_active >= timeout) {
+			expired.push_back(entry.first);
+		}
+	}
+	for (int fd : expired) {
+		closeConnection(fd);
+	}
+
+	if (_connections.size() < TCP_MAX_CONNECTIONS) {
+		setAccepting(true);
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef __EVENT_LOOP__
+#define __EVENT_LOOP__
+
+/**
+ * @file event_loop.hpp
+ * @brief Declaration of the epoll based TCP engine. A single process keeps
+ * many non-blocking connections open and drives each one through a small
+ * read -> handle -> write state machine. Connections in a session go back to
+ * reading after each write.
+ */
+
+#include <time.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "server.hpp"
+
+// Longest request without an asset payload. A request that grows past this
+// without a delimiter is malformed and is handled as it is.
+#define TCP_MAX_HEADER_LEN 128
+
+// Number of fields in an OPA header before the file data.
+#define OPA_HEADER_FIELDS 7
+
+// Part of a file read at once by engines that can't send from a file.
+#define TCP_FILE_CHUNK_LEN 65536
+
+// Connection states
+#define CONNECTION_READING  0
+#define CONNECTION_WRITING  1
+#define CONNECTION_HANDLING 2  // Requests being handled by a handler thread
+
+// What a connection does after handling the requests it received
+#define TCP_REQUESTS_WAIT  0  // Read more bytes
+#define TCP_REQUESTS_WRITE 1  // Write the answers queued
+#define TCP_REQUESTS_CLOSE 2  // Close, nothing left to answer
+
+/**
+ * @brief  State of a connection owned by the event loop.
+ */
+class Connection {
+   public:
+	int fd;
+	Address address;
+	std::string in;   // Bytes received and not yet handled
+	std::string out;  // Answers waiting to be written
+	size_t out_offset = 0;
+	std::deque<ReplyFile> files;  // Files sent in between the answers
+	AssetUpload upload;           // Asset of the OPA request being received
+	size_t requests = 0;  // Requests handled so far
+	int state = CONNECTION_READING;
+	bool pending = false;  // Has requests waiting or being handled
+	bool eof = false;
+	time_t last_active;
+};
+
+/**
+ * @brief  Epoll driven TCP engine. Requests are framed from the bytes
+ * received, handed to the request manager and their answers flushed when the
+ * socket is writable. With handler threads (-x), the requests of a connection
+ * are handled by the executor and the connection waits, without being read or
+ * expired, until the loop collects the result.
+ */
+class TcpEventLoop {
+	Server &_server;
+	RequestManager &_manager;
+	int _epoll_fd = -1;
+	bool _accepting = false;
+	time_t _last_sweep = 0;
+	size_t _pending = 0;  // Connections with requests, the admission queue
+	std::unordered_map<int, Connection> _connections;
+	std::unique_ptr<CompletionQueue> _completions;  // With handler threads
+
+	void watch(int fd, int op, uint32_t events);
+	void setAccepting(bool accepting);
+	void setPending(Connection &connection, bool pending);
+	void waitForEvents();
+	void acceptConnections();
+	void readConnection(Connection &connection);
+	void handleRequests(Connection &connection);
+	void onRequestsHandled(Connection &connection, int result);
+	void finishRequests();
+	void writeConnection(Connection &connection);
+	void closeConnection(int fd);
+	void expireConnections();
+
+   public:
+	TcpEventLoop(Server &server, RequestManager &manager);
+	~TcpEventLoop();
+	void run();
+};
+
+size_t frame_opa_header(const char *data, size_t len, size_t &fsize);
+size_t frame_tcp_request(const char *data, size_t len);
+bool tcp_asset_unframed(const char *data, size_t len);
+bool receive_tcp_asset(Server &server, Connection &connection,
+                       size_t &request_len);
+bool tcp_requests_ready(Server &server, Connection &connection);
+void discard_tcp_asset(Server &server, Connection &connection);
+bool dispatch_tcp_request(Server &server, RequestManager &manager,
+                          Connection &connection, size_t request_len);
+int handle_tcp_requests(Server &server, RequestManager &manager,
+                        Connection &connection);
+bool read_reply_file(Connection &connection);
+void close_reply_files(Connection &connection);
+
+#endif
@@ -0,0 +1,241 @@
+/**
+ * @file executor.cpp
+ * @brief Implementation of the work-stealing executor.
+ */
+#include "executor.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "server.hpp"
+
+// Index of the executor thread running the caller, or none
+static thread_local size_t executor_worker = SIZE_MAX;
+
+// -------------------------------------
+// | Executor						   |
+// -------------------------------------
+
+/**
+ * @brief  Starts the threads of the pool.
+ * @param  threads: Number of threads.
+ */
+Executor::Executor(size_t threads) {
+	for (size_t i = 0; i < threads; i++) {
+		_workers.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < threads; i++) {
+		_threads.emplace_back(&Executor::work, this, i);
+	}
+}
+
+/**
+ * @brief  Waits for the tasks already submitted and stops the threads.
+ */
+Executor::~Executor() {
+	{
+		std::lock_guard<std::mutex> lock(_sleep_mutex);
+		_stopping = true;
+	}
+	_wakeup.notify_all();
+	for (std::thread &thread : _threads) {
+		thread.join();
+	}
+}
+
+/**
+ * @brief  Queues a task. Tasks submitted by a thread of the pool go to its own
+ * deque, the others are spread between the deques in turn.
+ * @param  task: Task to run.
+ * @retval None
+ */
+void Executor::submit(std::function<void()> task) {
+	size_t index = executor_worker;
+	if (index >= _workers.size()) {
+		index = _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+	}
+
+	// Counted first so that a thread taking it never sees the counter at 0
+	_queued.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(_workers[index]->mutex);
+		_workers[index]->tasks.push_back(std::move(task));
+	}
+
+	// A thread going to sleep checks the counter holding this mutex, so it
+	// either sees the task or is already waiting for the notification.
+	{ std::lock_guard<std::mutex> lock(_sleep_mutex); }
+	_wakeup.notify_one();
+}
+
+/**
+ * @brief  Takes the next task of a thread: the oldest of its own deque or, if
+ * it is empty, the newest of another deque.
+ * @param  index: Thread taking the task. An index past the last thread only
+ * steals.
+ * @param  &task: Task taken.
+ * @retval true if a task was taken.
+ */
+bool Executor::take(size_t index, std::function<void()> &task) {
+	size_t count = _workers.size();
+	if (index < count) {
+		Worker &own = *_workers[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			_queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i <= count; i++) {
+		Worker &victim = *_workers[(index + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			_queued.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief  Main loop of a thread of the pool. Sleeps while there are no tasks
+ * in any deque.
+ * @param  index: Index of the thread.
+ * @retval None
+ */
+void Executor::work(size_t index) {
+	executor_worker = index;
+	std::function<void()> task;
+	while (true) {
+		if (take(index, task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleep_mutex);
+		_wakeup.wait(lock, [this] { return _stopping || _queued > 0; });
+		if (_stopping && _queued == 0) {
+			return;
+		}
+	}
+}
+
+/**
+ * @brief  Runs one task queued in the pool on the calling thread, so that a
+ * thread waiting for its tasks helps instead of sleeping.
+ * @retval true if a task was run.
+ */
+bool Executor::runOne() {
+	std::function<void()> task;
+	size_t index = std::min(executor_worker, _workers.size());
+	if (!take(index, task)) {
+		return false;
+	}
+	task();
+	return true;
+}
+
+/**
+ * @brief  Runs task(0) to task(count - 1) in the pool and returns once all of
+ * them finished. The calling thread runs tasks too while it waits.
+ * @param  count: Number of tasks.
+ * @param  &task: Task to run for each index.
+ * @retval None
+ */
+void Executor::forEach(size_t count, const std::function<void(size_t)> &task) {
+	if (count == 0) {
+		return;
+	}
+	// Guarded by the mutex so that this returns only after the last task
+	// is done with them
+	std::mutex mutex;
+	std::condition_variable finished;
+	size_t remaining = count - 1;
+	for (size_t i = 1; i < count; i++) {
+		submit([&task, &mutex, &finished, &remaining, i] {
+			task(i);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0) {
+				finished.notify_one();
+			}
+		});
+	}
+
+	task(0);
+	while (runOne()) {
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&remaining] { return remaining == 0; });
+}
+
+// -------------------------------------
+// | Completion queue				   |
+// -------------------------------------
+
+/**
+ * @brief  Creates the eventfd that wakes up the event loop.
+ * @throws UnrecoverableException
+ */
+CompletionQueue::CompletionQueue() {
+	_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_fd == -1) {
+		throw UnrecoverableException("[TCP] Failed to create eventfd");
+	}
+}
+
+/**
+ * @brief  Closes the eventfd.
+ */
+CompletionQueue::~CompletionQueue() {
+	close(_fd);
+}
+
+/**
+ * @brief  Eventfd that becomes readable when there are results to take. The
+ * event loop reads it before taking them.
+ * @retval File descriptor.
+ */
+int CompletionQueue::fd() {
+	return _fd;
+}
+
+/**
+ * @brief  Adds the result of a task. Only the first result since the last
+ * take wakes up the event loop.
+ * @param  key: What the task worked on (a connection).
+ * @param  result: Result of the task.
+ * @retval None
+ */
+void CompletionQueue::push(uint64_t key, int result) {
+	bool was_empty;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		was_empty = _done.empty();
+		_done.emplace_back(key, result);
+	}
+	if (was_empty) {
+		uint64_t one = 1;
+		if (write(_fd, &one, sizeof(one)) == -1) {
+			// Only fails if the counter is full, the loop is awake already
+		}
+	}
+}
+
+/**
+ * @brief  Takes every result pushed so far.
+ * @retval Pairs of key and result, in the order they were pushed.
+ */
+std::vector<std::pair<uint64_t, int>> CompletionQueue::take() {
+	std::vector<std::pair<uint64_t, int>> done;
+	std::lock_guard<std::mutex> lock(_mutex);
+	done.swap(_done);
+	return done;
+}
@@ -0,0 +1,73 @@
+#ifndef __EXECUTOR__
+#define __EXECUTOR__
+
+/**
+ * @file executor.hpp
+ * @brief Declaration of the work-stealing executor. The I/O thread of a
+ * process hands its requests to a pool of threads so that slow handlers run
+ * on every core instead of holding back the others.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief  Pool of threads, each with its own deque of tasks. A thread runs the
+ * tasks of its deque in order and, once it is empty, steals from the other end
+ * of the deque of another thread. Tasks must not throw.
+ */
+class Executor {
+	/**
+	 * @brief  Tasks waiting for a thread.
+	 */
+	class Worker {
+	   public:
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::vector<std::thread> _threads;
+	std::atomic<size_t> _queued{0};
+	std::atomic<size_t> _next{0};  // Deque of the next task from outside
+	std::mutex _sleep_mutex;
+	std::condition_variable _wakeup;
+	bool _stopping = false;
+
+	bool take(size_t index, std::function<void()> &task);
+	void work(size_t index);
+
+   public:
+	Executor(size_t threads);
+	~Executor();
+	void submit(std::function<void()> task);
+	bool runOne();
+	void forEach(size_t count, const std::function<void(size_t)> &task);
+};
+
+/**
+ * @brief  Results of the tasks of an event loop. The tasks push them from the
+ * pool threads and the loop is woken up through an eventfd to collect them.
+ */
+class CompletionQueue {
+	int _fd;
+	std::mutex _mutex;
+	std::vector<std::pair<uint64_t, int>> _done;
+
+   public:
+	CompletionQueue();
+	~CompletionQueue();
+	int fd();
+	void push(uint64_t key, int result);
+	std::vector<std::pair<uint64_t, int>> take();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "handlers.hpp"
 
+#include <fcntl.h>
+
 #include "output.hpp"
 #include "shared/protocol.hpp"
 
@@ -26,7 +28,7 @@ void LoginRequest::handle(MessageAdapter &message, Server &server,
 		std::string user_id = std::to_string(message_in.user_id);
 
 		// Access database
-		int res = server._database.LoginUser(user_id, message_in.password);
+		int res = server._database->LoginUser(user_id, message_in.password);
 		switch (res) {
 			case DB_LOGIN_NOK:
 				message_out.status = ServerLoginUser::status::NOK;
@@ -50,9 +52,7 @@ void LoginRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -78,7 +78,7 @@ void LogoutRequest::handle(MessageAdapter &message, Server &server,
 		std::string user_id = std::to_string(message_in.user_id);
 
 		// Access database
-		int res = server._database.Logout(user_id, message_in.password);
+		int res = server._database->Logout(user_id, message_in.password);
 		switch (res) {
 			case DB_LOGOUT_UNREGISTERED:
 				message_out.status = ServerLogout::status::UNR;
@@ -102,9 +102,7 @@ void LogoutRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -131,7 +129,7 @@ void UnregisterRequest::handle(MessageAdapter &message, Server &server,
 		std::string user_id = std::to_string(message_in.user_id);
 
 		// Access database
-		int res = server._database.Unregister(user_id, message_in.password);
+		int res = server._database->Unregister(user_id, message_in.password);
 		switch (res) {
 			case DB_UNREGISTER_UNKNOWN:
 				message_out.status = ServerUnregister::status::UNR;
@@ -155,9 +153,7 @@ void UnregisterRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -182,7 +178,7 @@ void ListAllAuctionsRequest::handle(MessageAdapter &message, Server &server,
 		}
 
 		// Access database
-		AuctionList a_list = server._database.List();
+		AuctionList a_list = server._database->List();
 
 		if (a_list.size() == 0) {
 			message_out.status = ServerListAllAuctions::status::NOK;
@@ -201,9 +197,7 @@ void ListAllAuctionsRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -229,9 +223,9 @@ void ListBiddedAuctionsRequest::handle(MessageAdapter &message, Server &server,
 
 		std::string user_id = std::to_string(message_in.user_id);
 		// Access database
-		AuctionList a_list = server._database.MyBids(user_id);
+		AuctionList a_list = server._database->MyBids(user_id);
 
-		if (server._database.CheckUserLoggedIn(user_id) != 0) {
+		if (server._database->CheckUserLoggedIn(user_id) != 0) {
 			message_out.status = ServerListBiddedAuctions::status::NLG;
 		} else if (a_list.size() == 0) {
 			message_out.status = ServerListBiddedAuctions::status::NOK;
@@ -251,9 +245,7 @@ void ListBiddedAuctionsRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -279,9 +271,9 @@ void ListStartedAuctionsRequest::handle(MessageAdapter &message, Server &server,
 
 		std::string user_id = std::to_string(message_in.user_id);
 		// Access database
-		AuctionList a_list = server._database.MyAuctions(user_id);
+		AuctionList a_list = server._database->MyAuctions(user_id);
 
-		if (server._database.CheckUserLoggedIn(user_id) != 0) {
+		if (server._database->CheckUserLoggedIn(user_id) != 0) {
 			message_out.status = ServerListStartedAuctions::status::NLG;
 		} else if (a_list.size() == 0) {
 			message_out.status = ServerListStartedAuctions::status::NOK;
@@ -301,9 +293,7 @@ void ListStartedAuctionsRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -333,7 +323,7 @@ void ShowRecordRequest::handle(MessageAdapter &message, Server &server,
 			convert_auction_id_to_str(message_in.auction_id);
 
 		// Access database
-		AuctionRecord record = server._database.ShowRecord(auction_id);
+		AuctionRecord record = server._database->ShowRecord(auction_id);
 		message_out.status = ServerShowRecord::status::OK;
 		message_out.host_UID = static_cast<uint32_t>(stoi(record.host_id));
 		message_out.auction_name = record.auction_name;
@@ -369,14 +359,138 @@ void ShowRecordRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
+}
+
+/**
+ * @brief  Checks the header of an Open Auction request, so that a request that
+ * will be refused is answered without receiving its asset.
+ * @param  &server: Instance of the server.
+ * @param  &message_in: The request, with its header read.
+ * @retval ServerOpenAuction::status::OK if the asset should be received.
+ * @retval ServerOpenAuction::status::ERR if the asset is too big.
+ * @retval ServerOpenAuction::status::NLG or NOK if the user can't open it.
+ */
+int check_open_auction(Server &server, ClientOpenAuction &message_in) {
+	if (message_in.Fsize > MAX_FILE_SIZE) {
+		return ServerOpenAuction::status::ERR;
+	}
+	std::string user_id = convert_user_id_to_str(message_in.user_id);
+	int result = server._database->CheckOpen(user_id, message_in.password);
+	if (result == DB_OPEN_NOT_LOGGED_IN) {
+		return ServerOpenAuction::status::NLG;
+	} else if (result == DB_OPEN_CREATE_FAIL) {
+		return ServerOpenAuction::status::NOK;
+	}
+	return ServerOpenAuction::status::OK;
+}
+
+/**
+ * @brief  Checks the header of an Open Auction request received by the event
+ * loop, which then writes the asset to disk or drops it as it arrives.
+ * @param  &server: Instance of the server.
+ * @param  &header: The request up to the asset, with its protocol code.
+ * @retval true if the asset should be received.
+ * @retval false if the request will be refused.
+ */
+bool accept_open_auction_asset(Server &server, const std::string &header) {
+	if (header.size() < PROTOCOL_SIZE) {
+		return false;
+	}
+	BufferMessage message(header.data() + PROTOCOL_SIZE,
+	                      header.size() - PROTOCOL_SIZE);
+	ClientOpenAuction message_in;
+	try {
+		message_in.readHeader(message);
+	} catch (std::exception &e) {
+		return false;
+	}
+	return check_open_auction(server, message_in) ==
+	       ServerOpenAuction::status::OK;
+}
+
+/**
+ * @brief  Receives the asset of an Open Auction request into a staged file,
+ * after its header. The event loops write the asset to disk as it arrives, in
+ * which case only the end of the request is left to read.
+ * @param  &message_in: The request, with its header read.
+ * @param  &message: The adapter containing the raw received message.
+ * @param  &server: Instance of the server.
+ * @param  &address: The address the request came from.
+ * @throws InvalidMessageException if the asset is incomplete or the message is
+ * wrongly formatted.
+ * @throws FileException if the asset can't be written to disk.
+ * @retval The staged asset, empty if the event loop dropped it.
+ */
+static std::string receive_asset(ClientOpenAuction &message_in,
+                                 MessageAdapter &message, Server &server,
+                                 Address &address) {
+	if (address.upload != NULL) {
+		if (address.upload->left > 0) {
+			throw InvalidMessageException();
+		}
+		message_in.readAsset(message, -1);
+		std::string staged_fname = address.upload->path;
+		address.upload->path.clear();  // Moved or deleted by the database
+		return staged_fname;
+	}
+
+	std::string staged_fname;
+	int fd = server._database->StageAsset(staged_fname);
+	if (fd == -1) {
+		throw FileException();
+	}
+	try {
+		message_in.readAsset(message, fd);
+	} catch (std::exception &e) {
+		close(fd);
+		server._database->DiscardAsset(staged_fname);
+		throw;
+	}
+	close(fd);
+	return staged_fname;
+}
+
+/**
+ * @brief  Reads and drops the asset of a refused Open Auction request, so that
+ * the answer isn't lost to a reset and the next request of a session starts
+ * where expected. The asset goes to /dev/null with splice() when the request
+ * is read from the socket. An asset over the size limit isn't read, the
+ * connection is closed after the answer instead.
+ * @param  &message_in: The request, with its header read.
+ * @param  &message: The adapter containing the raw received message.
+ * @param  &address: The address the request came from.
+ * @retval None
+ */
+static void drop_asset(ClientOpenAuction &message_in, MessageAdapter &message,
+                       Address &address) {
+	if (message_in.Fsize > MAX_FILE_SIZE) {
+		address.session = false;
+		return;
+	}
+	int fd = -1;
+	if (address.upload == NULL) {
+		fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+		if (fd == -1) {
+			address.session = false;
+			return;
+		}
+	}
+	try {
+		message_in.readAsset(message, fd);
+	} catch (std::exception &e) {
+		// The client stopped sending, it still gets the answer
+		address.session = false;
+	}
+	if (fd != -1) {
+		close(fd);
+	}
 }
 
 /**
  * @brief  Responsible for handling the Open Auction request and consult the
- * database.
+ * database. The user is checked before the asset is received, so a refused
+ * request costs no disk writes.
  * @param  &message: The adapter containing the raw received message.
  * @param  &server: Instance of the server.
  * @param  &address: The address to where the message should go.
@@ -390,21 +504,38 @@ void OpenAuctionRequest::handle(MessageAdapter &message, Server &server,
 	ServerOpenAuction message_out;
 
 	try {
-		message_in.readMessage(message);
+		message_in.readHeader(message);
 		if (server._verbose) {
 			printAddressIncomingRequest(address);
 			printInOpenAuctionRequest(message_in);
 		}
 
+		int check = check_open_auction(server, message_in);
+		if (check != ServerOpenAuction::status::OK) {
+			drop_asset(message_in, message, address);
+			message_out.status =
+				static_cast<enum ServerOpenAuction::status>(check);
+			server.sendTcpMessage(message_out, address);
+			return;
+		}
+		if (message_in.Fsize > MAX_FILE_SIZE) {
+			throw InvalidMessageException();
+		}
+		std::string staged_fname = receive_asset(message_in, message, server,
+		                                         address);
+
 		std::string user_id = convert_user_id_to_str(message_in.user_id);
 		std::string start_value = std::to_string(message_in.start_value);
 		std::string timeactive = std::to_string(message_in.timeactive);
 
 		// Access database
-		int aid = server._database.Open(
-			user_id, message_in.name, message_in.password,
-			message_in.assetf_name, start_value, timeactive, message_in.Fsize,
-			message_in.fdata);
+		int aid = DB_OPEN_CREATE_FAIL;
+		if (!staged_fname.empty()) {
+			aid = server._database->Open(
+				user_id, message_in.name, message_in.password,
+				message_in.assetf_name, start_value, timeactive,
+				message_in.Fsize, staged_fname);
+		}
 
 		if (aid > 0) {
 			message_out.status = ServerOpenAuction::status::OK;
@@ -415,7 +546,12 @@ void OpenAuctionRequest::handle(MessageAdapter &message, Server &server,
 			message_out.status = ServerOpenAuction::status::NOK;
 		}
 
+	} catch (UserNotLoggedIn &e) {
+		// Logged out between the check and opening the auction
+		message_out.status = ServerOpenAuction::status::NLG;
 	} catch (InvalidMessageException &e) {
+		// Where the asset ends is unknown, the connection ends with the answer
+		address.session = false;
 		message_out.status = ServerOpenAuction::status::ERR;
 	} catch (std::exception &e) {
 		printError("Failed to handle 'OPEN AUCTION' request." +
@@ -423,7 +559,7 @@ void OpenAuctionRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_tcp_message(message_out, address.socket, server._verbose);
+	server.sendTcpMessage(message_out, address);
 }
 
 /**
@@ -463,8 +599,8 @@ void CloseAuctionRequest::handle(MessageAdapter &message, Server &server,
 			convert_auction_id_to_str(message_in.auction_id);
 
 		// Access database
-		int res = server._database.CloseAuction(auction_id, user_id,
-		                                        message_in.password);
+		int res = server._database->CloseAuction(auction_id, user_id,
+		                                         message_in.password);
 		if (res != DB_CLOSE_NOK) {
 			message_out.status = ServerCloseAuction::status::OK;
 		}
@@ -489,7 +625,7 @@ void CloseAuctionRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_tcp_message(message_out, address.socket, server._verbose);
+	server.sendTcpMessage(message_out, address);
 }
 
 /**
@@ -507,6 +643,7 @@ void ShowAssetRequest::handle(MessageAdapter &message, Server &server,
                               Address &address) {
 	ClientShowAsset message_in;
 	ServerShowAsset message_out;
+	int asset_fd = -1;
 
 	try {
 		message_in.readMessage(message);
@@ -518,12 +655,12 @@ void ShowAssetRequest::handle(MessageAdapter &message, Server &server,
 		std::string aid_str = convert_auction_id_to_str(message_in.auction_id);
 
 		// Access database
-		AssetInfo ast_info = server._database.ShowAsset(aid_str);
+		AssetInfo ast_info = server._database->ShowAsset(aid_str);
 
 		message_out.status = ServerShowAsset::status::OK;
 		message_out.fname = ast_info.asset_fname;
 		message_out.fsize = ast_info.fsize;
-		message_out.fdata = ast_info.fdata;
+		asset_fd = ast_info.fd;
 
 	} catch (AssetDoesNotExist &e) {
 		message_out.status = ServerShowAsset::status::NOK;
@@ -535,7 +672,15 @@ void ShowAssetRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_tcp_message(message_out, address.socket, server._verbose);
+	if (asset_fd != -1) {
+		// The asset is sent straight from the file, after the header
+		char header[MESSAGE_BUFFER_LEN];
+		MessageWriter writer(header, sizeof(header));
+		message_out.buildHeader(writer);
+		server.sendTcpFile(writer.str(), asset_fd, message_out.fsize, address);
+		return;
+	}
+	server.sendTcpMessage(message_out, address);
 }
 
 /**
@@ -572,10 +717,13 @@ void BidRequest::handle(MessageAdapter &message, Server &server,
 		std::string bid_value = std::to_string(message_in.value);
 
 		// Access database
-		int res = server._database.Bid(user_id, message_in.password, auction_id,
-		                               bid_value);
+		int res = server._database->Bid(user_id, message_in.password,
+		                                auction_id, bid_value);
 		if (res == DB_BID_NOK) {
 			message_out.status = ServerBid::status::NOK;
+		} else if (res == DB_BID_REFUSE) {
+			// The bid wasn't stored
+			message_out.status = ServerBid::status::REF;
 		} else {
 			message_out.status = ServerBid::status::ACC;
 		}
@@ -597,7 +745,40 @@ void BidRequest::handle(MessageAdapter &message, Server &server,
 		return;
 	}
 
-	send_tcp_message(message_out, address.socket, server._verbose);
+	server.sendTcpMessage(message_out, address);
+}
+
+/**
+ * @brief  Responsible for handling the Open Session request. The connection
+ * stays open after the answer and the next requests read from it are answered
+ * in the order they were received.
+ * @param  &message: The adapter containing the raw received message.
+ * @param  &server: Instance of the server.
+ * @param  &address: The address to where the message should go.
+ * @throws InvalidMessageException if the message is wrongly formatted.
+ * @retval None
+ */
+void OpenSessionRequest::handle(MessageAdapter &message, Server &server,
+                                Address &address) {
+	ClientOpenSession message_in;
+	ServerOpenSession message_out;
+
+	try {
+		message_in.readMessage(message);
+		if (server._verbose) {
+			printAddressIncomingRequest(address);
+			printInOpenSessionRequest(message_in);
+		}
+		address.session = true;
+		message_out.status = ServerOpenSession::status::OK;
+	} catch (InvalidMessageException &e) {
+		message_out.status = ServerOpenSession::status::ERR;
+	} catch (std::exception &e) {
+		printError("Failed to handle 'SES' request." + std::string(e.what()));
+		return;
+	}
+
+	server.sendTcpMessage(message_out, address);
 }
 
 /**
@@ -613,9 +794,7 @@ void WrongRequestUDP::handle(MessageAdapter &message, Server &server,
 
 	ServerError message_out;
 
-	send_udp_message(message_out, address.socket,
-	                 (struct sockaddr *) &address.addr, address.size,
-	                 server._verbose);
+	server.sendUdpMessage(message_out, address);
 }
 
 /**
@@ -631,5 +810,5 @@ void WrongRequestTCP::handle(MessageAdapter &message, Server &server,
 
 	ServerError message_out;
 
-	send_tcp_message(message_out, address.socket, server._verbose);
+	server.sendTcpMessage(message_out, address);
 }
\ No newline at end of file
@@ -35,45 +35,42 @@ class UnknownHandlerException : public std::runtime_error {
  * @brief Login request handler.
  * This handler is responsible for handling the login request from the client.
  */
-class LoginRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class LoginRequest {
    public:
-	/**
-	 * @brief Constructs a LoginRequest object.
-	 */
-	LoginRequest() : RequestHandler(CODE_LOGIN_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_LOGIN_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Open Auction request handler.
  * This handler is responsible for handling the request to open an auction.
  */
-class OpenAuctionRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class OpenAuctionRequest {
    public:
-	/**
-	 * @brief Constructs an OpenAuctionRequest object.
-	 */
-	OpenAuctionRequest() : RequestHandler(CODE_OPEN_AUC_CLIENT) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_OPEN_AUC_CLIENT);
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
+int check_open_auction(Server &server, ClientOpenAuction &message_in);
+bool accept_open_auction_asset(Server &server, const std::string &header);
+
 /**
  * @brief Close Auction request handler.
  * This handler is responsible for handling the request to close an auction.
  */
-class CloseAuctionRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class CloseAuctionRequest {
    public:
-	/**
-	 * @brief Constructs a CloseAuctionRequest object.
-	 */
-	CloseAuctionRequest() : RequestHandler(CODE_CLOSE_AUC_CLIENT) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_CLOSE_AUC_CLIENT);
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
@@ -81,15 +78,13 @@ class CloseAuctionRequest : public RequestHandler {
  * This handler is responsible for handling the request to list the auctions of
  * the current user.
  */
-class ListStartedAuctionsRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class ListStartedAuctionsRequest {
    public:
-	/**
-	 * @brief Constructs a ListStartedAuctionsRequest object.
-	 */
-	ListStartedAuctionsRequest() : RequestHandler(CODE_LIST_AUC_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_LIST_AUC_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
@@ -97,15 +92,13 @@ class ListStartedAuctionsRequest : public RequestHandler {
  * This handler is responsible for handling the request to list the auctions
  * bidded by the current user.
  */
-class ListBiddedAuctionsRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class ListBiddedAuctionsRequest {
    public:
-	/**
-	 * @brief Constructs a ListBiddedAuctionsRequest object.
-	 */
-	ListBiddedAuctionsRequest() : RequestHandler(CODE_LIST_MYB_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_LIST_MYB_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
@@ -113,45 +106,53 @@ class ListBiddedAuctionsRequest : public RequestHandler {
  * This handler is responsible for handling the request to list all the
  * auctions.
  */
-class ListAllAuctionsRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class ListAllAuctionsRequest {
    public:
-	/**
-	 * @brief Constructs a ListAllAuctionsRequest object.
-	 */
-	ListAllAuctionsRequest() : RequestHandler(CODE_LIST_ALLAUC_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_LIST_ALLAUC_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Show Asset request handler.
  * This handler is responsible for handling the request to show the asset.
  */
-class ShowAssetRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class ShowAssetRequest {
    public:
-	/**
-	 * @brief Constructs a ShowAssetRequest object.
-	 */
-	ShowAssetRequest() : RequestHandler(CODE_SHOW_ASSET_CLIENT) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_SHOW_ASSET_CLIENT);
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Bid request handler.
  * This handler is responsible for handling the bid request from the client.
  */
-class BidRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
+class BidRequest {
+   public:
+	static constexpr uint32_t code = pack_protocol_code(CODE_BID_CLIENT);
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
+};
 
+/**
+ * @brief Open session request handler.
+ * This handler is responsible for keeping the TCP connection of the client open
+ * for its next requests.
+ */
+class OpenSessionRequest {
    public:
-	/**
-	 * @brief Constructs a BidRequest object.
-	 */
-	BidRequest() : RequestHandler(CODE_BID_CLIENT) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_SESSION_CLIENT);
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
@@ -159,30 +160,26 @@ class BidRequest : public RequestHandler {
  * This handler is responsible for handling the request to show the record of an
  * auction.
  */
-class ShowRecordRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class ShowRecordRequest {
    public:
-	/**
-	 * @brief Constructs a ShowRecordRequest object.
-	 */
-	ShowRecordRequest() : RequestHandler(CODE_SHOWREC_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_SHOWREC_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Logout request handler.
  * This handler is responsible for handling the logout request from the client.
  */
-class LogoutRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class LogoutRequest {
    public:
-	/**
-	 * @brief Constructs a LogoutRequest object.
-	 */
-	LogoutRequest() : RequestHandler(CODE_LOGOUT_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_LOGOUT_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
@@ -190,45 +187,37 @@ class LogoutRequest : public RequestHandler {
  * This handler is responsible for handling the request to unregister the
  * current user.
  */
-class UnregisterRequest : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class UnregisterRequest {
    public:
-	/**
-	 * @brief Constructs an UnregisterRequest object.
-	 */
-	UnregisterRequest() : RequestHandler(CODE_UNREGISTER_USER) {}
+	static constexpr uint32_t code = pack_protocol_code(CODE_UNREGISTER_USER);
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Wrong request handler (UDP).
  * This handler is responsible for handling the wrong request received over UDP.
  */
-class WrongRequestUDP : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class WrongRequestUDP {
    public:
-	/**
-	 * @brief Constructs a WrongRequestUDP object.
-	 */
-	WrongRequestUDP() : RequestHandler(CODE_ERROR) {}
+	static constexpr int type = UDP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 /**
  * @brief Wrong request handler (TCP).
  * This handler is responsible for handling the wrong request received over TCP.
  */
-class WrongRequestTCP : public RequestHandler {
-	virtual void handle(MessageAdapter &message, Server &client,
-	                    Address &address);
-
+class WrongRequestTCP {
    public:
-	/**
-	 * @brief Constructs a WrongRequestTCP object.
-	 */
-	WrongRequestTCP() : RequestHandler(CODE_ERROR) {}
+	static constexpr int type = TCP_MESSAGE;
+
+	static void handle(MessageAdapter &message, Server &client,
+	                   Address &address);
 };
 
 #endif
\ No newline at end of file
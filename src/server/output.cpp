@@ -34,6 +34,49 @@ void printInfo(std::string message, int tab_level) {
 	std::cout << prefix << "[INFO] " << message << std::endl;
 }
 
+/**
+ * @brief  Prints the first 100 characters of an outgoing answer.
+ * @param  message: The serialized answer.
+ * @retval None
+ */
+void printOutgoingAnswer(std::string message) {
+	std::string extra = message.length() > 100 ? "...\n" : "";
+	std::cout << "\t[INFO] Outgoing Answer (first 100 characters):\n\t-> "
+			  << message.substr(0, 100) << extra << std::endl;
+}
+
+/**
+ * @brief  Prints the throughput and receive queue of a UDP worker.
+ * @param  worker_id: Index of the worker in the pool.
+ * @param  requests_per_second: Requests handled per second since last report.
+ * @param  queued_bytes: Bytes waiting in the socket receive queue.
+ * @param  drops: Datagrams dropped by the socket since it was opened.
+ * @param  shed: Requests shed by admission control since it started.
+ * @param  stale: Requests dropped past the deadline since it started.
+ * @param  limited: Requests over a rate limit since it started.
+ * @retval None
+ */
+void printUdpWorkerStats(int worker_id, uint64_t requests_per_second,
+                         uint32_t queued_bytes, uint32_t drops, uint64_t shed,
+                         uint64_t stale, uint64_t limited) {
+	std::cout << "[STATS] UDP worker " << worker_id << ": "
+			  << requests_per_second << " req/s, queue " << queued_bytes
+			  << " B, " << drops << " dropped, " << shed << " shed, " << stale
+			  << " stale, " << limited << " limited" << std::endl;
+}
+
+/**
+ * @brief  Prints the requests refused by the TCP processes.
+ * @param  shed: Requests shed by admission control since it started.
+ * @param  limited: Requests and connections over a rate limit since it
+ * started.
+ * @retval None
+ */
+void printTcpStats(uint64_t shed, uint64_t limited) {
+	std::cout << "[STATS] TCP: " << shed << " shed, " << limited << " limited"
+			  << std::endl;
+}
+
 /**
  * @brief  Prints an request message.
  * @param  message: The type of message
@@ -195,9 +238,7 @@ void printInOpenAuctionRequest(ClientOpenAuction request) {
 			  << "\n\t<- Asset File Name: " << request.assetf_name
 			  << std::setprecision(3) << std::fixed
 			  << "\n\t<- Asset File Size: " << (float) request.Fsize / (1000000)
-			  << " MB"
-			  << "\n\t<- Asset File Data Length: "
-			  << std::to_string(request.fdata.length()) << " bytes. \n"
+			  << " MB\n"
 			  << std::endl;
 }
 
@@ -247,4 +288,14 @@ void printInBidRequest(ClientBid request) {
 	message += std::to_string(request.value);
 	message += "\n";
 	printInfo(message, 1);
+}
+
+/**
+ * @brief  Prints the open session request.
+ * @param  request: Struct containing the info.
+ * @retval None
+ */
+void printInOpenSessionRequest(ClientOpenSession request) {
+	(void) request;
+	printInfo("\tIncoming 'SES'\n", 1);
 }
\ No newline at end of file
@@ -13,6 +13,11 @@
 // All the functions resposinble for printing.
 void printError(std::string message);
 void printInfo(std::string message, int tab_level);
+void printOutgoingAnswer(std::string message);
+void printUdpWorkerStats(int worker_id, uint64_t requests_per_second,
+                         uint32_t queued_bytes, uint32_t drops, uint64_t shed,
+                         uint64_t stale, uint64_t limited);
+void printTcpStats(uint64_t shed, uint64_t limited);
 
 std::string hidePassword(std::string password);
 
@@ -28,4 +33,5 @@ void printInOpenAuctionRequest(ClientOpenAuction request);
 void printInCloseAuctionRequest(ClientCloseAuction request);
 void printInShowAssetRequest(ClientShowAsset request);
 void printInBidRequest(ClientBid request);
+void printInOpenSessionRequest(ClientOpenSession request);
 #endif
\ No newline at end of file
@@ -0,0 +1,201 @@
+/**
+ * @file rate_limit.cpp
+ * @brief Implementation of the per client rate limits.
+ */
+#include "rate_limit.hpp"
+
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+
+#include "server.hpp"
+
+/**
+ * @brief  Current time of a clock shared by every process.
+ * @retval Milliseconds since an arbitrary point.
+ */
+static uint64_t rate_limit_now_ms() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	return static_cast<uint64_t>(now.tv_sec) * 1000 +
+	       static_cast<uint64_t>(now.tv_nsec) / 1000000;
+}
+
+/**
+ * @brief  Takes the lock of an entry, yielding to the process holding it.
+ * @param  &entry: Entry to lock.
+ * @retval None
+ */
+static void lock_entry(RateLimitEntry &entry) {
+	while (entry.lock.test_and_set(std::memory_order_acquire)) {
+		sched_yield();
+	}
+}
+
+/**
+ * @brief  Releases the lock of an entry.
+ * @param  &entry: Entry to unlock.
+ * @retval None
+ */
+static void unlock_entry(RateLimitEntry &entry) {
+	entry.lock.clear(std::memory_order_release);
+}
+
+/**
+ * @brief  Adds the limit of a request code. Must be called before forking.
+ * @param  &protocol_code: Request code, or RATE_LIMIT_CONNECTION_CODE for new
+ * TCP connections.
+ * @param  rate: Requests per second a client may make.
+ * @param  burst: Requests a client may make at once after being idle.
+ * @retval -1 if there are too many limits or the code is already limited.
+ * @retval 0 if the limit was added.
+ */
+int RateLimiter::addLimit(const std::string &protocol_code, uint64_t rate,
+                          uint64_t burst) {
+	uint32_t code = pack_protocol_code(protocol_code);
+	if (_count == RATE_LIMIT_MAX_CODES || code == 0 || findLimit(code) != -1) {
+		return -1;
+	}
+	_codes[_count] = code;
+	_rates[_count] = rate;
+	_bursts[_count] = burst;
+	_count++;
+	return 0;
+}
+
+/**
+ * @brief  Finds the limit of a request code.
+ * @param  code: Request code, packed by pack_protocol_code.
+ * @retval Index of the limit, -1 if the code isn't limited.
+ */
+int RateLimiter::findLimit(uint32_t code) {
+	for (size_t i = 0; i < _count; i++) {
+		if (code == _codes[i]) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief  Whether a request code has a limit.
+ * @param  code: Request code, packed by pack_protocol_code.
+ * @retval true if it is limited.
+ */
+bool RateLimiter::limits(uint32_t code) {
+	return findLimit(code) != -1;
+}
+
+/**
+ * @brief  Refills the bucket of a limit for the time elapsed and takes a
+ * token from it. The entry must be locked.
+ * @param  &entry: Entry of the client.
+ * @param  limit: Index of the limit.
+ * @param  now_ms: Current time.
+ * @retval true if there was a token.
+ */
+bool RateLimiter::take(RateLimitEntry &entry, int limit, uint64_t now_ms) {
+	TokenBucket &bucket = entry.buckets[limit];
+	uint64_t full = _bursts[limit] * 1000;
+	uint64_t elapsed = now_ms - bucket.refilled_ms;
+	bucket.tokens = std::min(full, bucket.tokens + elapsed * _rates[limit]);
+	bucket.refilled_ms = now_ms;
+	entry.last_seen_ms = now_ms;
+
+	if (bucket.tokens < 1000) {
+		return false;
+	}
+	bucket.tokens -= 1000;
+	return true;
+}
+
+/**
+ * @brief  Checks a request of a client against the limit of its code. The
+ * client is looked for in RATE_LIMIT_PROBES slots after the one its address
+ * hashes to. A new client takes a free slot among them or, if there is none,
+ * the one of the client idle the longest, whose buckets have refilled the
+ * most by then.
+ * @param  address: Address of the client.
+ * @param  code: Request code, packed by pack_protocol_code.
+ * @retval true if the request is within the limit (or the code isn't limited).
+ * @retval false if it should be refused.
+ */
+bool RateLimiter::allow(in_addr_t address, uint32_t code) {
+	int limit = findLimit(code);
+	if (limit == -1) {
+		return true;
+	}
+	uint64_t now_ms = rate_limit_now_ms();
+	size_t start = (static_cast<size_t>(address) * 2654435761u) %
+	               RATE_LIMIT_SLOTS;
+
+	for (size_t i = 0; i < RATE_LIMIT_PROBES; i++) {
+		RateLimitEntry &entry = _entries[(start + i) % RATE_LIMIT_SLOTS];
+		lock_entry(entry);
+		if (entry.used && entry.address == address) {
+			bool allowed = take(entry, limit, now_ms);
+			unlock_entry(entry);
+			return allowed;
+		}
+		unlock_entry(entry);
+	}
+
+	// New client, reuse the slot of the client idle the longest
+	size_t oldest = start;
+	uint64_t oldest_seen = UINT64_MAX;
+	for (size_t i = 0; i < RATE_LIMIT_PROBES; i++) {
+		size_t slot = (start + i) % RATE_LIMIT_SLOTS;
+		RateLimitEntry &entry = _entries[slot];
+		lock_entry(entry);
+		uint64_t seen = entry.used ? entry.last_seen_ms : 0;
+		unlock_entry(entry);
+		if (seen < oldest_seen) {
+			oldest = slot;
+			oldest_seen = seen;
+		}
+	}
+
+	RateLimitEntry &entry = _entries[oldest];
+	lock_entry(entry);
+	if (!entry.used || entry.address != address) {
+		entry.used = true;
+		entry.address = address;
+		for (size_t i = 0; i < _count; i++) {
+			entry.buckets[i].tokens = _bursts[i] * 1000;
+			entry.buckets[i].refilled_ms = now_ms;
+		}
+	}
+	bool allowed = take(entry, limit, now_ms);
+	unlock_entry(entry);
+	return allowed;
+}
+
+/**
+ * @brief  Maps the limiter. Must be called before forking so every process
+ * sees the same mapping.
+ * @throws UnrecoverableException
+ * @retval The limiter, without limits and with an empty table.
+ */
+RateLimiter *create_rate_limiter() {
+	void *mapping = mmap(NULL, sizeof(RateLimiter), PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw UnrecoverableException("[ERROR] Failed to map rate limits");
+	}
+	return new (mapping) RateLimiter();
+}
+
+/**
+ * @brief  Unmaps the limiter from this process.
+ * @param  limiter: Limiter returned by create_rate_limiter.
+ * @retval None
+ */
+void destroy_rate_limiter(RateLimiter *limiter) {
+	if (limiter != NULL) {
+		munmap(limiter, sizeof(RateLimiter));
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef __RATE_LIMIT__
+#define __RATE_LIMIT__
+
+/**
+ * @file rate_limit.hpp
+ * @brief Declaration of the per client rate limits. A token bucket is kept for
+ * each client address and limited request code, in a table of fixed size that
+ * lives in an anonymous shared mapping created before forking, so every worker
+ * and handler thread checks the same buckets.
+ */
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Code of the limit on new TCP connections (-r TCP:<rate>)
+#define RATE_LIMIT_CONNECTION_CODE "TCP"
+
+// Size of the table of clients, entries are looked for in a few slots only
+#define RATE_LIMIT_SLOTS  4096
+#define RATE_LIMIT_PROBES 8
+
+// Max number of codes limited at once and max rate of a limit
+#define RATE_LIMIT_MAX_CODES 16
+#define RATE_LIMIT_MAX_RATE  100000
+
+/**
+ * @brief  Tokens of a client for a request code, in thousandths of a request.
+ */
+class TokenBucket {
+   public:
+	uint64_t tokens;
+	uint64_t refilled_ms;
+};
+
+/**
+ * @brief  Buckets of a client. The lock is taken for every check, it is only
+ * held for a few instructions.
+ */
+class RateLimitEntry {
+   public:
+	std::atomic_flag lock = ATOMIC_FLAG_INIT;
+	in_addr_t address;
+	bool used;
+	uint64_t last_seen_ms;
+	TokenBucket buckets[RATE_LIMIT_MAX_CODES];
+};
+
+/**
+ * @brief  Limits of every code and the table of clients. The limits are set
+ * before forking and only read afterwards.
+ */
+class RateLimiter {
+	uint32_t _codes[RATE_LIMIT_MAX_CODES];   // Packed by pack_protocol_code
+	uint64_t _rates[RATE_LIMIT_MAX_CODES];   // Requests per second
+	uint64_t _bursts[RATE_LIMIT_MAX_CODES];  // Bucket size in requests
+	size_t _count = 0;
+	RateLimitEntry _entries[RATE_LIMIT_SLOTS];
+
+	int findLimit(uint32_t code);
+	bool take(RateLimitEntry &entry, int limit, uint64_t now_ms);
+
+   public:
+	int addLimit(const std::string &protocol_code, uint64_t rate,
+	             uint64_t burst);
+	bool limits(uint32_t code);
+	bool allow(in_addr_t address, uint32_t code);
+};
+
+RateLimiter *create_rate_limiter();
+void destroy_rate_limiter(RateLimiter *limiter);
+
+#endif
@@ -5,13 +5,23 @@
 #include "server.hpp"
 
 #include <arpa/inet.h>
+#include <linux/sock_diag.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <csignal>
+#include <vector>
 
+#include "event_loop.hpp"
 #include "handlers.hpp"
 #include "output.hpp"
+#include "udp_batch.hpp"
+#include "uring_loop.hpp"
+#include "wal_database.hpp"
 
 // -------------------------------------
 // | Signals and termination handling. |
@@ -78,7 +88,9 @@ void Server::setupSignalHandlers() {
 void Server::configServer(int argc, char *argv[]) {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "p:v")) != -1) {
+	std::string count;
+
+	while ((opt = getopt(argc, argv, "p:ve:w:q:u:s:b:x:a:d:r:D:")) != -1) {
 		switch (opt) {
 			case 'v':
 				_verbose = true;
@@ -86,6 +98,116 @@ void Server::configServer(int argc, char *argv[]) {
 			case 'p':
 				_port = std::string(optarg);
 				break;
+			case 'e':
+				if (std::string(optarg) == "fork") {
+					_tcp_engine = TCP_ENGINE_FORK;
+				} else if (std::string(optarg) == "epoll") {
+					_tcp_engine = TCP_ENGINE_EPOLL;
+				} else if (std::string(optarg) == "uring") {
+					_tcp_engine = TCP_ENGINE_URING;
+				} else {
+					std::cout
+						<< "[ERROR] Unknown TCP engine (fork|epoll|uring)."
+						<< std::endl;
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'D':
+				if (std::string(optarg) == "asdir") {
+					_database_backend = DATABASE_ASDIR;
+				} else if (std::string(optarg) == "wal") {
+					_database_backend = DATABASE_WAL;
+				} else {
+					std::cout << "[ERROR] Unknown database backend (asdir|wal)."
+							  << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'w':
+				count = std::string(optarg);
+				if (verify_count_option(count, TCP_MAX_WORKERS) == -1) {
+					std::cout << "[ERROR] Number of TCP workers must be "
+								 "between 1 and "
+							  << TCP_MAX_WORKERS << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_tcp_workers = stoi(count);
+				break;
+			case 'q':
+				count = std::string(optarg);
+				if (verify_count_option(count, SOMAXCONN) == -1) {
+					std::cout << "[ERROR] TCP queue size must be between 1 and "
+							  << SOMAXCONN << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_tcp_queue_size = stoi(count);
+				break;
+			case 'u':
+				count = std::string(optarg);
+				if (verify_count_option(count, UDP_MAX_WORKERS) == -1) {
+					std::cout << "[ERROR] Number of UDP workers must be "
+								 "between 1 and "
+							  << UDP_MAX_WORKERS << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_udp_workers = stoi(count);
+				break;
+			case 'b':
+				count = std::string(optarg);
+				if (verify_count_option(count, UDP_MAX_BATCH) == -1) {
+					std::cout << "[ERROR] UDP batch size must be between 1 and "
+							  << UDP_MAX_BATCH << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_udp_batch = stoi(count);
+				break;
+			case 's':
+				count = std::string(optarg);
+				if (verify_count_option(count, 3600) == -1) {
+					std::cout << "[ERROR] Stats interval must be between 1 and "
+								 "3600 seconds."
+							  << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_stats_interval = stoi(count);
+				break;
+			case 'x':
+				count = std::string(optarg);
+				if (verify_count_option(count, EXECUTOR_MAX_THREADS) == -1) {
+					std::cout << "[ERROR] Handler threads must be between 1 and "
+							  << EXECUTOR_MAX_THREADS << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_executor_threads = stoi(count);
+				break;
+			case 'd':
+				count = std::string(optarg);
+				if (verify_count_option(count, UDP_MAX_DEADLINE_MS) == -1) {
+					std::cout << "[ERROR] UDP deadline must be between 1 and "
+							  << UDP_MAX_DEADLINE_MS << " ms." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				_udp_deadline_ms = stoi(count);
+				break;
+			case 'r':
+				if (configRateLimit(std::string(optarg)) == -1) {
+					std::cout << "[ERROR] Rate limits must be "
+								 "<code>:<rate>[:<burst>] with a request code "
+								 "or TCP, at most "
+							  << RATE_LIMIT_MAX_CODES << " codes, rate up to "
+							  << RATE_LIMIT_MAX_RATE << "." << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'a':
+				if (configAdmission(std::string(optarg)) == -1) {
+					std::cout << "[ERROR] Watermarks must be <high>[:<low>] with "
+								 "high at most "
+							  << ADMISSION_MAX_WATERMARK << " and low below it."
+							  << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				break;
 			default:
 				std::cout << "[ERROR] Config error." << std::endl;
 				exit(EXIT_FAILURE);
@@ -96,9 +218,108 @@ void Server::configServer(int argc, char *argv[]) {
 		exit(EXIT_FAILURE);
 	};
 
+	// The UDP queue is measured by receiving everything waiting up to its
+	// bound, so the batch has to hold it. Received one at a time, the queue
+	// isn't measured and no UDP request is shed.
+	if (_admission.enabled() && _udp_batch > 1) {
+		_udp_batch =
+			std::max(_udp_batch, static_cast<int>(_admission.capacity()));
+	} else if (_admission.enabled()) {
+		std::cerr << "[UDP] Requests received one at a time (-b 1) aren't "
+					 "shed by admission control (-a)."
+				  << std::endl;
+	}
+
 	setupSignalHandlers();
 }
 
+/**
+ * @brief  Parses the watermarks of the admission control (-a). The low
+ * watermark defaults to half the high one.
+ * @param  option: <high>[:<low>].
+ * @retval -1 if the watermarks are invalid.
+ * @retval 0 if they were set.
+ */
+int Server::configAdmission(std::string option) {
+	std::string high = option.substr(0, option.find(':'));
+	if (verify_count_option(high, ADMISSION_MAX_WATERMARK) == -1) {
+		return -1;
+	}
+	size_t high_mark = static_cast<size_t>(stoi(high));
+	size_t low_mark = high_mark / 2;
+
+	if (option.find(':') != std::string::npos) {
+		std::string low = option.substr(option.find(':') + 1);
+		if (low == "0") {
+			low_mark = 0;
+		} else if (verify_count_option(low, ADMISSION_MAX_WATERMARK) == -1) {
+			return -1;
+		} else {
+			low_mark = static_cast<size_t>(stoi(low));
+		}
+	}
+	if (low_mark >= high_mark) {
+		return -1;
+	}
+
+	_admission.configure(high_mark, low_mark);
+	return 0;
+}
+
+/**
+ * @brief  Parses a rate limit (-r) and adds it to the limiter, which is
+ * created with the first one. The burst defaults to the rate.
+ * @param  option: <code>:<rate>[:<burst>].
+ * @retval -1 if the limit is invalid.
+ * @retval 0 if it was added.
+ */
+int Server::configRateLimit(std::string option) {
+	static const char *codes[] = {
+		CODE_LOGIN_USER,        CODE_LOGOUT_USER,     CODE_UNREGISTER_USER,
+		CODE_LIST_AUC_USER,     CODE_LIST_MYB_USER,   CODE_LIST_ALLAUC_USER,
+		CODE_SHOWREC_USER,      CODE_OPEN_AUC_CLIENT, CODE_CLOSE_AUC_CLIENT,
+		CODE_SHOW_ASSET_CLIENT, CODE_BID_CLIENT,      CODE_SESSION_CLIENT,
+		RATE_LIMIT_CONNECTION_CODE};
+
+	size_t rate_start = option.find(':');
+	if (rate_start == std::string::npos) {
+		return -1;
+	}
+	std::string code = option.substr(0, rate_start);
+	auto known = std::find_if(std::begin(codes), std::end(codes),
+	                          [&code](const char *c) { return code == c; });
+	if (known == std::end(codes)) {
+		return -1;
+	}
+
+	std::string rate = option.substr(rate_start + 1);
+	std::string burst = rate;
+	size_t burst_start = rate.find(':');
+	if (burst_start != std::string::npos) {
+		burst = rate.substr(burst_start + 1);
+		rate = rate.substr(0, burst_start);
+	}
+	if (verify_count_option(rate, RATE_LIMIT_MAX_RATE) == -1 ||
+	    verify_count_option(burst, RATE_LIMIT_MAX_RATE) == -1) {
+		return -1;
+	}
+
+	if (_rate_limiter == NULL) {
+		_rate_limiter = create_rate_limiter();
+	}
+	return _rate_limiter->addLimit(code, static_cast<uint64_t>(stoi(rate)),
+	                               static_cast<uint64_t>(stoi(burst)));
+}
+
+/**
+ * @brief  Counters of the process handling a message.
+ * @param  type: Type of the message. Can be UDP_MESSAGE or TCP_MESSAGE.
+ * @retval The counters of this UDP worker or the ones of the TCP processes.
+ */
+WorkerStats &Server::workerStats(int type) {
+	return type == UDP_MESSAGE ? _stats->udp[_udp_worker_id] : _stats->tcp;
+}
+
 /**
  * @brief  Constructor that configures the server and creates the sockets.
  * @param  argc: Number of arguments passed in the command line.
@@ -111,7 +332,17 @@ Server::Server(int argc, char *argv[]) {
 		throw UnrecoverableException("[ERROR] Couldn't open socket");
 	}
 	// Creates base for database
-	_database.CreateBaseDir(stoi(_port));
+	if (_database_backend == DATABASE_WAL) {
+		_database = std::make_unique<WalDatabase>();
+	} else {
+		_database = std::make_unique<Database>();
+	}
+	if (_database->CreateBaseDir(stoi(_port)) == -1) {
+		throw UnrecoverableException("[ERROR] Failed to load the database");
+	}
+
+	// Counters shared with the workers
+	_stats = create_server_stats();
 
 	// Setup sockets
 	setup_sockets();
@@ -137,6 +368,8 @@ Server::~Server() {
 	if (this->_server_tcp_addr != NULL) {
 		freeaddrinfo(this->_server_tcp_addr);
 	}
+	destroy_server_stats(this->_stats);
+	destroy_rate_limiter(this->_rate_limiter);
 }
 
 /**
@@ -155,6 +388,13 @@ void Server::setup_sockets() {
 		throw UnrecoverableException(
 			"[ERROR] Failed to set UDP reuse address socket option");
 	}
+	// With a worker pool every worker binds its own socket to the port.
+	if (_udp_workers > 0 &&
+	    setsockopt(_udp_socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable_udp,
+	               sizeof(int)) < 0) {
+		throw UnrecoverableException(
+			"[ERROR] Failed to set UDP reuse port socket option");
+	}
 
 	// Create a TCP socket
 	if ((_tcp_socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
@@ -168,6 +408,46 @@ void Server::setup_sockets() {
 		throw UnrecoverableException(
 			"[ERROR] Failed to set TCP reuse address socket option");
 	}
+
+	// With a worker pool every worker binds its own socket to the port. The
+	// UDP process keeps a copy of this one, so it has to share the port too.
+	if (_tcp_workers > 0 &&
+	    setsockopt(_tcp_socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable_tcp,
+	               sizeof(int)) < 0) {
+		throw UnrecoverableException(
+			"[ERROR] Failed to set TCP reuse port socket option");
+	}
+}
+
+/**
+ * @brief  Opens the listening socket of a TCP worker. It is bound to the
+ * server port with SO_REUSEPORT so the kernel spreads new connections between
+ * the workers, each one with its own accept queue of _tcp_queue_size.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void Server::openWorkerTcpSocket() {
+	if ((_tcp_socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+		throw UnrecoverableException("[ERROR] Failed to create a TCP socket");
+	}
+
+	const int enable = 1;
+	if (setsockopt(_tcp_socket_fd, SOL_SOCKET, SO_REUSEADDR, &enable,
+	               sizeof(int)) < 0 ||
+	    setsockopt(_tcp_socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable,
+	               sizeof(int)) < 0) {
+		throw UnrecoverableException(
+			"[ERROR] Failed to set TCP reuse port socket option");
+	}
+
+	if (bind(_tcp_socket_fd, _server_tcp_addr->ai_addr,
+	         _server_tcp_addr->ai_addrlen) < 0) {
+		throw UnrecoverableException("[ERROR] Failed to bind TCP address");
+	}
+
+	if (listen(_tcp_socket_fd, _tcp_queue_size) < 0) {
+		throw UnrecoverableException("[ERROR] Failed to listen on TCP socket");
+	}
 }
 
 /**
@@ -217,45 +497,214 @@ void Server::resolveServerAddress(std::string &port) {
 	std::cout << "Listening for connections on port " << port << std::endl;
 }
 
-// -------------------------------------
-// | Request Handler and Manager	   |
-// -------------------------------------
+/**
+ * @brief  Opens another UDP socket bound to the server port with SO_REUSEPORT,
+ * so the kernel spreads the datagrams between it and the other workers.
+ * @throws UnrecoverableException
+ * @retval File descriptor of the socket.
+ */
+int Server::openWorkerUdpSocket() {
+	int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (socket_fd == -1) {
+		throw UnrecoverableException("[ERROR] Failed to create a UDP socket");
+	}
+
+	const int enable = 1;
+	if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &enable,
+	               sizeof(int)) < 0 ||
+	    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable,
+	               sizeof(int)) < 0) {
+		close(socket_fd);
+		throw UnrecoverableException(
+			"[ERROR] Failed to set UDP reuse port socket option");
+	}
+
+	if (bind(socket_fd, _server_udp_addr->ai_addr,
+	         _server_udp_addr->ai_addrlen) < 0) {
+		close(socket_fd);
+		throw UnrecoverableException("[ERROR] Failed to bind UDP address.");
+	}
+	return socket_fd;
+}
 
 /**
- * @brief  Registers a request handler in the request manager.
- * @param  handler: Request handler to be registered.
- * @param  type: Type of the request handler. Can be UDP_MESSAGE or TCP_MESSAGE.
+ * @brief  Starts the request handler threads of this process, if enabled with
+ * -x. Called by each process after forking, threads don't survive fork().
  * @retval None
  */
-void RequestManager::registerRequest(std::shared_ptr<RequestHandler> handler,
-                                     int type) {
-	if (type == UDP_MESSAGE) {
-		_udp_handlers.insert({handler->_protocol_code, handler});
-	} else {
-		_tcp_handlers.insert({handler->_protocol_code, handler});
+void Server::startExecutor() {
+	if (_executor_threads > 0 && _executor == nullptr) {
+		_executor =
+			std::make_unique<Executor>(static_cast<size_t>(_executor_threads));
+	}
+}
+
+/**
+ * @brief  Sends an answer through UDP to the address it came from. If the
+ * request is part of a batch, the answer is queued and sent with the rest of
+ * the batch instead.
+ * @param  &out_message: Answer to be sent.
+ * @param  &addr_from: Address of the client.
+ * @retval None
+ */
+void Server::sendUdpMessage(ProtocolMessage &out_message, Address &addr_from) {
+	if (addr_from.reply == NULL) {
+		send_udp_message(out_message, addr_from.socket,
+		                 (struct sockaddr *) &addr_from.addr, addr_from.size,
+		                 _verbose);
+		return;
+	}
+
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	out_message.buildMessage(writer);
+	writer.appendTo(*addr_from.reply);
+	if (_verbose) {
+		printOutgoingAnswer(writer.str());
+	}
+}
+
+/**
+ * @brief  Sends an answer through TCP. If the connection is owned by the event
+ * loop, the answer is queued in the connection instead and written once the
+ * socket is ready.
+ * @param  &out_message: Answer to be sent.
+ * @param  &addr_to: Address (and socket) of the client.
+ * @retval None
+ */
+void Server::sendTcpMessage(ProtocolMessage &out_message, Address &addr_to) {
+	addr_to.answered = true;
+	if (addr_to.reply == NULL) {
+		send_tcp_message(out_message, addr_to.socket, _verbose);
+		return;
+	}
+
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	out_message.buildMessage(writer);
+	writer.appendTo(*addr_to.reply);
+	if (_verbose) {
+		printOutgoingAnswer(writer.str());
 	}
 }
 
 /**
- * @brief  Registers all the request handlers in the request manager for each
- * command possible.
+ * @brief  Writes bytes to a TCP socket until all of them are sent.
+ * @param  socket_fd: TCP socket file descriptor.
+ * @param  *data: Bytes to send.
+ * @param  len: Number of bytes.
+ * @param  flags: Flags of send(), MSG_MORE if more follows right away.
+ * @throws MessageSendException
  * @retval None
  */
-void RequestManager::registerRequestHandlers() {
-	registerRequest(std::make_shared<LoginRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<LogoutRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<UnregisterRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<ListAllAuctionsRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<ListBiddedAuctionsRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<ListStartedAuctionsRequest>(),
-	                UDP_MESSAGE);
-	registerRequest(std::make_shared<ShowRecordRequest>(), UDP_MESSAGE);
-	registerRequest(std::make_shared<OpenAuctionRequest>(), TCP_MESSAGE);
-	registerRequest(std::make_shared<CloseAuctionRequest>(), TCP_MESSAGE);
-	registerRequest(std::make_shared<ShowAssetRequest>(), TCP_MESSAGE);
-	registerRequest(std::make_shared<BidRequest>(), TCP_MESSAGE);
-	registerRequest(std::make_shared<WrongRequestUDP>(), TCP_MESSAGE);
-	registerRequest(std::make_shared<WrongRequestTCP>(), TCP_MESSAGE);
+static void send_tcp_bytes(int socket_fd, const char *data, size_t len,
+                           int flags) {
+	size_t bytes_sent = 0;
+	while (bytes_sent < len) {
+		ssize_t sent = send(socket_fd, data + bytes_sent, len - bytes_sent,
+		                    flags | MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent < 0) {
+			throw MessageSendException();
+		}
+		bytes_sent += static_cast<size_t>(sent);
+	}
+}
+
+/**
+ * @brief  Sends a header, the contents of a file and a delimiter through a
+ * TCP socket. The file goes from the page cache to the socket with sendfile()
+ * and the header is held back with MSG_MORE so that it leaves with the start
+ * of the file.
+ * @param  socket_fd: TCP socket file descriptor.
+ * @param  &header: Bytes sent before the file.
+ * @param  file_fd: File to send.
+ * @param  file_size: Bytes of the file to send.
+ * @throws MessageSendException
+ * @retval None
+ */
+static void send_tcp_file(int socket_fd, const std::string &header,
+                          int file_fd, size_t file_size) {
+	send_tcp_bytes(socket_fd, header.data(), header.size(), MSG_MORE);
+	off_t offset = 0;
+	while (file_size > 0) {
+		ssize_t sent = sendfile(socket_fd, file_fd, &offset, file_size);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			// Also when the file got shorter than its announced size
+			throw MessageSendException();
+		}
+		file_size -= static_cast<size_t>(sent);
+	}
+	send_tcp_bytes(socket_fd, "\n", 1, 0);
+}
+
+/**
+ * @brief  Sends an answer made of a header, the contents of a file and a
+ * delimiter through TCP, without reading the file into memory. If the
+ * connection is owned by the event loop, the file is queued after the answers
+ * waiting to be written and the loop sends it once they are written.
+ * @param  &header: Answer up to the file data.
+ * @param  file_fd: File to send, closed once it is sent.
+ * @param  file_size: Bytes of the file to send.
+ * @param  &addr_to: Address (and socket) of the client.
+ * @throws MessageSendException
+ * @retval None
+ */
+void Server::sendTcpFile(const std::string &header, int file_fd,
+                         size_t file_size, Address &addr_to) {
+	addr_to.answered = true;
+	if (_verbose) {
+		printOutgoingAnswer(header);
+	}
+	if (addr_to.reply != NULL) {
+		addr_to.reply->append(header);
+		if (file_size > 0) {
+			addr_to.files->push_back(
+				ReplyFile{addr_to.reply->size(), file_fd, 0, file_size});
+		} else {
+			close(file_fd);
+		}
+		addr_to.reply->push_back('\n');
+		return;
+	}
+
+	try {
+		send_tcp_file(addr_to.socket, header, file_fd, file_size);
+	} catch (MessageSendException &e) {
+		close(file_fd);
+		throw;
+	}
+	close(file_fd);
+}
+
+// -------------------------------------
+// | Request Handler and Manager	   |
+// -------------------------------------
+
+/**
+ * @brief  Calls the handler of a request if it came over the transport the
+ * handler serves, or the handler of wrong requests otherwise.
+ * @param  message: Message to be handled.
+ * @param  server: Server instance.
+ * @param  address: Address of the client.
+ * @param  type: Type of the message. Can be UDP_MESSAGE or TCP_MESSAGE.
+ * @retval None
+ */
+template <typename Handler>
+static void route_request(MessageAdapter &message, Server &server,
+                          Address &address, int type) {
+	if (type == Handler::type) {
+		Handler::handle(message, server, address);
+	} else if (type == UDP_MESSAGE) {
+		WrongRequestUDP::handle(message, server, address);
+	} else {
+		WrongRequestTCP::handle(message, server, address);
+	}
 }
 
 /**
@@ -268,19 +717,83 @@ void RequestManager::registerRequestHandlers() {
  */
 void RequestManager::callHandlerRequest(MessageAdapter &message, Server &server,
                                         Address &address, int type) {
-	std::string rec_proto_code = message.getn(PROTOCOL_SIZE);
+	uint32_t code = read_protocol_code(message);
+	if (!server._admission.admit(code)) {
+		refuseRequest(server, address, type);
+		count_shed(server.workerStats(type));
+		return;
+	}
+	if (server._rate_limiter != NULL &&
+	    !server._rate_limiter->allow(address.addr.sin_addr.s_addr, code)) {
+		refuseRequest(server, address, type);
+		count_limited(server.workerStats(type));
+		return;
+	}
+	switch (code) {
+		case LoginRequest::code:
+			route_request<LoginRequest>(message, server, address, type);
+			break;
+		case LogoutRequest::code:
+			route_request<LogoutRequest>(message, server, address, type);
+			break;
+		case UnregisterRequest::code:
+			route_request<UnregisterRequest>(message, server, address, type);
+			break;
+		case ListAllAuctionsRequest::code:
+			route_request<ListAllAuctionsRequest>(message, server, address,
+			                                      type);
+			break;
+		case ListBiddedAuctionsRequest::code:
+			route_request<ListBiddedAuctionsRequest>(message, server, address,
+			                                         type);
+			break;
+		case ListStartedAuctionsRequest::code:
+			route_request<ListStartedAuctionsRequest>(message, server, address,
+			                                          type);
+			break;
+		case ShowRecordRequest::code:
+			route_request<ShowRecordRequest>(message, server, address, type);
+			break;
+		case OpenAuctionRequest::code:
+			route_request<OpenAuctionRequest>(message, server, address, type);
+			break;
+		case CloseAuctionRequest::code:
+			route_request<CloseAuctionRequest>(message, server, address, type);
+			break;
+		case ShowAssetRequest::code:
+			route_request<ShowAssetRequest>(message, server, address, type);
+			break;
+		case BidRequest::code:
+			route_request<BidRequest>(message, server, address, type);
+			break;
+		case OpenSessionRequest::code:
+			route_request<OpenSessionRequest>(message, server, address, type);
+			break;
+		default:
+			if (type == UDP_MESSAGE) {
+				WrongRequestUDP::handle(message, server, address);
+			} else {
+				WrongRequestTCP::handle(message, server, address);
+			}
+			break;
+	}
+}
+
+/**
+ * @brief  Answers a request shed by admission control or over its rate limit
+ * with ERR, without handling it.
+ * @param  server: Server instance.
+ * @param  address: Address of the client.
+ * @param  type: Type of the message. Can be UDP_MESSAGE or TCP_MESSAGE.
+ * @retval None
+ */
+void RequestManager::refuseRequest(Server &server, Address &address,
+                                   int type) {
+	ServerError error;
 	if (type == UDP_MESSAGE) {
-		auto handler = _udp_handlers.find(rec_proto_code);
-		if (handler == _udp_handlers.end()) {
-			handler = _udp_handlers.find(CODE_ERROR);
-		}
-		handler->second->handle(message, server, address);
+		server.sendUdpMessage(error, address);
 	} else {
-		auto handler = _tcp_handlers.find(rec_proto_code);
-		if (handler == _tcp_handlers.end()) {
-			handler = _tcp_handlers.find(CODE_ERROR);
-		}
-		handler->second->handle(message, server, address);
+		server.sendTcpMessage(error, address);
 	}
 }
 
@@ -295,11 +808,34 @@ void RequestManager::callHandlerRequest(MessageAdapter &message, Server &server,
  * @retval None
  */
 void processUDP(Server &server, RequestManager &manager) {
-	int ex_trial = 0;
+	if (server._udp_workers > 0) {
+		processUDPPool(server, manager);
+		return;
+	}
+
 	std::cout << "[UDP] Started UDP server." << std::endl;
+	serveUDP(server, manager);
+}
+
+/**
+ * @brief  Receives and handles UDP messages, in batches of _udp_batch or one at
+ * a time, until too many errors happen in a row.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @retval None
+ */
+void serveUDP(Server &server, RequestManager &manager) {
+	server.startExecutor();
+	enable_udp_timestamps(server._udp_socket_fd);
+	UdpBatch batch(static_cast<size_t>(server._udp_batch));
+	int ex_trial = 0;
 	while (true) {
 		try {
-			wait_for_udp_message(server, manager);
+			if (server._udp_batch > 1) {
+				wait_for_udp_batch(server, manager, batch);
+			} else {
+				wait_for_udp_message(server, manager);
+			}
 			ex_trial = 0;
 		} catch (UnknownHandlerException &e) {
 			std::cerr << "[UDP] Unknown handler for message." << std::endl;
@@ -323,6 +859,116 @@ void processUDP(Server &server, RequestManager &manager) {
 	}
 }
 
+/**
+ * @brief  Starts the UDP workers and supervises them (UDP Parent Process). The
+ * sockets are opened here and kept open, so a worker that exits is started
+ * again on the same socket without losing the datagrams waiting in it. Every
+ * _stats_interval seconds the throughput and queue of each worker is printed,
+ * with the requests it refused.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @retval None
+ */
+void processUDPPool(Server &server, RequestManager &manager) {
+	// The workers are waited for, so they can't be reaped automatically
+	signal(SIGCHLD, SIG_DFL);
+
+	std::vector<int> sockets = {server._udp_socket_fd};
+	try {
+		for (int i = 1; i < server._udp_workers; i++) {
+			sockets.push_back(server.openWorkerUdpSocket());
+		}
+	} catch (UnrecoverableException &e) {
+		std::cerr << e.what() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<pid_t> workers;
+	std::vector<uint64_t> last_requests(sockets.size(), 0);
+	for (size_t i = 0; i < sockets.size(); i++) {
+		workers.push_back(
+			spawnUDPWorker(server, manager, static_cast<int>(i), sockets[i]));
+	}
+	std::cout << "[UDP] Started " << server._udp_workers << " UDP workers."
+			  << std::endl;
+
+	int elapsed = 0;
+	while (true) {
+		sleep(1);
+		if (sig_int) {
+			break;
+		}
+
+		pid_t pid;
+		while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+			auto worker = std::find(workers.begin(), workers.end(), pid);
+			if (worker == workers.end()) {
+				continue;
+			}
+			size_t id = static_cast<size_t>(worker - workers.begin());
+			std::cerr << "[UDP] Worker " << id << " exited. Restarting..."
+					  << std::endl;
+			*worker = spawnUDPWorker(server, manager, static_cast<int>(id),
+			                         sockets[id]);
+		}
+
+		if (server._stats_interval == 0 ||
+		    ++elapsed < server._stats_interval) {
+			continue;
+		}
+		for (size_t i = 0; i < sockets.size(); i++) {
+			uint64_t requests = server._stats->udp[i].requests.load(
+				std::memory_order_relaxed);
+			uint32_t meminfo[SK_MEMINFO_VARS] = {0};
+			socklen_t len = sizeof(meminfo);
+			getsockopt(sockets[i], SOL_SOCKET, SO_MEMINFO, meminfo, &len);
+			printUdpWorkerStats(
+				static_cast<int>(i),
+				(requests - last_requests[i]) / static_cast<uint64_t>(elapsed),
+				meminfo[SK_MEMINFO_RMEM_ALLOC], meminfo[SK_MEMINFO_DROPS],
+				server._stats->udp[i].shed.load(std::memory_order_relaxed),
+				server._stats->udp[i].stale.load(std::memory_order_relaxed),
+				server._stats->udp[i].limited.load(std::memory_order_relaxed));
+			last_requests[i] = requests;
+		}
+		elapsed = 0;
+	}
+
+	// Pass SIGINT on to the workers and wait for them to shut down
+	for (pid_t worker : workers) {
+		kill(worker, SIGINT);
+	}
+	for (pid_t worker : workers) {
+		while (waitpid(worker, NULL, 0) == -1 && errno == EINTR) {
+		}
+	}
+	terminate(server, UDP_MESSAGE);
+}
+
+/**
+ * @brief  Forks a new UDP worker that serves the datagrams of one socket.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  worker_id: Index of the worker in the pool.
+ * @param  socket_fd: UDP socket of the worker.
+ * @throws UnrecoverableException
+ * @retval Process id of the worker.
+ */
+pid_t spawnUDPWorker(Server &server, RequestManager &manager, int worker_id,
+                     int socket_fd) {
+	pid_t pid = fork();
+	if (pid < 0) {
+		throw UnrecoverableException(
+			"[ERROR] Failed to fork process. Couldn't start UDP worker.");
+	} else if (pid == 0) {
+		server._udp_socket_fd = socket_fd;
+		server._udp_worker_id = worker_id;
+		serveUDP(server, manager);
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
 /**
  * @brief  Processes the TCP messages received by the server (Child Process).
  * @param  server: Server instance.
@@ -337,33 +983,10 @@ void processTCPChild(Server &server, RequestManager &manager, Address addr_from,
 		// Close parent listening socket
 		close(server._tcp_socket_fd);
 
-		// Set timeout for read and write in the socket
-		struct timeval read_timeout;
-		read_timeout.tv_sec = TCP_READ_TIMEOUT_SECONDS;
-		read_timeout.tv_usec = 0;
-		if (setsockopt(connection_fd, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
-		               sizeof(read_timeout)) < 0) {
-			throw UnrecoverableException(
-				"[TCP] Failed to set TCP read timeout socket option");
-		}
-		struct timeval write_timeout;
-		write_timeout.tv_sec = TCP_WRITE_TIMEOUT_SECONDS;
-		write_timeout.tv_usec = 0;
-		if (setsockopt(connection_fd, SOL_SOCKET, SO_SNDTIMEO, &write_timeout,
-		               sizeof(write_timeout)) < 0) {
-			throw UnrecoverableException(
-				"[TCP] Failed to set TCP write timeout socket option");
-		}
-
-		// Set up adapter
-		addr_from.socket = connection_fd;
-		TcpMessage message(connection_fd);
-
-		// Call handler
-		manager.callHandlerRequest(message, server, addr_from, TCP_MESSAGE);
+		serve_tcp_connection(server, manager, addr_from, connection_fd);
 		close(connection_fd);
 
-		// Exit child process
+		// Exit child process, the parent counts it out once it reaps it
 		exit(EXIT_SUCCESS);
 	} catch (std::exception &e) {
 		printError("Handling tcp request. Child process exiting.");
@@ -378,12 +1001,28 @@ void processTCPChild(Server &server, RequestManager &manager, Address addr_from,
  * @retval None
  */
 void processTCP(Server &server, RequestManager &manager) {
-	if (listen(server._tcp_socket_fd, TCP_MAX_QUEUE_SIZE) < 0) {
+	if (server._tcp_workers > 0) {
+		processTCPPool(server, manager);
+		return;
+	}
+
+	if (listen(server._tcp_socket_fd, server._tcp_queue_size) < 0) {
 		perror("Error while executing listen");
 		return;
 	}
+
+	if (server._tcp_engine != TCP_ENGINE_FORK) {
+		std::cout << "[TCP] Started TCP server ("
+				  << (server._tcp_engine == TCP_ENGINE_URING ? "uring" : "epoll")
+				  << ")." << std::endl;
+		runTCPEngine(server, manager);
+		return;
+	}
 	std::cout << "[TCP] Started TCP server." << std::endl;
 
+	// The children are reaped here, so they are counted out however they exit
+	signal(SIGCHLD, SIG_DFL);
+
 	uint32_t ex_trial = 0;
 	while (true) {
 		try {
@@ -405,6 +1044,195 @@ void processTCP(Server &server, RequestManager &manager) {
 	}
 }
 
+/**
+ * @brief  Starts the TCP worker pool and supervises it (Parent Process). The
+ * workers are started once and serve connections until the server shuts down.
+ * A worker that exits is started again.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @retval None
+ */
+void processTCPPool(Server &server, RequestManager &manager) {
+	// The workers are waited for, so they can't be reaped automatically
+	signal(SIGCHLD, SIG_DFL);
+
+	// Every worker opens its own listening socket
+	close(server._tcp_socket_fd);
+	server._tcp_socket_fd = -1;
+
+	std::vector<pid_t> workers;
+	std::vector<time_t> started;
+	for (int i = 0; i < server._tcp_workers; i++) {
+		workers.push_back(spawnTCPWorker(server, manager, i));
+		started.push_back(time(NULL));
+	}
+	std::cout << "[TCP] Started " << server._tcp_workers << " TCP workers ("
+			  << (server._tcp_engine == TCP_ENGINE_FORK    ? "fork"
+	              : server._tcp_engine == TCP_ENGINE_URING ? "uring"
+	                                                       : "epoll")
+			  << ")." << std::endl;
+
+	uint32_t ex_trial = 0;
+	while (!sig_int) {
+		pid_t pid = wait(NULL);
+		if (pid == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Error while waiting for TCP workers");
+			exit(EXIT_FAILURE);
+		}
+
+		auto worker = std::find(workers.begin(), workers.end(), pid);
+		if (worker == workers.end() || sig_int) {
+			continue;
+		}
+		size_t id = static_cast<size_t>(worker - workers.begin());
+
+		// A worker that can't stay up is not restarted forever
+		ex_trial = time(NULL) - started[id] < 1 ? ex_trial + 1 : 0;
+		if (ex_trial >= EXCEPTION_RETRY_MAX) {
+			std::cerr << "[TCP] Max trials reached, shutting down..."
+					  << std::endl;
+			for (pid_t other : workers) {
+				kill(other, SIGINT);
+			}
+			exit(EXIT_FAILURE);
+		}
+
+		std::cerr << "[TCP] Worker " << id << " exited. Restarting..."
+				  << std::endl;
+		*worker = spawnTCPWorker(server, manager, static_cast<int>(id));
+		started[id] = time(NULL);
+	}
+
+	// Pass SIGINT on to the workers and wait for them to shut down
+	for (pid_t worker : workers) {
+		kill(worker, SIGINT);
+	}
+	for (pid_t worker : workers) {
+		while (waitpid(worker, NULL, 0) == -1 && errno == EINTR) {
+		}
+	}
+	terminate(server, TCP_MESSAGE);
+}
+
+/**
+ * @brief  Forks a new TCP worker.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  worker_id: Index of the worker in the pool.
+ * @throws UnrecoverableException
+ * @retval Process id of the worker.
+ */
+pid_t spawnTCPWorker(Server &server, RequestManager &manager, int worker_id) {
+	pid_t pid = fork();
+	if (pid < 0) {
+		throw UnrecoverableException(
+			"[ERROR] Failed to fork process. Couldn't start TCP worker.");
+	} else if (pid == 0) {
+		processTCPWorker(server, manager, worker_id);
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+/**
+ * @brief  Serves TCP connections in a long lived worker (Worker Process). With
+ * the epoll or uring engines the worker runs its own event loop, otherwise it
+ * serves one connection at a time in this process instead of forking.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  worker_id: Index of the worker in the pool.
+ * @retval None
+ */
+void processTCPWorker(Server &server, RequestManager &manager, int worker_id) {
+	try {
+		server.openWorkerTcpSocket();
+	} catch (UnrecoverableException &e) {
+		std::cerr << "[TCP] Worker " << worker_id << ": " << e.what()
+				  << std::endl;
+		return;
+	}
+
+	if (server._tcp_engine != TCP_ENGINE_FORK) {
+		runTCPEngine(server, manager);
+		return;
+	}
+
+	uint32_t ex_trial = 0;
+	while (true) {
+		try {
+			serve_next_tcp_connection(server, manager);
+			ex_trial = 0;
+		} catch (std::exception &e) {
+			std::cerr << "[TCP] Worker " << worker_id
+					  << " encountered unrecoverable error. Retrying..."
+					  << std::endl
+					  << e.what() << std::endl;
+			ex_trial++;
+		}
+		if (ex_trial >= EXCEPTION_RETRY_MAX) {
+			std::cerr << "[TCP] Worker " << worker_id
+					  << ": max trials reached, exiting..." << std::endl;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief  Runs the event loop of the TCP engine selected. If the kernel doesn't
+ * support io_uring the epoll engine is used instead.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @retval None
+ */
+void runTCPEngine(Server &server, RequestManager &manager) {
+	server.startExecutor();
+	if (server._tcp_engine == TCP_ENGINE_URING) {
+		std::unique_ptr<TcpUringLoop> uring_loop;
+		try {
+			uring_loop = std::make_unique<TcpUringLoop>(server, manager);
+		} catch (UnrecoverableException &e) {
+			std::cerr << e.what() << ", falling back to epoll." << std::endl;
+			server._tcp_engine = TCP_ENGINE_EPOLL;
+		}
+		if (uring_loop) {
+			uring_loop->run();
+			return;
+		}
+	}
+
+	TcpEventLoop loop(server, manager);
+	loop.run();
+}
+
+/**
+ * @brief  Prints the requests refused by the TCP processes every
+ * _stats_interval seconds (Stats Process). The TCP parent process is busy
+ * serving or waiting for its workers, so the counters are read from their
+ * shared mapping by a process of its own, which stops with the server or once
+ * the TCP parent process is gone.
+ * @param  server: Server instance.
+ * @retval None
+ */
+void processTCPStats(Server &server) {
+	close(server._tcp_socket_fd);
+	close(server._udp_socket_fd);
+
+	pid_t parent = getppid();
+	while (getppid() == parent) {
+		sleep(static_cast<unsigned int>(server._stats_interval));
+		if (sig_int) {
+			break;
+		}
+		printTcpStats(
+			server._stats->tcp.shed.load(std::memory_order_relaxed),
+			server._stats->tcp.limited.load(std::memory_order_relaxed));
+	}
+	exit(EXIT_SUCCESS);
+}
+
 // -------------------------------------
 // | Wait for TCP and UDP messages.	   |
 // -------------------------------------
@@ -417,27 +1245,42 @@ void processTCP(Server &server, RequestManager &manager) {
  */
 void wait_for_udp_message(Server &server, RequestManager &manager) {
 	Address addr_from;
-	std::stringstream stream;
 	char buffer[UDP_SOCKET_BUFFER_LEN];
+	char control[UDP_CONTROL_LEN];
 
-	addr_from.size = sizeof(addr_from.addr);
-	ssize_t n = recvfrom(server._udp_socket_fd, buffer, SOCKET_BUFFER_LEN, 0,
-	                     (struct sockaddr *) &addr_from.addr, &addr_from.size);
+	struct iovec iov;
+	iov.iov_base = buffer;
+	iov.iov_len = UDP_SOCKET_BUFFER_LEN;
+	struct msghdr header;
+	memset(&header, 0, sizeof(header));
+	header.msg_name = &addr_from.addr;
+	header.msg_namelen = sizeof(addr_from.addr);
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+	header.msg_control = control;
+	header.msg_controllen = UDP_CONTROL_LEN;
+	ssize_t n = recvmsg(server._udp_socket_fd, &header, 0);
 	if (n == -1) {
 		if (sig_int) {
 			terminate(server, UDP_MESSAGE);
 		}
-		throw UnrecoverableException(
-			"Failed to receive UDP message (recvfrom)");
+		throw UnrecoverableException("Failed to receive UDP message (recvmsg)");
 	}
-	stream.write(buffer, n);
+	addr_from.size = header.msg_namelen;
 
-	// Set up adapter
+	// The client gave up and retransmitted, the copy it waits for is behind
+	if (is_stale_udp_request(header, server._udp_deadline_ms)) {
+		count_stale(server._stats->udp[server._udp_worker_id]);
+		return;
+	}
+
+	// Set up adapter, the datagram is read in place
 	addr_from.socket = server._udp_socket_fd;
-	StreamMessage message(stream);
+	BufferMessage message(buffer, static_cast<size_t>(n));
 
 	// Call handler
 	manager.callHandlerRequest(message, server, addr_from, UDP_MESSAGE);
+	count_request(server._stats->udp[server._udp_worker_id]);
 	return;
 }
 
@@ -449,36 +1292,31 @@ void wait_for_udp_message(Server &server, RequestManager &manager) {
  */
 void wait_for_tcp_message(Server &server, RequestManager &manager) {
 	Address addr_from;
-
-	addr_from.size = sizeof(addr_from.addr);
-	int connection_fd =
-		accept(server._tcp_socket_fd, (struct sockaddr *) &addr_from.addr,
-	           &addr_from.size);
+	int connection_fd = accept_tcp_connection(server, addr_from);
 	if (connection_fd < 0) {
-		if (sig_int) {
-			terminate(server, TCP_MESSAGE);
-		}
-		if (errno == EAGAIN) {  // timeout, just go around and keep listening
-			return;
-		}
-		throw UnrecoverableException("[ERROR] Failed to accept a connection");
+		return;
 	}
 
-	// Received message
-	// Set timeout for read and write in the accepted socket
-	struct timeval read_timeout;
-	read_timeout.tv_sec = TCP_READ_TIMEOUT_SECONDS;
-	read_timeout.tv_usec = 0;
-	if (setsockopt(connection_fd, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
-	               sizeof(read_timeout)) < 0) {
-		throw UnrecoverableException(
-			"Failed to set TCP read timeout socket option");
+	// The children inherit the depth, so they shed by type while the parent
+	// only refuses connections once the queue is full, without forking.
+	reap_tcp_children(server);
+	server._admission.setDepth(
+		server._stats->tcp_children.load(std::memory_order_relaxed));
+	if (!server._admission.admit(pack_protocol_code(CODE_ERROR))) {
+		refuse_tcp_connection(server, connection_fd);
+		count_shed(server._stats->tcp);
+		return;
+	}
+	if (!admit_tcp_connection(server, addr_from, connection_fd)) {
+		return;
 	}
 
 	try {
 		// Delegate connection to child process
+		server._stats->tcp_children.fetch_add(1, std::memory_order_relaxed);
 		pid_t pid = fork();
 		if (pid < 0) {
+			server._stats->tcp_children.fetch_sub(1, std::memory_order_relaxed);
 			throw UnrecoverableException(
 				"[ERROR] Failed to fork process. Couldn't delegate TCP "
 				"connection to worker process.");
@@ -487,6 +1325,7 @@ void wait_for_tcp_message(Server &server, RequestManager &manager) {
 			processTCPChild(server, manager, addr_from, connection_fd);
 		} else {
 			// Parent process
+			server._tcp_children.insert(pid);
 			close(connection_fd);
 		}
 	} catch (std::exception &e) {
@@ -497,6 +1336,190 @@ void wait_for_tcp_message(Server &server, RequestManager &manager) {
 	}
 }
 
+/**
+ * @brief  Reaps the children of the fork engine that exited, however they
+ * exited (killed by a signal included), and counts them out of the children
+ * running.
+ * @param  server: Server instance.
+ * @retval None
+ */
+void reap_tcp_children(Server &server) {
+	pid_t pid;
+	while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+		// The UDP process is a child too
+		if (server._tcp_children.erase(pid) > 0) {
+			server._stats->tcp_children.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * @brief  Accepts a connection on the TCP listening socket.
+ * @param  server: Server instance.
+ * @param  addr_from: Filled with the address of the client.
+ * @throws UnrecoverableException
+ * @retval File descriptor of the connection.
+ * @retval -1 if no connection was accepted (timeout).
+ */
+int accept_tcp_connection(Server &server, Address &addr_from) {
+	addr_from.size = sizeof(addr_from.addr);
+	int connection_fd =
+		accept(server._tcp_socket_fd, (struct sockaddr *) &addr_from.addr,
+	           &addr_from.size);
+	if (connection_fd < 0) {
+		if (sig_int) {
+			terminate(server, TCP_MESSAGE);
+		}
+		if (errno == EAGAIN) {  // timeout, just go around and keep listening
+			return -1;
+		}
+		throw UnrecoverableException("[ERROR] Failed to accept a connection");
+	}
+	return connection_fd;
+}
+
+/**
+ * @brief  Checks a new connection against the connection rate limit of its
+ * client (-r TCP:<rate>), refusing it if it is over.
+ * @param  server: Server instance.
+ * @param  addr_from: Address of the client.
+ * @param  connection_fd: File descriptor of the connection.
+ * @retval true if the connection should be served.
+ * @retval false if it was refused and closed.
+ */
+bool admit_tcp_connection(Server &server, Address &addr_from,
+                          int connection_fd) {
+	if (server._rate_limiter == NULL ||
+	    server._rate_limiter->allow(
+			addr_from.addr.sin_addr.s_addr,
+			pack_protocol_code(RATE_LIMIT_CONNECTION_CODE))) {
+		return true;
+	}
+	refuse_tcp_connection(server, connection_fd);
+	count_limited(server._stats->tcp);
+	return false;
+}
+
+/**
+ * @brief  Answers ERR on a connection that won't be served and closes it.
+ * @param  server: Server instance.
+ * @param  connection_fd: File descriptor of the connection.
+ * @retval None
+ */
+void refuse_tcp_connection(Server &server, int connection_fd) {
+	// Drop what already arrived, closing with unread bytes would reset the
+	// connection before the client reads the answer
+	char buffer[SOCKET_BUFFER_LEN];
+	while (recv(connection_fd, buffer, SOCKET_BUFFER_LEN, MSG_DONTWAIT) > 0) {
+	}
+	ServerError error;
+	try {
+		send_tcp_message(error, connection_fd, server._verbose);
+	} catch (MessageSendException &e) {
+		// The client is gone already
+	}
+	close(connection_fd);
+}
+
+/**
+ * @brief  Connections waiting to be accepted on a listening socket.
+ * @param  socket_fd: Listening socket.
+ * @retval Length of the accept queue, 0 if it can't be read.
+ */
+size_t tcp_accept_backlog(int socket_fd) {
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	memset(&info, 0, sizeof(info));
+	// For a listening socket the kernel reports its accept queue as unacked
+	if (getsockopt(socket_fd, IPPROTO_TCP, TCP_INFO, &info, &len) == -1) {
+		return 0;
+	}
+	return info.tcpi_unacked;
+}
+
+/**
+ * @brief  Handles the request received in a TCP connection. If the client
+ * opened a session, the next requests are read from the same connection and
+ * answered in order until the client closes it or stays idle past the read
+ * timeout. The connection is not closed.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  addr_from: Address of the client.
+ * @param  connection_fd: File descriptor of the connection.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void serve_tcp_connection(Server &server, RequestManager &manager,
+                          Address &addr_from, int connection_fd) {
+	// Set timeout for read and write in the socket
+	struct timeval read_timeout;
+	read_timeout.tv_sec = TCP_READ_TIMEOUT_SECONDS;
+	read_timeout.tv_usec = 0;
+	if (setsockopt(connection_fd, SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+	               sizeof(read_timeout)) < 0) {
+		throw UnrecoverableException(
+			"[TCP] Failed to set TCP read timeout socket option");
+	}
+	struct timeval write_timeout;
+	write_timeout.tv_sec = TCP_WRITE_TIMEOUT_SECONDS;
+	write_timeout.tv_usec = 0;
+	if (setsockopt(connection_fd, SOL_SOCKET, SO_SNDTIMEO, &write_timeout,
+	               sizeof(write_timeout)) < 0) {
+		throw UnrecoverableException(
+			"[TCP] Failed to set TCP write timeout socket option");
+	}
+
+	// Set up adapter
+	addr_from.socket = connection_fd;
+	TcpMessage message(connection_fd);
+
+	// Call handler
+	manager.callHandlerRequest(message, server, addr_from, TCP_MESSAGE);
+
+	while (addr_from.session) {
+		message.skipMessage();
+		if (message.closed()) {
+			break;
+		}
+		addr_from.answered = false;
+		manager.callHandlerRequest(message, server, addr_from, TCP_MESSAGE);
+		if (!addr_from.answered) {
+			// Every request gets an answer so that the next ones stay in order
+			ServerError error;
+			server.sendTcpMessage(error, addr_from);
+		}
+	}
+}
+
+/**
+ * @brief  Accepts the next TCP connection and handles it in this process (TCP
+ * workers). A request that fails only closes its connection.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void serve_next_tcp_connection(Server &server, RequestManager &manager) {
+	Address addr_from;
+	int connection_fd = accept_tcp_connection(server, addr_from);
+	if (connection_fd < 0) {
+		return;
+	}
+	if (server._admission.enabled()) {
+		server._admission.setDepth(tcp_accept_backlog(server._tcp_socket_fd));
+	}
+	if (!admit_tcp_connection(server, addr_from, connection_fd)) {
+		return;
+	}
+
+	try {
+		serve_tcp_connection(server, manager, addr_from, connection_fd);
+	} catch (std::exception &e) {
+		printError("Handling tcp request. Closing connection.");
+	}
+	close(connection_fd);
+}
+
 // -------------------------------------
 // | Main							   |
 // -------------------------------------
@@ -504,7 +1527,16 @@ void wait_for_tcp_message(Server &server, RequestManager &manager) {
 int main(int argc, char *argv[]) {
 	Server server(argc, argv);
 	RequestManager requestManager;
-	requestManager.registerRequestHandlers();
+
+	if (server._stats_interval > 0) {
+		pid_t s_pid = fork();
+		if (s_pid == 0) {
+			processTCPStats(server);
+		} else if (s_pid == -1) {
+			std::cerr << "[ERROR] Failed to fork process." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	pid_t c_pid = fork();
 	if (c_pid == 0) {
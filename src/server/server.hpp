@@ -3,14 +3,29 @@
 
 #include <netdb.h>
 
-#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <unordered_set>
 
+#include "admission.hpp"
 #include "database.hpp"
+#include "executor.hpp"
+#include "rate_limit.hpp"
+#include "stats.hpp"
 #include "shared/protocol.hpp"
 #include "shared/utils.hpp"
 
 #define EXCEPTION_RETRY_MAX 5
 
+// TCP engines selectable with -e
+#define TCP_ENGINE_FORK  0
+#define TCP_ENGINE_EPOLL 1
+#define TCP_ENGINE_URING 2
+
+// Database backends selectable with -D
+#define DATABASE_ASDIR 0
+#define DATABASE_WAL   1
+
 // -----------------------------------
 // | Exceptions				 		 |
 // -----------------------------------
@@ -24,11 +39,46 @@ class UnrecoverableException : public std::runtime_error {
 // | Server and Adress.				   |
 // -------------------------------------
 
+/**
+ * @brief  File sent as part of a TCP answer queued by the event loop, written
+ * straight from the file once the answers queued before it are written.
+ */
+class ReplyFile {
+   public:
+	size_t at;     // Position in the answers queued where the file goes
+	int fd;        // Closed once sent or when the connection closes
+	off_t offset;  // Next byte of the file to send
+	size_t size;   // Bytes of the file left to send
+};
+
+/**
+ * @brief  Asset of an OPA request received by the event loop, written to a
+ * staged file as it arrives instead of being kept with the request.
+ */
+class AssetUpload {
+   public:
+	int fd = -1;         // Staged file, closed once the asset is received
+	std::string path;    // Empty if the asset is dropped or was taken
+	std::string header;  // The request up to the asset
+	size_t left = 0;     // Bytes of the asset still to receive
+};
+
 class Address {
    public:
 	int socket;
 	struct sockaddr_in addr;
 	socklen_t size;
+	// When set, answers are queued here instead of being written to the socket
+	// (the event loop or the UDP batch flushes them later).
+	std::string* reply = NULL;
+	// With reply, files sent in between the answers queued (TCP only)
+	std::deque<ReplyFile>* files = NULL;
+	// Set when the asset of the OPA request was already received to disk
+	AssetUpload* upload = NULL;
+	// Set by an Open Session request, the connection then serves more requests
+	bool session = false;
+	// Whether an answer was sent for the request being handled
+	bool answered = false;
 };
 
 class Server {
@@ -44,6 +94,8 @@ class Server {
 	void closeTcpSocket();
 	void setupSignalHandlers();
 	void configServer(int argc, char* argv[]);
+	int configAdmission(std::string option);
+	int configRateLimit(std::string option);
 	void setup_sockets();
 	void resolveServerAddress(std::string& port);
 
@@ -52,40 +104,48 @@ class Server {
 	int _tcp_socket_fd = -1;
 	struct addrinfo* _server_udp_addr = NULL;
 	struct addrinfo* _server_tcp_addr = NULL;
-	Database _database;
+	std::unique_ptr<Database> _database;
+	int _database_backend = DATABASE_ASDIR;
 	bool _verbose = false;
+	int _tcp_engine = TCP_ENGINE_EPOLL;
+	int _tcp_workers = 0;  // 0 means no pool, a single TCP process
+	int _tcp_queue_size = TCP_MAX_QUEUE_SIZE;
+	int _udp_workers = 0;  // 0 means no pool, a single UDP process
+	int _udp_worker_id = 0;
+	int _udp_batch = UDP_DEFAULT_BATCH;  // 1 receives one message at a time
+	int _udp_deadline_ms = UDP_DEFAULT_DEADLINE_MS;  // Older requests dropped
+	int _stats_interval = 0;  // Seconds between stats reports, 0 disables them
+	ServerStats* _stats = NULL;
+	int _executor_threads = 0;  // 0 runs the handlers on the I/O thread
+	std::unique_ptr<Executor> _executor;
+	AdmissionControl _admission;  // Watermarks set with -a
+	RateLimiter* _rate_limiter = NULL;  // Shared by every process, with -r
+	std::unordered_set<pid_t> _tcp_children;  // Running, with -e fork
 	Server(int argc, char* argv[]);
 	~Server();
 	void sendUdpMessage(ProtocolMessage& out_message, Address& addr_from);
-	void sendTcpMessage();
+	void sendTcpMessage(ProtocolMessage& out_message, Address& addr_to);
+	void sendTcpFile(const std::string& header, int file_fd, size_t file_size,
+	                 Address& addr_to);
+	void openWorkerTcpSocket();
+	int openWorkerUdpSocket();
+	void startExecutor();
+	WorkerStats& workerStats(int type);
 };
 
 // -------------------------------------
 // | Request Handler and Manager.	   |
 // -------------------------------------
 
-class RequestHandler {
-   protected:
-	RequestHandler(const char* protocol_code) : _protocol_code{protocol_code} {}
-
-   public:
-	const char* _protocol_code;
-	virtual void handle(MessageAdapter& message, Server& server,
-	                    Address& address) = 0;
-};
-
+/**
+ * @brief  Routes each request to its handler. Codes are packed in an integer
+ * and switched on, the handlers are called directly.
+ */
 class RequestManager {
-   private:
-	std::unordered_map<std::string, std::shared_ptr<RequestHandler>>
-		_udp_handlers;
-	std::unordered_map<std::string, std::shared_ptr<RequestHandler>>
-		_tcp_handlers;
-
    public:
-	void registerRequestHandlers();
-	void registerRequest(std::shared_ptr<RequestHandler> handler, int type);
 	void callHandlerRequest(MessageAdapter& message, Server& client,
 	                        Address& address, int type);
+	void refuseRequest(Server& server, Address& address, int type);
 };
 
 // -------------------------------------
@@ -93,9 +153,18 @@ class RequestManager {
 // -------------------------------------
 
 void processUDP(Server& server, RequestManager& manager);
+void serveUDP(Server& server, RequestManager& manager);
+void processUDPPool(Server& server, RequestManager& manager);
+pid_t spawnUDPWorker(Server& server, RequestManager& manager, int worker_id,
+                     int socket_fd);
 void processTCPChild(Server& server, RequestManager& manager, Address addr_from,
                      int connection_fd);
 void processTCP(Server& server, RequestManager& manager);
+void processTCPPool(Server& server, RequestManager& manager);
+pid_t spawnTCPWorker(Server& server, RequestManager& manager, int worker_id);
+void processTCPWorker(Server& server, RequestManager& manager, int worker_id);
+void runTCPEngine(Server& server, RequestManager& manager);
+void processTCPStats(Server& server);
 
 // -------------------------------------
 // | Wait for TCP and UDP messages.	   |
@@ -103,11 +172,22 @@ void processTCP(Server& server, RequestManager& manager);
 
 void wait_for_udp_message(Server& server, RequestManager& manager);
 void wait_for_tcp_message(Server& server, RequestManager& manager);
+void reap_tcp_children(Server& server);
+int accept_tcp_connection(Server& server, Address& addr_from);
+size_t tcp_accept_backlog(int socket_fd);
+bool admit_tcp_connection(Server& server, Address& addr_from,
+                          int connection_fd);
+void refuse_tcp_connection(Server& server, int connection_fd);
+void serve_tcp_connection(Server& server, RequestManager& manager,
+                          Address& addr_from, int connection_fd);
+void serve_next_tcp_connection(Server& server, RequestManager& manager);
 
 // -------------------------------------
 // | Signals and termination handling. |
 // -------------------------------------
 
+extern bool sig_int;
+
 void sig_int_handler(int sig);
 void terminate(Server& server, int process);
 
@@ -0,0 +1,73 @@
+/**
+ * @file stats.cpp
+ * @brief Implementation of the counters shared by the server processes.
+ */
+#include "stats.hpp"
+
+#include <sys/mman.h>
+
+#include <new>
+
+#include "server.hpp"
+
+/**
+ * @brief  Maps the shared counters. Must be called before forking so every
+ * process sees the same mapping.
+ * @throws UnrecoverableException
+ * @retval The zeroed counters.
+ */
+ServerStats *create_server_stats() {
+	void *mapping = mmap(NULL, sizeof(ServerStats), PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw UnrecoverableException("[ERROR] Failed to map server stats");
+	}
+	return new (mapping) ServerStats();
+}
+
+/**
+ * @brief  Unmaps the shared counters from this process.
+ * @param  stats: Counters returned by create_server_stats.
+ * @retval None
+ */
+void destroy_server_stats(ServerStats *stats) {
+	if (stats != NULL) {
+		munmap(stats, sizeof(ServerStats));
+	}
+}
+
+/**
+ * @brief  Counts a request handled by a worker.
+ * @param  &worker: Counters of the worker.
+ * @retval None
+ */
+void count_request(WorkerStats &worker) {
+	worker.requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Counts a request shed by admission control.
+ * @param  &worker: Counters of the worker.
+ * @retval None
+ */
+void count_shed(WorkerStats &worker) {
+	worker.shed.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Counts a request dropped because it waited past the deadline.
+ * @param  &worker: Counters of the worker.
+ * @retval None
+ */
+void count_stale(WorkerStats &worker) {
+	worker.stale.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Counts a request or connection refused by a rate limit.
+ * @param  &worker: Counters of the worker.
+ * @retval None
+ */
+void count_limited(WorkerStats &worker) {
+	worker.limited.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,45 @@
+#ifndef __STATS__
+#define __STATS__
+
+/**
+ * @file stats.hpp
+ * @brief Declaration of the counters shared by the server processes. They are
+ * kept in an anonymous shared mapping created before forking, so each worker
+ * updates its own slot and the supervisor reads all of them.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+#include "shared/config.hpp"
+
+/**
+ * @brief  Counters of a single worker. Only the worker writes to them, except
+ * the TCP ones which every TCP process adds to.
+ */
+class WorkerStats {
+   public:
+	std::atomic<uint64_t> requests{0};
+	std::atomic<uint64_t> shed{0};  // Answered with ERR by admission control
+	std::atomic<uint64_t> stale{0};  // Dropped after waiting past the deadline
+	std::atomic<uint64_t> limited{0};  // Answered with ERR over a rate limit
+};
+
+/**
+ * @brief  Counters of every worker of the server.
+ */
+class ServerStats {
+   public:
+	WorkerStats udp[UDP_MAX_WORKERS];
+	WorkerStats tcp;  // Shared by every TCP process
+	std::atomic<uint32_t> tcp_children{0};  // Fork engine children running
+};
+
+ServerStats *create_server_stats();
+void destroy_server_stats(ServerStats *stats);
+void count_request(WorkerStats &worker);
+void count_shed(WorkerStats &worker);
+void count_stale(WorkerStats &worker);
+void count_limited(WorkerStats &worker);
+
+#endif
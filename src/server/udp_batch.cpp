@@ -0,0 +1,230 @@
+/**
+ * @file udp_batch.cpp
+ * @brief Implementation of the batched UDP path.
+ */
+#include "udp_batch.hpp"
+
+#include <string.h>
+#include <time.h>
+
+#include <iostream>
+
+/**
+ * @brief  Allocates the buffers for a batch.
+ * @param  capacity: Max number of datagrams received at once.
+ */
+UdpBatch::UdpBatch(size_t capacity)
+	: _capacity(capacity),
+	  _buffers(capacity * UDP_SOCKET_BUFFER_LEN),
+	  _controls(capacity * UDP_CONTROL_LEN),
+	  _iovecs(capacity),
+	  _messages(capacity),
+	  _addresses(capacity),
+	  _replies(capacity) {}
+
+/**
+ * @brief  Receives the datagrams waiting in the socket, blocking until there
+ * is at least one.
+ * @param  socket_fd: UDP socket.
+ * @retval Number of datagrams received.
+ * @retval -1 on error (errno is set).
+ */
+int UdpBatch::receive(int socket_fd) {
+	for (size_t i = 0; i < _capacity; i++) {
+		_iovecs[i].iov_base = &_buffers[i * UDP_SOCKET_BUFFER_LEN];
+		_iovecs[i].iov_len = UDP_SOCKET_BUFFER_LEN;
+		memset(&_messages[i], 0, sizeof(struct mmsghdr));
+		_messages[i].msg_hdr.msg_iov = &_iovecs[i];
+		_messages[i].msg_hdr.msg_iovlen = 1;
+		_messages[i].msg_hdr.msg_name = &_addresses[i].addr;
+		_messages[i].msg_hdr.msg_namelen = sizeof(_addresses[i].addr);
+		_messages[i].msg_hdr.msg_control = &_controls[i * UDP_CONTROL_LEN];
+		_messages[i].msg_hdr.msg_controllen = UDP_CONTROL_LEN;
+	}
+
+	int n = recvmmsg(socket_fd, _messages.data(),
+	                 static_cast<unsigned int>(_capacity), MSG_WAITFORONE,
+	                 NULL);
+	_size = n > 0 ? static_cast<size_t>(n) : 0;
+	return n;
+}
+
+/**
+ * @brief  Handles every datagram of the batch. The answers are queued in the
+ * batch instead of being sent. A datagram that fails doesn't stop the others.
+ * With handler threads (-x) the datagrams are handled in parallel and this
+ * returns once all of them are.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @retval None
+ */
+void UdpBatch::handle(Server &server, RequestManager &manager) {
+	if (server._executor != nullptr && _size > 1) {
+		server._executor->forEach(
+			_size, [this, &server, &manager](size_t i) {
+				handleMessage(server, manager, i);
+			});
+		return;
+	}
+	for (size_t i = 0; i < _size; i++) {
+		handleMessage(server, manager, i);
+	}
+}
+
+/**
+ * @brief  Handles a datagram of the batch, queueing its answer.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  i: Index of the datagram in the batch.
+ * @retval None
+ */
+void UdpBatch::handleMessage(Server &server, RequestManager &manager,
+                             size_t i) {
+	Address &addr_from = _addresses[i];
+	addr_from.size = _messages[i].msg_hdr.msg_namelen;
+	addr_from.socket = server._udp_socket_fd;
+	addr_from.reply = &_replies[i];
+	_replies[i].clear();
+
+	// The client gave up and retransmitted, the copy it waits for is behind
+	if (is_stale_udp_request(_messages[i].msg_hdr, server._udp_deadline_ms)) {
+		count_stale(server._stats->udp[server._udp_worker_id]);
+		return;
+	}
+
+	// Set up adapter, the datagram is read in place
+	BufferMessage message(static_cast<char *>(_iovecs[i].iov_base),
+	                      _messages[i].msg_len);
+
+	// Call handler
+	try {
+		manager.callHandlerRequest(message, server, addr_from, UDP_MESSAGE);
+	} catch (std::exception &e) {
+		std::cerr << "[UDP] Exception: " << e.what() << std::endl;
+	}
+	count_request(server._stats->udp[server._udp_worker_id]);
+}
+
+/**
+ * @brief  Sends the answers queued while handling the batch.
+ * @param  socket_fd: UDP socket.
+ * @retval None
+ */
+void UdpBatch::flush(int socket_fd) {
+	size_t count = 0;
+	for (size_t i = 0; i < _size; i++) {
+		if (_replies[i].empty()) {
+			continue;
+		}
+		// Reuse the receive headers, the datagram has been handled already
+		_iovecs[count].iov_base = _replies[i].data();
+		_iovecs[count].iov_len = _replies[i].size();
+		memset(&_messages[count], 0, sizeof(struct mmsghdr));
+		_messages[count].msg_hdr.msg_iov = &_iovecs[count];
+		_messages[count].msg_hdr.msg_iovlen = 1;
+		_messages[count].msg_hdr.msg_name = &_addresses[i].addr;
+		_messages[count].msg_hdr.msg_namelen = _addresses[i].size;
+		count++;
+	}
+
+	size_t sent = 0;
+	while (sent < count) {
+		int n = sendmmsg(socket_fd, &_messages[sent],
+		                 static_cast<unsigned int>(count - sent), 0);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// Skip the answer that failed so the rest still goes out
+			std::cerr << "[UDP] Failed to send answer (sendmmsg)."
+					  << std::endl;
+			sent++;
+			continue;
+		}
+		sent += static_cast<size_t>(n);
+	}
+	_size = 0;
+}
+
+/**
+ * @brief  Makes the kernel stamp every datagram received in a socket with the
+ * time it arrived. Without it no request is considered stale.
+ * @param  socket_fd: UDP socket.
+ * @retval None
+ */
+void enable_udp_timestamps(int socket_fd) {
+	const int enable = 1;
+	if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable,
+	               sizeof(int)) < 0) {
+		std::cerr << "[UDP] Failed to enable receive timestamps, stale "
+					 "requests won't be dropped."
+				  << std::endl;
+	}
+}
+
+/**
+ * @brief  Checks whether a datagram waited in the server longer than the
+ * deadline, using the arrival time stamped by the kernel.
+ * @param  &header: Header the datagram was received with.
+ * @param  deadline_ms: Longest wait in milliseconds.
+ * @retval true if the request should be dropped.
+ */
+bool is_stale_udp_request(struct msghdr &header, int deadline_ms) {
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&header, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_TIMESTAMPNS) {
+			continue;
+		}
+		struct timespec arrival;
+		struct timespec now;
+		memcpy(&arrival, CMSG_DATA(cmsg), sizeof(arrival));
+		clock_gettime(CLOCK_REALTIME, &now);
+		int64_t waited_ms = (now.tv_sec - arrival.tv_sec) * 1000 +
+		                    (now.tv_nsec - arrival.tv_nsec) / 1000000;
+		return waited_ms > deadline_ms;
+	}
+	return false;
+}
+
+/**
+ * @brief  Waits for a batch of UDP messages, handles them and sends their
+ * answers. If the kernel doesn't support recvmmsg, the server goes back to
+ * receiving one message at a time.
+ * @param  server: Server instance.
+ * @param  manager: Request manager instance.
+ * @param  batch: Buffers of the batch.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void wait_for_udp_batch(Server &server, RequestManager &manager,
+                        UdpBatch &batch) {
+	int received = batch.receive(server._udp_socket_fd);
+	if (received == -1) {
+		if (sig_int) {
+			terminate(server, UDP_MESSAGE);
+		}
+		if (errno == EINTR) {
+			return;
+		}
+		if (errno == ENOSYS) {
+			std::cerr << "[UDP] Batching not supported, receiving one message "
+						 "at a time."
+					  << std::endl;
+			if (server._admission.enabled()) {
+				std::cerr << "[UDP] Requests received one at a time aren't "
+							 "shed by admission control (-a)."
+						  << std::endl;
+			}
+			server._udp_batch = 1;
+			return;
+		}
+		throw UnrecoverableException(
+			"Failed to receive UDP messages (recvmmsg)");
+	}
+
+	// Everything waiting was received, up to the bound of the queue
+	server._admission.setDepth(static_cast<size_t>(received));
+	batch.handle(server, manager);
+	batch.flush(server._udp_socket_fd);
+}
@@ -0,0 +1,51 @@
+#ifndef __UDP_BATCH__
+#define __UDP_BATCH__
+
+/**
+ * @file udp_batch.hpp
+ * @brief Declaration of the batched UDP path. Up to a batch of datagrams is
+ * received with a single recvmmsg, handled one after the other (or by the
+ * handler threads) and their answers are sent back with a single sendmmsg.
+ * Each datagram carries the time it arrived, so the ones that waited longer
+ * than the client does are dropped without being handled.
+ */
+
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+
+// Room for the arrival time of a datagram (SO_TIMESTAMPNS)
+#define UDP_CONTROL_LEN CMSG_SPACE(sizeof(struct timespec))
+
+/**
+ * @brief  Buffers of a batch of datagrams and of their answers. They are
+ * allocated once and reused for every batch.
+ */
+class UdpBatch {
+	size_t _capacity;
+	size_t _size = 0;  // Datagrams received in the current batch
+	std::vector<char> _buffers;
+	std::vector<char> _controls;
+	std::vector<struct iovec> _iovecs;
+	std::vector<struct mmsghdr> _messages;
+	std::vector<Address> _addresses;
+	std::vector<std::string> _replies;
+
+	void handleMessage(Server &server, RequestManager &manager, size_t i);
+
+   public:
+	UdpBatch(size_t capacity);
+	int receive(int socket_fd);
+	void handle(Server &server, RequestManager &manager);
+	void flush(int socket_fd);
+};
+
+void enable_udp_timestamps(int socket_fd);
+bool is_stale_udp_request(struct msghdr &header, int deadline_ms);
+void wait_for_udp_batch(Server &server, RequestManager &manager,
+                        UdpBatch &batch);
+
+#endif
@@ -0,0 +1,751 @@
+/**
+ * @file uring_loop.cpp
+ * @brief Implementation of the io_uring based TCP engine. The io_uring system
+ * calls are used directly, so no extra library is needed to build the server.
+ */
+#include "uring_loop.hpp"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "output.hpp"
+
+#define URING_WAIT_TIMEOUT_SECONDS 1
+
+/**
+ * @brief  Builds the user data of a request from its operation and the id of
+ * its connection.
+ * @param  op: Operation (URING_OP_*).
+ * @param  id: Connection id, 0 for the listening socket.
+ * @retval The user data.
+ */
+static uint64_t uring_user_data(int op, uint32_t id) {
+	return (static_cast<uint64_t>(id) << 8) | static_cast<uint64_t>(op);
+}
+
+// -------------------------------------
+// | Ring setup						   |
+// -------------------------------------
+
+/**
+ * @brief  Sets up the ring, the provided buffers and starts accepting
+ * connections.
+ * @param  &server: Server instance.
+ * @param  &manager: Request manager instance.
+ * @throws UnrecoverableException if the kernel doesn't support the io_uring
+ * features needed.
+ */
+TcpUringLoop::TcpUringLoop(Server &server, RequestManager &manager)
+	: _server(server), _manager(manager) {
+	try {
+		setupRing();
+		setupBuffers();
+	} catch (UnrecoverableException &e) {
+		release();
+		throw;
+	}
+	setAccepting(true);
+
+	if (_server._executor != nullptr) {
+		_completions = std::make_unique<CompletionQueue>();
+		armWake();
+	}
+}
+
+/**
+ * @brief  Closes every connection still open and the ring.
+ */
+TcpUringLoop::~TcpUringLoop() {
+	for (auto &entry : _connections) {
+		close(entry.second.fd);
+		close_reply_files(entry.second);
+		discard_tcp_asset(_server, entry.second);
+	}
+	release();
+}
+
+/**
+ * @brief  Creates the ring and maps its submission and completion queues.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpUringLoop::setupRing() {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_CQ_ENTRIES;
+
+	_ring_fd = static_cast<int>(
+		syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+	if (_ring_fd < 0) {
+		throw UnrecoverableException("[TCP] io_uring is not available");
+	}
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		throw UnrecoverableException("[TCP] io_uring is too old");
+	}
+
+	_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cq_ring_size = params.cq_off.cqes +
+	                params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		_sq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+		_cq_ring_size = _sq_ring_size;
+	}
+
+	_sq_ring = mmap(NULL, _sq_ring_size, PROT_READ | PROT_WRITE,
+	                MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+	if (_sq_ring == MAP_FAILED) {
+		_sq_ring = NULL;
+		throw UnrecoverableException("[TCP] Failed to map io_uring queue");
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		_cq_ring = _sq_ring;
+	} else {
+		_cq_ring = mmap(NULL, _cq_ring_size, PROT_READ | PROT_WRITE,
+		                MAP_SHARED | MAP_POPULATE, _ring_fd,
+		                IORING_OFF_CQ_RING);
+		if (_cq_ring == MAP_FAILED) {
+			_cq_ring = NULL;
+			throw UnrecoverableException(
+				"[TCP] Failed to map io_uring queue");
+		}
+	}
+
+	_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = mmap(NULL, _sqes_size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		throw UnrecoverableException("[TCP] Failed to map io_uring queue");
+	}
+	_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+	char *sq = static_cast<char *>(_sq_ring);
+	_sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+	_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+	_sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+	_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+	_sq_entries = params.sq_entries;
+
+	char *cq = static_cast<char *>(_cq_ring);
+	_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+	_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+	_cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+	_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+/**
+ * @brief  Provides the buffers the kernel fills when data arrives in a
+ * connection, so no buffer has to be kept aside for idle connections. The
+ * first provide is waited for to check the kernel supports it.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpUringLoop::setupBuffers() {
+	_buffers = new char[URING_BUFFER_COUNT * URING_BUFFER_LEN];
+
+	struct io_uring_sqe *sqe = getSqe(URING_OP_PROVIDE, 0);
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = URING_BUFFER_COUNT;
+	sqe->addr = reinterpret_cast<uint64_t>(_buffers);
+	sqe->len = URING_BUFFER_LEN;
+	sqe->off = 0;
+	sqe->buf_group = URING_BUFFER_GROUP;
+
+	long n = syscall(__NR_io_uring_enter, _ring_fd, _to_submit, 1,
+	                 IORING_ENTER_GETEVENTS, NULL, 0);
+	if (n != 1) {
+		throw UnrecoverableException("[TCP] Failed to provide io_uring buffers");
+	}
+	_to_submit = 0;
+
+	unsigned head = *_cq_head;
+	int32_t res = _cqes[head & *_cq_mask].res;
+	__atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+	if (res < 0) {
+		throw UnrecoverableException(
+			"[TCP] io_uring doesn't support provided buffers");
+	}
+}
+
+/**
+ * @brief  Unmaps the queues and buffers and closes the ring.
+ * @retval None
+ */
+void TcpUringLoop::release() {
+	if (_sqes != NULL) {
+		munmap(_sqes, _sqes_size);
+	}
+	if (_cq_ring != NULL && _cq_ring != _sq_ring) {
+		munmap(_cq_ring, _cq_ring_size);
+	}
+	if (_sq_ring != NULL) {
+		munmap(_sq_ring, _sq_ring_size);
+	}
+	delete[] _buffers;
+	if (_ring_fd != -1) {
+		close(_ring_fd);
+	}
+	_sqes = NULL;
+	_cq_ring = NULL;
+	_sq_ring = NULL;
+	_buffers = NULL;
+	_ring_fd = -1;
+}
+
+// -------------------------------------
+// | Submission and completion		   |
+// -------------------------------------
+
+/**
+ * @brief  Makes sure the submission queue has room for count requests,
+ * submitting the queued ones if it doesn't. Linked requests must be reserved
+ * together so they are submitted at once.
+ * @param  count: Number of requests about to be queued.
+ * @retval None
+ */
+void TcpUringLoop::reserveSqes(unsigned count) {
+	unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+	if (*_sq_tail - head + count > _sq_entries) {
+		submit(0);
+	}
+}
+
+/**
+ * @brief  Queues a new request. It is submitted on the next io_uring_enter.
+ * @param  op: Operation (URING_OP_*), returned in the completion.
+ * @param  id: Connection id, returned in the completion.
+ * @retval The zeroed request, to be filled by the caller.
+ */
+struct io_uring_sqe *TcpUringLoop::getSqe(int op, uint32_t id) {
+	reserveSqes(1);
+	unsigned tail = *_sq_tail;
+	unsigned index = tail & *_sq_mask;
+	struct io_uring_sqe *sqe = &_sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->user_data = uring_user_data(op, id);
+	_sq_array[index] = index;
+	__atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	_to_submit++;
+	return sqe;
+}
+
+/**
+ * @brief  Submits the queued requests and optionally waits for completions.
+ * @param  wait: Number of completions to wait for (at most one second).
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpUringLoop::submit(unsigned wait) {
+	struct __kernel_timespec timeout;
+	timeout.tv_sec = URING_WAIT_TIMEOUT_SECONDS;
+	timeout.tv_nsec = 0;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+	unsigned flags =
+		wait > 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+	long n = syscall(__NR_io_uring_enter, _ring_fd, _to_submit, wait, flags,
+	                 wait > 0 ? &arg : NULL, sizeof(arg));
+	if (n < 0) {
+		if (sig_int) {
+			terminate(_server, TCP_MESSAGE);
+		}
+		if (errno == ETIME || errno == EINTR || errno == EBUSY ||
+		    errno == EAGAIN) {
+			return;
+		}
+		throw UnrecoverableException("[TCP] Failed to submit io_uring requests");
+	}
+	_to_submit -= std::min(_to_submit, static_cast<unsigned>(n));
+}
+
+/**
+ * @brief  Gives a buffer back to the kernel once its data has been copied.
+ * @param  buffer_id: Id of the buffer.
+ * @retval None
+ */
+void TcpUringLoop::recycleBuffer(uint16_t buffer_id) {
+	struct io_uring_sqe *sqe = getSqe(URING_OP_PROVIDE, 0);
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = 1;
+	sqe->addr = reinterpret_cast<uint64_t>(
+		_buffers + static_cast<size_t>(buffer_id) * URING_BUFFER_LEN);
+	sqe->len = URING_BUFFER_LEN;
+	sqe->off = buffer_id;
+	sqe->buf_group = URING_BUFFER_GROUP;
+}
+
+/**
+ * @brief  Submits the queued requests, waits for completions and dispatches
+ * them.
+ * @throws UnrecoverableException
+ * @retval None
+ */
+void TcpUringLoop::waitForCompletions() {
+	submit(1);
+
+	// The connections with bytes read are the queue of the requests
+	unsigned head = *_cq_head;
+	unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+	for (unsigned i = head; i != tail; i++) {
+		struct io_uring_cqe &cqe = _cqes[i & *_cq_mask];
+		if ((cqe.user_data & 0xff) != URING_OP_RECV || cqe.res <= 0) {
+			continue;
+		}
+		auto entry =
+			_connections.find(static_cast<uint32_t>(cqe.user_data >> 8));
+		if (entry != _connections.end()) {
+			setPending(entry->second, true);
+		}
+	}
+
+	while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe cqe = _cqes[head & *_cq_mask];
+		head++;
+		__atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+		handleCompletion(cqe.user_data, cqe.res, cqe.flags);
+	}
+
+	expireConnections();
+}
+
+/**
+ * @brief  Dispatches a completion to the handler of its operation.
+ * @param  user_data: User data of the request.
+ * @param  res: Result of the request.
+ * @param  flags: Completion flags.
+ * @retval None
+ */
+void TcpUringLoop::handleCompletion(uint64_t user_data, int32_t res,
+                                    uint32_t flags) {
+	uint32_t id = static_cast<uint32_t>(user_data >> 8);
+	switch (user_data & 0xff) {
+		case URING_OP_ACCEPT:
+			onAccept(res, flags);
+			break;
+		case URING_OP_RECV:
+			onRecv(id, res, flags);
+			break;
+		case URING_OP_SEND:
+			onSend(id, res);
+			break;
+		case URING_OP_WAKE:
+			finishRequests();
+			break;
+		case URING_OP_CLOSE:
+			// A failed send cancels its linked close and closes by itself.
+			if (res != -ECANCELED && _connections.count(id) > 0) {
+				setPending(_connections.at(id), false);
+				_connections.erase(id);
+				if (_connections.size() < TCP_MAX_CONNECTIONS) {
+					setAccepting(true);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+// -------------------------------------
+// | Connections					   |
+// -------------------------------------
+
+/**
+ * @brief  Starts or stops accepting connections. A single multishot accept
+ * keeps delivering connections until it is cancelled.
+ * @param  accepting: Whether to accept new connections.
+ * @retval None
+ */
+void TcpUringLoop::setAccepting(bool accepting) {
+	_accepting = accepting;
+	if (accepting && !_accept_armed) {
+		struct io_uring_sqe *sqe = getSqe(URING_OP_ACCEPT, 0);
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->fd = _server._tcp_socket_fd;
+		sqe->ioprio = _multishot_accept ? IORING_ACCEPT_MULTISHOT : 0;
+		sqe->accept_flags = SOCK_CLOEXEC;
+		_accept_armed = true;
+	} else if (!accepting && _accept_armed) {
+		struct io_uring_sqe *sqe = getSqe(URING_OP_CANCEL, 0);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = uring_user_data(URING_OP_ACCEPT, 0);
+	}
+}
+
+/**
+ * @brief  Counts a connection in the queue of the admission control or takes
+ * it out. A connection is in the queue from the moment bytes are read for it
+ * until its requests are handled, or found incomplete. Idle connections, such
+ * as sessions waiting for their next request, aren't requests waiting.
+ * @param  &connection: The connection.
+ * @param  pending: Whether it has requests waiting or being handled.
+ * @retval None
+ */
+void TcpUringLoop::setPending(Connection &connection, bool pending) {
+	if (connection.pending == pending) {
+		return;
+	}
+	connection.pending = pending;
+	_pending = pending ? _pending + 1 : _pending - 1;
+	_server._admission.setDepth(_pending);
+}
+
+/**
+ * @brief  Registers a connection delivered by the accept and starts reading
+ * from it.
+ * @param  res: File descriptor of the connection or error.
+ * @param  flags: Completion flags.
+ * @retval None
+ */
+void TcpUringLoop::onAccept(int32_t res, uint32_t flags) {
+	if (!(flags & IORING_CQE_F_MORE)) {
+		_accept_armed = false;
+	}
+
+	if (res >= 0) {
+		Address addr_from;
+		addr_from.size = sizeof(addr_from.addr);
+		getpeername(res, (struct sockaddr *) &addr_from.addr, &addr_from.size);
+		if (!admit_tcp_connection(_server, addr_from, res)) {
+			setAccepting(_accepting);
+			return;
+		}
+
+		uint32_t id = _next_id++;
+		if (_next_id == 0) {
+			_next_id = 1;
+		}
+		Connection &connection = _connections[id];
+		connection.fd = res;
+		connection.address = addr_from;
+		connection.address.socket = res;
+		connection.last_active = time(NULL);
+		armRecv(id, connection);
+
+		if (_connections.size() >= TCP_MAX_CONNECTIONS) {
+			setAccepting(false);
+		}
+	} else if (res == -EMFILE || res == -ENFILE) {
+		// Out of descriptors, try again once a connection closes.
+		printError("Out of file descriptors, pausing accept.");
+		setAccepting(false);
+	} else if (res == -EINVAL && _multishot_accept) {
+		// Kernel without multishot accept, accept one at a time.
+		_multishot_accept = false;
+	}
+
+	// The accept ended (cancelled or failed), start it again if needed.
+	setAccepting(_accepting);
+}
+
+/**
+ * @brief  Queues a read on a connection. The kernel picks the buffer when the
+ * data arrives.
+ * @param  id: Connection id.
+ * @param  &connection: Connection to read from.
+ * @retval None
+ */
+void TcpUringLoop::armRecv(uint32_t id, Connection &connection) {
+	struct io_uring_sqe *sqe = getSqe(URING_OP_RECV, id);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = connection.fd;
+	sqe->len = URING_BUFFER_LEN;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+}
+
+/**
+ * @brief  Appends the data read to the connection and handles the request
+ * once it is complete.
+ * @param  id: Connection id.
+ * @param  res: Number of bytes read or error.
+ * @param  flags: Completion flags, with the id of the buffer used.
+ * @retval None
+ */
+void TcpUringLoop::onRecv(uint32_t id, int32_t res, uint32_t flags) {
+	bool has_buffer = flags & IORING_CQE_F_BUFFER;
+	uint16_t buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+
+	auto entry = _connections.find(id);
+	if (entry != _connections.end() && res > 0) {
+		entry->second.in.append(
+			_buffers + static_cast<size_t>(buffer_id) * URING_BUFFER_LEN,
+			static_cast<size_t>(res));
+	}
+	if (has_buffer) {
+		recycleBuffer(buffer_id);
+	}
+	if (entry == _connections.end()) {
+		return;
+	}
+
+	Connection &connection = entry->second;
+	if (res == -ENOBUFS) {
+		// Every buffer was taken, they have been given back by now.
+		armRecv(id, connection);
+		return;
+	} else if (res < 0) {
+		closeConnection(id);
+		return;
+	} else if (res == 0) {
+		connection.eof = true;
+	}
+	connection.last_active = time(NULL);
+	handleRequests(id, connection);
+}
+
+/**
+ * @brief  Handles the complete requests received in a connection, on this
+ * thread or on a handler thread. A handler thread only gets the connection
+ * once a whole request is received, until then the connection reads on.
+ * @param  id: Connection id.
+ * @param  &connection: Connection that received bytes.
+ * @retval None
+ */
+void TcpUringLoop::handleRequests(uint32_t id, Connection &connection) {
+	if (_completions == nullptr) {
+		setPending(connection, true);
+		onRequestsHandled(id, connection,
+		                  handle_tcp_requests(_server, _manager, connection));
+		return;
+	}
+	bool ready = tcp_requests_ready(_server, connection);
+	setPending(connection, ready);
+	if (!ready) {
+		armRecv(id, connection);
+		return;
+	}
+
+	// No request is in flight, the thread owns the buffers meanwhile
+	connection.state = CONNECTION_HANDLING;
+	_server._executor->submit([this, id, &connection] {
+		int result = handle_tcp_requests(_server, _manager, connection);
+		_completions->push(id, result);
+	});
+}
+
+/**
+ * @brief  Queues the write of the answers of the requests handled, the close
+ * of the connection or the next read if there is no answer yet.
+ * @param  id: Connection id.
+ * @param  &connection: Connection whose requests were handled.
+ * @param  result: TCP_REQUESTS_WAIT, TCP_REQUESTS_WRITE or TCP_REQUESTS_CLOSE.
+ * @retval None
+ */
+void TcpUringLoop::onRequestsHandled(uint32_t id, Connection &connection,
+                                     int result) {
+	setPending(connection, false);
+	switch (result) {
+		case TCP_REQUESTS_WRITE:
+			connection.state = CONNECTION_WRITING;
+			armSend(id, connection);
+			break;
+		case TCP_REQUESTS_CLOSE:
+			closeConnection(id);
+			break;
+		default:
+			connection.state = CONNECTION_READING;
+			armRecv(id, connection);
+			break;
+	}
+}
+
+/**
+ * @brief  Queues the read of the eventfd the handler threads signal when they
+ * finish, so that their results wake up the loop.
+ * @retval None
+ */
+void TcpUringLoop::armWake() {
+	struct io_uring_sqe *sqe = getSqe(URING_OP_WAKE, 0);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = _completions->fd();
+	sqe->addr = reinterpret_cast<uint64_t>(&_wake_count);
+	sqe->len = sizeof(_wake_count);
+}
+
+/**
+ * @brief  Collects the results of the handler threads and waits for the next
+ * ones.
+ * @retval None
+ */
+void TcpUringLoop::finishRequests() {
+	for (auto &done : _completions->take()) {
+		uint32_t id = static_cast<uint32_t>(done.first);
+		auto entry = _connections.find(id);
+		if (entry != _connections.end()) {
+			onRequestsHandled(id, entry->second, done.second);
+		}
+	}
+	armWake();
+}
+
+/**
+ * @brief  Queues the write of the rest of the answers, up to the next file
+ * queued in between them. Without a session the write of the last answers is
+ * linked to the close of the connection, so the connection is closed as soon
+ * as they are sent.
+ * @param  id: Connection id.
+ * @param  &connection: Connection to write to.
+ * @retval None
+ */
+void TcpUringLoop::armSend(uint32_t id, Connection &connection) {
+	reserveSqes(2);
+
+	size_t end = connection.out.size();
+	if (!connection.files.empty()) {
+		end = connection.files.front().at;
+	}
+	struct io_uring_sqe *sqe = getSqe(URING_OP_SEND, id);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = connection.fd;
+	sqe->addr = reinterpret_cast<uint64_t>(connection.out.data() +
+	                                       connection.out_offset);
+	sqe->len = static_cast<uint32_t>(end - connection.out_offset);
+	sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+	if (connection.address.session || end < connection.out.size()) {
+		return;
+	}
+	sqe->flags = IOSQE_IO_LINK;
+
+	// One request per connection, like the fork engine.
+	sqe = getSqe(URING_OP_CLOSE, id);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = connection.fd;
+}
+
+/**
+ * @brief  Checks how much of the answers was sent. A short write cancels the
+ * linked close, so the rest is queued again. Io_uring can't send from a file,
+ * so a file queued next is read into the answers a part at a time. Once a
+ * connection in a session sent everything it goes back to reading.
+ * @param  id: Connection id.
+ * @param  res: Number of bytes sent or error.
+ * @retval None
+ */
+void TcpUringLoop::onSend(uint32_t id, int32_t res) {
+	auto entry = _connections.find(id);
+	if (entry == _connections.end()) {
+		return;
+	}
+
+	Connection &connection = entry->second;
+	if (res <= 0) {
+		closeConnection(id);
+		return;
+	}
+	connection.out_offset += static_cast<size_t>(res);
+	connection.last_active = time(NULL);
+	if (!connection.files.empty() &&
+	    connection.out_offset == connection.files.front().at &&
+	    !read_reply_file(connection)) {
+		closeConnection(id);
+		return;
+	}
+	if (connection.out_offset < connection.out.size()) {
+		armSend(id, connection);
+		return;
+	}
+	if (!connection.address.session) {
+		return;  // The linked close is on its way
+	}
+	if (connection.eof) {
+		closeConnection(id);
+		return;
+	}
+	connection.out.clear();
+	connection.out_offset = 0;
+	connection.state = CONNECTION_READING;
+
+	// Requests sent while the answers were written
+	if (connection.in.empty()) {
+		armRecv(id, connection);
+		return;
+	}
+	handleRequests(id, connection);
+}
+
+/**
+ * @brief  Closes a connection that has no request in flight and resumes
+ * accepting if it was paused.
+ * @param  id: Connection id.
+ * @retval None
+ */
+void TcpUringLoop::closeConnection(uint32_t id) {
+	auto entry = _connections.find(id);
+	if (entry == _connections.end()) {
+		return;
+	}
+	setPending(entry->second, false);
+	close(entry->second.fd);
+	close_reply_files(entry->second);
+	discard_tcp_asset(_server, entry->second);
+	_connections.erase(entry);
+	if (_connections.size() < TCP_MAX_CONNECTIONS) {
+		setAccepting(true);
+	}
+}
+
+/**
+ * @brief  Cancels the request in flight of the connections that have been idle
+ * longer than the read or write timeouts, which then close. Runs at most once
+ * per second.
+ * @retval None
+ */
+void TcpUringLoop::expireConnections() {
+	time_t now = time(NULL);
+	if (now == _last_sweep) {
+		return;
+	}
+	_last_sweep = now;
+
+	for (auto &entry : _connections) {
+		Connection &connection = entry.second;
+		if (connection.state == CONNECTION_HANDLING) {
+			continue;
+		}
+		bool reading = connection.state == CONNECTION_READING;
+		time_t timeout =
+			reading ? TCP_READ_TIMEOUT_SECONDS : TCP_WRITE_TIMEOUT_SECONDS;
+		if (now - connection.last_active >= timeout) {
+			struct io_uring_sqe *sqe = getSqe(URING_OP_CANCEL, entry.first);
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = uring_user_data(
+				reading ? URING_OP_RECV : URING_OP_SEND, entry.first);
+		}
+	}
+}
+
+/**
+ * @brief  Runs the engine until SIGINT or too many errors in a row.
+ * @retval None
+ */
+void TcpUringLoop::run() {
+	uint32_t ex_trial = 0;
+	while (true) {
+		try {
+			waitForCompletions();
+			ex_trial = 0;
+		} catch (std::exception &e) {
+			std::cerr
+				<< "[TCP] Encountered unrecoverable error while running the "
+				   "server. Retrying..."
+				<< std::endl
+				<< e.what() << std::endl;
+			ex_trial++;
+		}
+		if (ex_trial >= EXCEPTION_RETRY_MAX) {
+			std::cerr << "[TCP] Max trials reached, shutting down..."
+					  << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+}
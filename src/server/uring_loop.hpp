@@ -0,0 +1,113 @@
+#ifndef __URING_LOOP__
+#define __URING_LOOP__
+
+/**
+ * @file uring_loop.hpp
+ * @brief Declaration of the io_uring based TCP engine. Connections go through
+ * the same read -> handle -> write steps as in the epoll engine, but accepts,
+ * reads and writes are submitted to the kernel as io_uring requests and their
+ * completions are collected with one system call per loop iteration.
+ */
+
+#include <linux/io_uring.h>
+#include <time.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "event_loop.hpp"
+#include "server.hpp"
+
+// Size of the submission and completion queues
+#define URING_ENTRIES    256
+#define URING_CQ_ENTRIES 4096
+
+// Buffers the kernel picks from when data arrives in a connection
+#define URING_BUFFER_COUNT 64
+#define URING_BUFFER_LEN   16384
+#define URING_BUFFER_GROUP 0
+
+// Operations, kept in the low byte of the user data of each request
+#define URING_OP_ACCEPT  1
+#define URING_OP_RECV    2
+#define URING_OP_SEND    3
+#define URING_OP_CLOSE   4
+#define URING_OP_CANCEL  5
+#define URING_OP_PROVIDE 6
+#define URING_OP_WAKE    7  // Read of the eventfd of the handler threads
+
+/**
+ * @brief  Io_uring driven TCP engine. The listening socket has a single
+ * multishot accept, reads take their buffer from a pool of buffers provided to
+ * the kernel and each answer is sent with a write linked to the close of the
+ * connection, unless the client opened a session.
+ */
+class TcpUringLoop {
+	Server &_server;
+	RequestManager &_manager;
+	int _ring_fd = -1;
+
+	// Submission queue
+	void *_sq_ring = NULL;
+	size_t _sq_ring_size = 0;
+	unsigned *_sq_head;
+	unsigned *_sq_tail;
+	unsigned *_sq_mask;
+	unsigned *_sq_array;
+	struct io_uring_sqe *_sqes = NULL;
+	size_t _sqes_size = 0;
+	unsigned _sq_entries;
+	unsigned _to_submit = 0;
+
+	// Completion queue
+	void *_cq_ring = NULL;
+	size_t _cq_ring_size = 0;
+	unsigned *_cq_head;
+	unsigned *_cq_tail;
+	unsigned *_cq_mask;
+	struct io_uring_cqe *_cqes;
+
+	// Provided buffers
+	char *_buffers = NULL;
+
+	bool _accepting = false;
+	bool _accept_armed = false;
+	bool _multishot_accept = true;  // Off on kernels without it
+	time_t _last_sweep = 0;
+	size_t _pending = 0;  // Connections with requests, the admission queue
+	uint32_t _next_id = 1;  // Connections are known by id, fds get reused
+	std::unordered_map<uint32_t, Connection> _connections;
+	std::unique_ptr<CompletionQueue> _completions;  // With handler threads
+	uint64_t _wake_count;  // Filled by the read of the eventfd
+
+	void setupRing();
+	void setupBuffers();
+	void release();
+	void reserveSqes(unsigned count);
+	struct io_uring_sqe *getSqe(int op, uint32_t id);
+	void submit(unsigned wait);
+	void recycleBuffer(uint16_t buffer_id);
+	void setAccepting(bool accepting);
+	void setPending(Connection &connection, bool pending);
+	void armRecv(uint32_t id, Connection &connection);
+	void armSend(uint32_t id, Connection &connection);
+	void waitForCompletions();
+	void handleCompletion(uint64_t user_data, int32_t res, uint32_t flags);
+	void onAccept(int32_t res, uint32_t flags);
+	void onRecv(uint32_t id, int32_t res, uint32_t flags);
+	void handleRequests(uint32_t id, Connection &connection);
+	void onRequestsHandled(uint32_t id, Connection &connection, int result);
+	void armWake();
+	void finishRequests();
+	void onSend(uint32_t id, int32_t res);
+	void closeConnection(uint32_t id);
+	void expireConnections();
+
+   public:
+	TcpUringLoop(Server &server, RequestManager &manager);
+	~TcpUringLoop();
+	void run();
+};
+
+#endif
@@ -0,0 +1,940 @@
+/**
+ * @file wal_database.cpp
+ * @brief Implementation of the write-ahead log backend of the database.
+ */
+#include "wal_database.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <new>
+
+#include "server.hpp"
+#include "shared/utils.hpp"
+#include "shared/verifications.hpp"
+
+namespace fs = std::filesystem;
+
+static_assert(sizeof(WalRecord) == 96, "WAL records must be 96 bytes");
+
+/**
+ * @brief  Checksum of a record, the FNV-1a hash of the bytes before it.
+ * @param  &record: The record.
+ * @retval The checksum.
+ */
+static uint32_t wal_checksum(const WalRecord &record) {
+	const unsigned char *bytes =
+		reinterpret_cast<const unsigned char *>(&record);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < offsetof(WalRecord, checksum); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * @brief  A new record.
+ * @param  type: The type of the record.
+ * @retval The record, with every other field zeroed.
+ */
+static WalRecord wal_record(uint32_t type) {
+	WalRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = type;
+	return record;
+}
+
+/**
+ * @brief  Writes a record of a snapshot.
+ * @param  *fp: The snapshot.
+ * @param  &record: The record, numbered and checksummed here.
+ * @param  lsn: Number of the latest change the snapshot holds.
+ * @retval true if the record is written.
+ */
+static bool write_record(FILE *fp, WalRecord &record, uint64_t lsn) {
+	record.lsn = lsn;
+	record.checksum = wal_checksum(record);
+	return fwrite(&record, sizeof(record), 1, fp) == 1;
+}
+
+/**
+ * @brief  Maps a file of records to read them.
+ * @param  *fname: The path to the file.
+ * @param  &count: Filled with the number of whole records in it.
+ * @retval The records, NULL if there are none or the file can't be read.
+ * Unmapped with unmap_records.
+ */
+static const WalRecord *map_records(const char *fname, size_t &count) {
+	count = 0;
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == -1 ||
+	    static_cast<size_t>(file_stat.st_size) < sizeof(WalRecord)) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t n = static_cast<size_t>(file_stat.st_size) / sizeof(WalRecord);
+	void *mapping =
+		mmap(NULL, n * sizeof(WalRecord), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Read once from the start to the end
+	madvise(mapping, n * sizeof(WalRecord), MADV_SEQUENTIAL);
+	count = n;
+	return static_cast<const WalRecord *>(mapping);
+}
+
+/**
+ * @brief  Unmaps a file of records.
+ * @param  *records: The records returned by map_records.
+ * @param  count: The number of records.
+ * @retval None
+ */
+static void unmap_records(const WalRecord *records, size_t count) {
+	if (records != NULL) {
+		munmap(const_cast<WalRecord *>(records), count * sizeof(WalRecord));
+	}
+}
+
+/**
+ * @brief  Path to the asset of an auction.
+ * @param  aid: The auction's id.
+ * @retval The path, ASDB/ASSETS/<aid>.
+ */
+static std::string wal_asset_name(uint32_t aid) {
+	std::string asset_name = WAL_ASSETS_DIR "/";
+	asset_name += convert_auction_id_to_str(aid);
+	return asset_name;
+}
+
+/**
+ * @brief  Unmaps the state from this process.
+ */
+WalDatabase::~WalDatabase() {
+	if (_log_fd != -1) {
+		close(_log_fd);
+	}
+	destroy_wal_store(_store);
+}
+
+/**
+ * @brief  Applies a change to the state in memory, the same way when it is
+ * made and when it is replayed. The lock must be held.
+ * @param  &record: The change.
+ * @retval None
+ */
+void WalDatabase::Apply(const WalRecord &record) {
+	if (record.user_id > WAL_MAX_UID || record.aid > AUCTION_INDEX_MAX_AID) {
+		return;
+	}
+	WalUser &user = _store->users[record.user_id];
+	WalAuction &auction = _store->auctions[record.aid];
+
+	switch (record.type) {
+		case WAL_RECORD_USER:
+			user.state = static_cast<uint8_t>(record.duration);
+			memcpy(user.password, record.password, sizeof(user.password));
+			break;
+		case WAL_RECORD_LOGIN:
+			user.state = WAL_USER_LOGGED_IN;
+			memcpy(user.password, record.password, sizeof(user.password));
+			break;
+		case WAL_RECORD_LOGOUT:
+			user.state = WAL_USER_LOGGED_OUT;
+			break;
+		case WAL_RECORD_UNREGISTER:
+			user.state = WAL_USER_UNREGISTERED;
+			break;
+		case WAL_RECORD_OPEN:
+			memset(&auction, 0, sizeof(auction));
+			memcpy(auction.name, record.name, sizeof(record.name));
+			memcpy(auction.asset_fname, record.asset_fname,
+			       sizeof(record.asset_fname));
+			_index->addAuction(record.aid, record.user_id, record.time,
+			                   record.duration, record.value);
+			break;
+		case WAL_RECORD_CLOSE:
+			auction.end_time = record.time;
+			auction.end_elapsed = record.value;
+			_index->closeAuction(record.aid);
+			break;
+		case WAL_RECORD_BID:
+			if (_store->bid_count < WAL_MAX_BIDS) {
+				WalBid &bid = _store->bids[_store->bid_count++];
+				bid.aid = record.aid;
+				bid.bid.user_id = record.user_id;
+				bid.bid.value = record.value;
+				bid.bid.bid_time = record.time;
+				bid.bid.time_passed = record.duration;
+				_index->addBid(record.aid, bid.bid);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * @brief  Appends a change to the log and applies it. The record is written
+ * with a single write, and cut off again if only part of it is written. Once
+ * the log has WAL_SNAPSHOT_RECORDS records a snapshot replaces it. The lock
+ * must be held.
+ * @param  &record: The change, numbered here.
+ * @retval -1 if the record isn't properly written, the change isn't made.
+ * @retval 0 if the change is made.
+ */
+int WalDatabase::Append(WalRecord &record) {
+	record.lsn = _store->next_lsn;
+	record.checksum = wal_checksum(record);
+
+	ssize_t written = write(_log_fd, &record, sizeof(record));
+	if (written != static_cast<ssize_t>(sizeof(record))) {
+		struct stat log_stat;
+		if (written > 0 && fstat(_log_fd, &log_stat) == 0) {
+			int cut = ftruncate(_log_fd, log_stat.st_size - written);
+			(void) cut;
+		}
+		return -1;
+	}
+
+	_store->next_lsn++;
+	_store->logged++;
+	Apply(record);
+
+	// If this fails the log keeps growing, it is all replayed at startup
+	if (_store->logged >= WAL_SNAPSHOT_RECORDS) {
+		WriteSnapshot();
+	}
+	return 0;
+}
+
+/**
+ * @brief  Writes the whole state to a new snapshot and empties the log. The
+ * snapshot is written aside and synced before it replaces the previous one.
+ * If the server stops before the log is emptied, the changes of the log the
+ * snapshot already holds are skipped by the replay. The lock must be held.
+ * @retval -1 if the snapshot isn't properly written, the log is kept.
+ * @retval 0 if successful.
+ */
+int WalDatabase::WriteSnapshot() {
+	const char *tmp_name = WAL_SNAPSHOT_FILE ".tmp";
+	int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return -1;
+	}
+	FILE *fp = fdopen(fd, "w");
+	if (fp == NULL) {
+		close(fd);
+		unlink(tmp_name);
+		return -1;
+	}
+
+	uint64_t lsn = _store->next_lsn - 1;
+	WalRecord record = wal_record(WAL_RECORD_SNAPSHOT);
+	bool written = write_record(fp, record, lsn);
+
+	for (uint32_t uid = 1; uid <= WAL_MAX_UID && written; uid++) {
+		const WalUser &user = _store->users[uid];
+		if (user.state == WAL_USER_UNKNOWN) {
+			continue;
+		}
+		record = wal_record(WAL_RECORD_USER);
+		record.user_id = uid;
+		record.duration = user.state;
+		memcpy(record.password, user.password, sizeof(record.password));
+		written = write_record(fp, record, lsn);
+	}
+
+	for (uint32_t aid = 1; aid <= _index->lastAid() && written; aid++) {
+		IndexedAuction *indexed = _index->auction(aid);
+		if (indexed == NULL) {
+			continue;
+		}
+		const WalAuction &auction = _store->auctions[aid];
+		record = wal_record(WAL_RECORD_OPEN);
+		record.user_id = indexed->host_id;
+		record.aid = aid;
+		record.time = indexed->start_time;
+		record.value = indexed->start_value;
+		record.duration = indexed->timeactive;
+		memcpy(record.name, auction.name, sizeof(record.name));
+		memcpy(record.asset_fname, auction.asset_fname,
+		       sizeof(record.asset_fname));
+		written = write_record(fp, record, lsn);
+
+		if (written && indexed->closed) {
+			record = wal_record(WAL_RECORD_CLOSE);
+			record.aid = aid;
+			record.time = auction.end_time;
+			record.value = auction.end_elapsed;
+			written = write_record(fp, record, lsn);
+		}
+	}
+
+	for (size_t i = 0; i < _store->bid_count && written; i++) {
+		const WalBid &bid = _store->bids[i];
+		record = wal_record(WAL_RECORD_BID);
+		record.user_id = bid.bid.user_id;
+		record.aid = bid.aid;
+		record.time = bid.bid.bid_time;
+		record.value = bid.bid.value;
+		record.duration = bid.bid.time_passed;
+		written = write_record(fp, record, lsn);
+	}
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) == -1) {
+		written = false;
+	}
+	if (fclose(fp) != 0) {
+		written = false;
+	}
+	if (!written || rename(tmp_name, WAL_SNAPSHOT_FILE) == -1) {
+		unlink(tmp_name);
+		return -1;
+	}
+
+	if (ftruncate(_log_fd, 0) == -1) {
+		return -1;
+	}
+	_store->logged = 0;
+	return 0;
+}
+
+/**
+ * @brief  Loads the latest snapshot, if there is one.
+ * @param  &snapshot_lsn: Filled with the number of the latest change it
+ * holds, 0 if there is none.
+ * @retval -1 if the snapshot is corrupted.
+ * @retval 0 if it is loaded or there is none.
+ */
+int WalDatabase::LoadSnapshot(uint64_t &snapshot_lsn) {
+	snapshot_lsn = 0;
+	if (access(WAL_SNAPSHOT_FILE, F_OK) != 0) {
+		return 0;
+	}
+
+	size_t count;
+	const WalRecord *records = map_records(WAL_SNAPSHOT_FILE, count);
+	if (records == NULL || records[0].type != WAL_RECORD_SNAPSHOT) {
+		unmap_records(records, count);
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (records[i].checksum != wal_checksum(records[i])) {
+			unmap_records(records, count);
+			return -1;
+		}
+		Apply(records[i]);
+	}
+
+	snapshot_lsn = records[0].lsn;
+	unmap_records(records, count);
+	return 0;
+}
+
+/**
+ * @brief  Rebuilds the state: loads the latest snapshot and applies the
+ * changes of the log made after it. The log is cut at its first record that
+ * is torn or corrupted, left by a server that stopped while writing it.
+ * @retval -1 if the snapshot is corrupted.
+ * @retval 0 if successful.
+ */
+int WalDatabase::Replay() {
+	uint64_t snapshot_lsn;
+	if (LoadSnapshot(snapshot_lsn) == -1) {
+		return -1;
+	}
+	_store->next_lsn = snapshot_lsn + 1;
+
+	size_t count;
+	const WalRecord *records = map_records(WAL_LOG_FILE, count);
+	size_t valid = 0;
+	for (; valid < count; valid++) {
+		const WalRecord &record = records[valid];
+		if (record.checksum != wal_checksum(record)) {
+			break;
+		}
+		if (record.lsn < _store->next_lsn) {
+			continue;
+		}
+		Apply(record);
+		_store->next_lsn = record.lsn + 1;
+		_store->logged++;
+	}
+	unmap_records(records, count);
+
+	off_t log_size = static_cast<off_t>(valid * sizeof(WalRecord));
+	struct stat log_stat;
+	if (stat(WAL_LOG_FILE, &log_stat) == 0 && log_stat.st_size != log_size) {
+		int cut = truncate(WAL_LOG_FILE, log_size);
+		(void) cut;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Creates the directories of the backend, initializes the semaphore
+ * and loads the state.
+ * @param  sem_id: The semaphore's id.
+ * @retval -1 if the semaphore isn't initialized, the directories' creation
+ * fails or the state can't be loaded.
+ * @retval 0 if successful.
+ */
+int WalDatabase::CreateBaseDir(int sem_id) {
+	if (semaphore_init(sem_id) == -1) {
+		return -1;
+	}
+
+	// Uploads left by a server that stopped mid upload are dropped
+	std::error_code error;
+	fs::remove_all(WAL_UPLOADS_DIR, error);
+
+	if (mkdir(WAL_DIR, 0700) == -1 && errno != EEXIST) {
+		return -1;
+	}
+
+	if (mkdir(WAL_ASSETS_DIR, 0700) == -1 && errno != EEXIST) {
+		return -1;
+	}
+
+	if (mkdir(WAL_UPLOADS_DIR, 0700) == -1) {
+		return -1;
+	}
+
+	// Mapped before forking, so every process changes the same state
+	_index = create_auction_index();
+	_store = create_wal_store();
+	if (Replay() == -1) {
+		return -1;
+	}
+
+	_log_fd =
+		open(WAL_LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (_log_fd == -1) {
+		return -1;
+	}
+
+	// The changes replayed go into a new snapshot, the next start only loads it
+	struct stat log_stat;
+	if (fstat(_log_fd, &log_stat) == 0 && log_stat.st_size > 0) {
+		WriteSnapshot();
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Creates an empty file for the asset of an auction being opened.
+ * Doesn't take the lock.
+ * @param  &staged_fname: Filled with the path of the file.
+ * @retval The file descriptor of the file, -1 if it isn't created.
+ */
+int WalDatabase::StageAsset(std::string &staged_fname) {
+	std::string fname_template = WAL_UPLOADS_DIR "/XXXXXX";
+	int fd = mkostemp(&fname_template[0], O_CLOEXEC);
+	if (fd == -1) {
+		return -1;
+	}
+	staged_fname = fname_template;
+	return fd;
+}
+
+/**
+ * @brief  Looks up a user.
+ * @param  user_id: The user's id.
+ * @retval The user, NULL if the id is invalid.
+ */
+WalUser *WalDatabase::GetUser(std::string user_id) {
+	if (verify_user_id(user_id) == -1) {
+		return NULL;
+	}
+	return &_store->users[stoi(user_id)];
+}
+
+/**
+ * @brief  Checks if the user is logged in.
+ * @param  user_id: The user's id.
+ * @retval -1 if the id is invalid or the user isn't logged in.
+ * @retval 0 if the user is logged in.
+ */
+int WalDatabase::CheckUserLoggedIn(std::string user_id) {
+	WalUser *user = GetUser(user_id);
+	if (user == NULL || user->state != WAL_USER_LOGGED_IN) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Checks whether the password given is the user's password.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @retval -1 if the user or the password are invalid or the user isn't
+ * registered.
+ * @retval 0 if the password is incorrect.
+ * @retval 1 if the password is correct.
+ */
+int WalDatabase::CorrectPassword(std::string user_id, std::string password) {
+	WalUser *user = GetUser(user_id);
+	if (user == NULL || verify_password(password) == -1) {
+		return -1;
+	}
+	if (user->state != WAL_USER_LOGGED_OUT &&
+	    user->state != WAL_USER_LOGGED_IN) {
+		return -1;
+	}
+	return memcmp(user->password, password.data(), sizeof(user->password)) ==
+	               0
+	           ? 1
+	           : 0;
+}
+
+/**
+ * @brief  Logs the user into the system, registering the user if needed.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @throws UserNotLoggedIn if the user is logged in with another password.
+ * @retval DB_LOGIN_NOK if the password is wrong or the login isn't logged.
+ * @retval DB_LOGIN_OK if the login is successful.
+ * @retval DB_LOGIN_REGISTER if a new user is registered.
+ */
+int WalDatabase::LoginUser(std::string user_id, std::string password) {
+	WalUser *user = GetUser(user_id);
+	if (user == NULL || verify_password(password) == -1) {
+		return DB_LOGIN_NOK;
+	}
+
+	semaphore_wait();
+	int correct = CorrectPassword(user_id, password);
+	if (user->state == WAL_USER_LOGGED_IN) {
+		semaphore_post();
+		if (correct != 1) {
+			throw UserNotLoggedIn();
+			return DB_LOGIN_NOK;
+		}
+		return DB_LOGIN_OK;
+	}
+	if (user->state == WAL_USER_LOGGED_OUT && correct != 1) {
+		semaphore_post();
+		return DB_LOGIN_NOK;
+	}
+
+	// Unknown and unregistered users are registered with the password given
+	int result = user->state == WAL_USER_LOGGED_OUT ? DB_LOGIN_OK
+	                                                : DB_LOGIN_REGISTER;
+	WalRecord record = wal_record(WAL_RECORD_LOGIN);
+	record.user_id = static_cast<uint32_t>(stoi(user_id));
+	memcpy(record.password, password.data(), sizeof(record.password));
+	if (Append(record) == -1) {
+		result = DB_LOGIN_NOK;
+	}
+
+	semaphore_post();
+	return result;
+}
+
+/**
+ * @brief  Logs out the user.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @throws UserNotLoggedIn if the user isn't logged in.
+ * @retval DB_LOGOUT_NOK if the password is wrong, the user isn't registered
+ * or the logout isn't logged.
+ * @retval DB_LOGOUT_OK if the logout is successful.
+ */
+int WalDatabase::Logout(std::string user_id, std::string password) {
+	semaphore_wait();
+	if (CorrectPassword(user_id, password) != 1) {
+		semaphore_post();
+		return DB_LOGOUT_NOK;
+	}
+	if (CheckUserLoggedIn(user_id) != 0) {
+		semaphore_post();
+		throw UserNotLoggedIn();
+		return DB_LOGOUT_NOK;
+	}
+
+	WalRecord record = wal_record(WAL_RECORD_LOGOUT);
+	record.user_id = static_cast<uint32_t>(stoi(user_id));
+	int result = Append(record) == -1 ? DB_LOGOUT_NOK : DB_LOGOUT_OK;
+
+	semaphore_post();
+	return result;
+}
+
+/**
+ * @brief  Unregisters the user, logging the user out.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @throws UserNotLoggedIn if the user isn't logged in.
+ * @retval DB_UNREGISTER_NOK if the password is wrong, the user isn't
+ * registered or the change isn't logged.
+ * @retval DB_UNREGISTER_OK if the user is sucessfully unregistered.
+ */
+int WalDatabase::Unregister(std::string user_id, std::string password) {
+	semaphore_wait();
+	if (CorrectPassword(user_id, password) != 1) {
+		semaphore_post();
+		return DB_UNREGISTER_NOK;
+	}
+	if (CheckUserLoggedIn(user_id) != 0) {
+		semaphore_post();
+		throw UserNotLoggedIn();
+		return DB_UNREGISTER_NOK;
+	}
+
+	WalRecord record = wal_record(WAL_RECORD_UNREGISTER);
+	record.user_id = static_cast<uint32_t>(stoi(user_id));
+	int result = Append(record) == -1 ? DB_UNREGISTER_NOK : DB_UNREGISTER_OK;
+
+	semaphore_post();
+	return result;
+}
+
+/**
+ * @brief  Creates a new auction.
+ * @param  user_id: The user's id.
+ * @param  name: The name of the asset auctioned.
+ * @param  password: The user's password.
+ * @param  asset_fname: The name of the asset's image.
+ * @param  start_value: The starting value of the asset.
+ * @param  timeactive: The time the auction will be active for.
+ * @param  fsize: The size of the data file of the asset's image.
+ * @param  staged_fname: The asset's image, already on disk (see StageAsset).
+ * It is moved into the assets or deleted if the auction isn't created.
+ * @throws UserNotLoggedIn if the user isn't logged in.
+ * @retval DB_OPEN_NOT_LOGGED_IN if the user isn't logged in
+ * @retval DB_OPEN_CREATE_FAIL if the password is wrong, there is no id left,
+ * a parameter is invalid or the asset or the change can't be written.
+ * @retval If successful returns the id of the newly created auction.
+ */
+int WalDatabase::Open(std::string user_id, std::string name,
+                      std::string password, std::string asset_fname,
+                      std::string start_value, std::string timeactive,
+                      size_t fsize, std::string staged_fname) {
+	(void) fsize;
+	semaphore_wait();
+	if (CheckUserLoggedIn(user_id) != 0) {
+		semaphore_post();
+		DiscardAsset(staged_fname);
+		throw UserNotLoggedIn();
+		return DB_OPEN_NOT_LOGGED_IN;
+	}
+	if (CorrectPassword(user_id, password) != 1) {
+		semaphore_post();
+		DiscardAsset(staged_fname);
+		return DB_OPEN_CREATE_FAIL;
+	}
+
+	uint32_t aid = _index->lastAid() + 1;
+	if (aid > AUCTION_INDEX_MAX_AID || verify_name(name) == -1 ||
+	    verify_start_value(start_value) == -1 ||
+	    verify_timeactive(timeactive) == -1 ||
+	    asset_fname.size() > MAX_FILENAME_SIZE) {
+		semaphore_post();
+		DiscardAsset(staged_fname);
+		return DB_OPEN_CREATE_FAIL;
+	}
+
+	std::string asset_name = wal_asset_name(aid);
+	if (rename(staged_fname.c_str(), asset_name.c_str()) == -1) {
+		semaphore_post();
+		DiscardAsset(staged_fname);
+		return DB_OPEN_CREATE_FAIL;
+	}
+
+	WalRecord record = wal_record(WAL_RECORD_OPEN);
+	record.user_id = static_cast<uint32_t>(stoi(user_id));
+	record.aid = aid;
+	record.time = static_cast<uint32_t>(time(NULL));
+	record.value = static_cast<uint32_t>(stol(start_value));
+	record.duration = static_cast<uint32_t>(stol(timeactive));
+	memcpy(record.name, name.data(), name.size());
+	memcpy(record.asset_fname, asset_fname.data(), asset_fname.size());
+	if (Append(record) == -1) {
+		unlink(asset_name.c_str());
+		semaphore_post();
+		return DB_OPEN_CREATE_FAIL;
+	}
+
+	semaphore_post();
+	return static_cast<int>(aid);
+}
+
+/**
+ * @brief  Closes the auction. The lock must be held.
+ * @param  a_id: The auction's id.
+ * @throws AuctionNotFound if the auction doesn't exist.
+ * @throws AuctionAlreadyClosed if the auction already ended.
+ * @retval DB_CLOSE_NOK if the change isn't logged.
+ * @retval DB_CLOSE_OK if the auction closes successfully.
+ */
+int WalDatabase::Close(std::string a_id) {
+	uint32_t aid = static_cast<uint32_t>(stoi(a_id));
+	IndexedAuction *indexed = _index->auction(aid);
+	if (indexed == NULL) {
+		throw AuctionNotFound();
+		return DB_CLOSE_NOK;
+	}
+	if (indexed->closed) {
+		throw AuctionAlreadyClosed();
+		return DB_CLOSE_ENDED_ALREADY;
+	}
+
+	// An auction closed after its time is up ends when its time was up
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
+	uint32_t time_passed = current_time - indexed->start_time;
+	WalRecord record = wal_record(WAL_RECORD_CLOSE);
+	record.aid = aid;
+	if (time_passed > indexed->timeactive) {
+		record.time = indexed->start_time + indexed->timeactive;
+		record.value = indexed->timeactive;
+	} else {
+		record.time = current_time;
+		record.value = time_passed;
+	}
+
+	return Append(record) == -1 ? DB_CLOSE_NOK : DB_CLOSE_OK;
+}
+
+/**
+ * @brief  Closes the auction of a user.
+ * @param  a_id: The auction's id.
+ * @param  user_id: The user's id.
+ * @param  password: The user's password.
+ * @throws UserDoesNotExist if the user doesn't exist.
+ * @throws UserNotLoggedIn if the user isn't logged in.
+ * @throws IncorrectPassword if the password is incorrect.
+ * @throws AuctionNotFound if the auction doesn't exist.
+ * @throws AuctionNotOwnedByUser if the auction wasn't created by the user.
+ * @throws AuctionAlreadyClosed if the auction was already closed.
+ * @retval DB_CLOSE_NOK if the change isn't logged.
+ * @retval DB_CLOSE_OK if the auction closes successfully.
+ */
+int WalDatabase::CloseAuction(std::string a_id, std::string user_id,
+                              std::string password) {
+	semaphore_wait();
+	WalUser *user = GetUser(user_id);
+	if (user == NULL || user->state == WAL_USER_UNKNOWN) {
+		semaphore_post();
+		throw UserDoesNotExist();
+		return DB_CLOSE_NOK;
+	}
+	if (CheckUserLoggedIn(user_id) != 0) {
+		semaphore_post();
+		throw UserNotLoggedIn();
+		return DB_CLOSE_NOK;
+	}
+	if (CorrectPassword(user_id, password) != 1) {
+		semaphore_post();
+		throw IncorrectPassword();
+		return DB_CLOSE_NOK;
+	}
+	IndexedAuction *indexed = NULL;
+	if (verify_auction_id(a_id) == 0) {
+		indexed = _index->auction(static_cast<uint32_t>(stoi(a_id)));
+	}
+	if (indexed == NULL) {
+		semaphore_post();
+		throw AuctionNotFound();
+		return DB_CLOSE_NOK;
+	}
+	if (indexed->host_id != static_cast<uint32_t>(stoi(user_id))) {
+		semaphore_post();
+		throw AuctionNotOwnedByUser();
+		return DB_CLOSE_NOK;
+	}
+	if (indexed->closed) {
+		semaphore_post();
+		throw AuctionAlreadyClosed();
+		return DB_CLOSE_ENDED_ALREADY;
+	}
+
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
+	if (current_time - indexed->start_time >= indexed->timeactive) {
+		Close(a_id);
+		semaphore_post();
+		throw AuctionAlreadyClosed();
+		return DB_CLOSE_ENDED_ALREADY;
+	}
+	int res = Close(a_id);
+
+	semaphore_post();
+	return res;
+}
+
+/**
+ * @brief  Shows the information about the auction's asset.
+ * @param  a_id: The auction's id.
+ * @throws AssetDoesNotExist if the auction or its asset don't exist.
+ * @retval The asset's info, with the asset open for reading.
+ */
+AssetInfo WalDatabase::ShowAsset(std::string a_id) {
+	AssetInfo asset;
+	uint32_t aid = 0;
+	if (verify_auction_id(a_id) == 0) {
+		aid = static_cast<uint32_t>(stoi(a_id));
+	}
+
+	semaphore_wait();
+	if (_index->auction(aid) == NULL) {
+		semaphore_post();
+		throw AssetDoesNotExist();
+	}
+
+	// Opened under the lock, the file stays readable if replaced afterwards
+	asset.fd = OpenAssetFile(wal_asset_name(aid), asset.fsize);
+	if (asset.fd == -1) {
+		semaphore_post();
+		throw AssetDoesNotExist();
+	}
+	asset.asset_fname = _store->auctions[aid].asset_fname;
+
+	semaphore_post();
+	return asset;
+}
+
+/**
+ * @brief  Shows the auction's information and the most recent 50 bids placed
+ * on it.
+ * @param  a_id: The auction's id.
+ * @throws AuctionNotFound if the auction doesn't exist.
+ * @retval The auction's information and the most recent 50 bids on it.
+ */
+AuctionRecord WalDatabase::ShowRecord(std::string a_id) {
+	AuctionRecord result;
+	uint32_t aid = 0;
+	if (verify_auction_id(a_id) == 0) {
+		aid = static_cast<uint32_t>(stoi(a_id));
+	}
+
+	semaphore_wait();
+	IndexedAuction *indexed = _index->auction(aid);
+	if (indexed == NULL) {
+		semaphore_post();
+		throw AuctionNotFound();
+		return result;
+	}
+
+	const WalAuction &auction = _store->auctions[aid];
+	result.auction_name = auction.name;
+	result.host_id = convert_user_id_to_str(indexed->host_id);
+	result.asset_fname = auction.asset_fname;
+	result.start_value = std::to_string(indexed->start_value);
+	result.start_datetime = FormatDate(indexed->start_time);
+	result.timeactive = std::to_string(indexed->timeactive);
+
+	uint32_t current_time = static_cast<uint32_t>(time(NULL));
+	if (!indexed->closed &&
+	    current_time - indexed->start_time >= indexed->timeactive) {
+		Close(a_id);
+	}
+	result.active = !indexed->closed;
+	if (indexed->closed) {
+		result.end_datetime = FormatDate(auction.end_time);
+		result.end_timeelapsed = auction.end_elapsed;
+	}
+
+	IndexedBid recent[AUCTION_INDEX_RECENT_BIDS];
+	size_t n = _index->recentBids(aid, recent);
+	for (size_t i = 0; i < n; i++) {
+		BidInfo bid;
+		bid.user_id = convert_user_id_to_str(recent[i].user_id);
+		bid.value = std::to_string(recent[i].value);
+		bid.current_date = FormatDate(recent[i].bid_time);
+		bid.time_passed = recent[i].time_passed;
+		result.list.push_back(bid);
+	}
+
+	semaphore_post();
+	return result;
+}
+
+/**
+ * @brief  Logs a bid and adds it to the state. The lock must be held.
+ * @param  a_id: The auction's id, in the index.
+ * @param  &bid: The bid, larger than the ones before it.
+ * @retval -1 if there is no room for the bid or it isn't logged.
+ * @retval 0 if the bid is made.
+ */
+int WalDatabase::AppendBid(std::string a_id, const IndexedBid &bid) {
+	if (verify_auction_id(a_id) == -1 || _store->bid_count == WAL_MAX_BIDS) {
+		return -1;
+	}
+
+	WalRecord record = wal_record(WAL_RECORD_BID);
+	record.user_id = bid.user_id;
+	record.aid = static_cast<uint32_t>(stoi(a_id));
+	record.time = bid.bid_time;
+	record.value = bid.value;
+	record.duration = bid.time_passed;
+	return Append(record);
+}
+
+/**
+ * @brief  Finds the auctions a user bid on among the bids in memory, for a
+ * user the auction index doesn't have room for. The lock must be held.
+ * @param  bidder_id: The user's id.
+ * @retval The ids of the auctions, in order.
+ */
+std::vector<uint32_t> WalDatabase::FindBids(uint32_t bidder_id) {
+	std::vector<bool> bid_on(AUCTION_INDEX_MAX_AID + 1, false);
+	for (size_t i = 0; i < _store->bid_count; i++) {
+		if (_store->bids[i].bid.user_id == bidder_id) {
+			bid_on[_store->bids[i].aid] = true;
+		}
+	}
+
+	std::vector<uint32_t> result;
+	for (uint32_t aid = 1; aid <= AUCTION_INDEX_MAX_AID; aid++) {
+		if (bid_on[aid]) {
+			result.push_back(aid);
+		}
+	}
+	return result;
+}
+
+/**
+ * @brief  Maps the state. Must be called before forking so every process sees
+ * the same mapping. Pages are only backed once they are written.
+ * @throws UnrecoverableException
+ * @retval The state, without users, auctions or bids.
+ */
+WalStore *create_wal_store() {
+	void *mapping =
+		mmap(NULL, sizeof(WalStore), PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw UnrecoverableException("[ERROR] Failed to map WAL state");
+	}
+	// Not value initialized, which would write every page: the mapping is
+	// already zeroed
+	return new (mapping) WalStore;
+}
+
+/**
+ * @brief  Unmaps the state from this process.
+ * @param  store: State returned by create_wal_store.
+ * @retval None
+ */
+void destroy_wal_store(WalStore *store) {
+	if (store != NULL) {
+		munmap(store, sizeof(WalStore));
+	}
+}
@@ -0,0 +1,159 @@
+#ifndef __WAL_DATABASE__
+#define __WAL_DATABASE__
+
+/**
+ * @file wal_database.hpp
+ * @brief Declaration of the write-ahead log backend of the database (-D wal).
+ * Users, auctions and bids are kept in memory, in an anonymous shared mapping
+ * created before forking like the auction index, and every change is appended
+ * to a single log file before it is applied. At startup the latest snapshot
+ * (a compact copy of the whole state) is loaded and the log is replayed on
+ * top of it. Only the assets are kept in files of their own.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "database.hpp"
+#include "shared/config.hpp"
+
+// Files of the backend
+#define WAL_DIR           "ASDB"
+#define WAL_LOG_FILE      WAL_DIR "/AS.wal"
+#define WAL_SNAPSHOT_FILE WAL_DIR "/AS.snap"
+#define WAL_ASSETS_DIR    WAL_DIR "/ASSETS"
+#define WAL_UPLOADS_DIR   WAL_DIR "/UPLOADS"
+
+// User ids go from 000001 to 999999
+#define WAL_MAX_UID 999999
+
+// Bids kept in memory, the ones past it are refused
+#define WAL_MAX_BIDS (1 << 22)
+
+// Records appended to the log before a snapshot replaces it
+#define WAL_SNAPSHOT_RECORDS 100000
+
+// Types of the records
+#define WAL_RECORD_SNAPSHOT   1  // First record of a snapshot
+#define WAL_RECORD_USER       2  // State and password of a user (snapshot)
+#define WAL_RECORD_LOGIN      3
+#define WAL_RECORD_LOGOUT     4
+#define WAL_RECORD_UNREGISTER 5
+#define WAL_RECORD_OPEN       6
+#define WAL_RECORD_CLOSE      7
+#define WAL_RECORD_BID        8
+
+// States of a user
+#define WAL_USER_UNKNOWN      0
+#define WAL_USER_UNREGISTERED 1
+#define WAL_USER_LOGGED_OUT   2
+#define WAL_USER_LOGGED_IN    3
+
+/**
+ * @brief  A change, as written to the log and to the snapshot. Records have a
+ * fixed size and end with a checksum, a replay stops at the first one that is
+ * torn or corrupted.
+ */
+class WalRecord {
+   public:
+	uint64_t lsn;  // Number of the change, from 1
+	uint32_t type;
+	uint32_t user_id;
+	uint32_t aid;
+	uint32_t time;      // Open: start, Close: end, Bid: when it was placed
+	uint32_t value;     // Open: start value, Close: seconds active, Bid: value
+	uint32_t duration;  // User: state, Open: timeactive, Bid: time passed
+	char password[8];
+	char name[MAX_FILENAME_SIZE];         // Not null terminated
+	char asset_fname[MAX_FILENAME_SIZE];  // Not null terminated
+	uint32_t checksum;
+};
+
+/**
+ * @brief  A user. The id is its place in the table of users.
+ */
+class WalUser {
+   public:
+	uint8_t state;
+	char password[8];
+};
+
+/**
+ * @brief  What an auction has besides what the auction index holds.
+ */
+class WalAuction {
+   public:
+	char name[MAX_FILENAME_SIZE + 1];
+	char asset_fname[MAX_FILENAME_SIZE + 1];
+	uint32_t end_time;     // Seconds since the epoch, set once it is closed
+	uint32_t end_elapsed;  // Seconds it was active for
+};
+
+/**
+ * @brief  A bid and the auction it was placed on.
+ */
+class WalBid {
+   public:
+	uint32_t aid;
+	IndexedBid bid;
+};
+
+/**
+ * @brief  Everything the backend keeps in memory, apart from the auction
+ * index. Users are looked up by id and bids are kept in the order they were
+ * placed. Pages are only backed once they are written.
+ */
+class WalStore {
+   public:
+	WalUser users[WAL_MAX_UID + 1];
+	WalAuction auctions[AUCTION_INDEX_MAX_AID + 1];
+	uint64_t next_lsn = 1;
+	uint64_t logged = 0;  // Records in the log since the latest snapshot
+	size_t bid_count = 0;
+	WalBid bids[WAL_MAX_BIDS];
+};
+
+/**
+ * @brief  Database backend that keeps its state in memory and persists it
+ * through a write-ahead log. Requests are answered as the ASDIR backend
+ * answers them.
+ */
+class WalDatabase : public Database {
+	WalStore *_store = NULL;  // Shared by every process, like the index
+	int _log_fd = -1;         // Shared by every process, opened with O_APPEND
+
+	int Replay();
+	int LoadSnapshot(uint64_t &snapshot_lsn);
+	int WriteSnapshot();
+	int Append(WalRecord &record);
+	void Apply(const WalRecord &record);
+	WalUser *GetUser(std::string user_id);
+
+   protected:
+	int CorrectPassword(std::string user_id, std::string password) override;
+	int Close(std::string a_id) override;
+	int AppendBid(std::string a_id, const IndexedBid &bid) override;
+	std::vector<uint32_t> FindBids(uint32_t bidder_id) override;
+
+   public:
+	~WalDatabase() override;
+	int CreateBaseDir(int sem_id) override;
+	int StageAsset(std::string &staged_fname) override;
+	int CheckUserLoggedIn(std::string user_id) override;
+	int LoginUser(std::string user_id, std::string password) override;
+	int Logout(std::string user_id, std::string password) override;
+	int Unregister(std::string user_id, std::string password) override;
+	int Open(std::string user_id, std::string name, std::string password,
+	         std::string asset_fname, std::string start_value,
+	         std::string timeactive, size_t fsize,
+	         std::string staged_fname) override;
+	int CloseAuction(std::string a_id, std::string user_id,
+	                 std::string password) override;
+	AssetInfo ShowAsset(std::string a_id) override;
+	AuctionRecord ShowRecord(std::string a_id) override;
+};
+
+WalStore *create_wal_store();
+void destroy_wal_store(WalStore *store);
+
+#endif
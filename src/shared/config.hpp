@@ -30,16 +30,48 @@
 #define TCP_WRITE_TIMEOUT_USECONDS 0
 
 // default buffer lengths
-#define UDP_SOCKET_BUFFER_LEN 6002  // Max UDP message size
-#define SOCKET_BUFFER_LEN     512   // Max TCP buffer size (512 bytes step)
+#define UDP_SOCKET_BUFFER_LEN 6002   // Max UDP message size
+#define SOCKET_BUFFER_LEN     512    // Max TCP buffer size (512 bytes step)
+#define FILE_COPY_BUFFER_LEN  65536  // File data moved to disk at once
+#define TCP_READ_BUFFER_LEN   65536  // Bytes read from a TCP socket at once
+
+// Serialized messages: a buffer for any message without file data, which is
+// sent from where it is in up to MESSAGE_MAX_PAYLOADS extra iovecs
+#define MESSAGE_BUFFER_LEN   UDP_SOCKET_BUFFER_LEN
+#define MESSAGE_MAX_PAYLOADS 2
+#define MESSAGE_MAX_IOVECS   (2 * MESSAGE_MAX_PAYLOADS + 1)
 
 // Message types
 #define TCP_MESSAGE 0
 #define UDP_MESSAGE 1
 
-// Max tcp queue size for listen
+// Max tcp queue size for listen (default, can be changed with -q)
 #define TCP_MAX_QUEUE_SIZE 10
 
+// Max number of TCP workers that can be started with -w
+#define TCP_MAX_WORKERS 64
+
+// Max number of UDP workers that can be started with -u
+#define UDP_MAX_WORKERS 64
+
+// UDP messages received and answered at once (default and max for -b)
+#define UDP_DEFAULT_BATCH 16
+#define UDP_MAX_BATCH     64
+
+// Time a UDP request may wait in the server before it is dropped unanswered,
+// the client has retransmitted it by then (default and max for -d)
+#define UDP_DEFAULT_DEADLINE_MS (UDP_TIMEOUT * 1000)
+#define UDP_MAX_DEADLINE_MS     (60 * 1000)
+
+// Max number of request handler threads that can be started with -x
+#define EXECUTOR_MAX_THREADS 64
+
+// Max high watermark of the request queue that can be set with -a
+#define ADMISSION_MAX_WATERMARK 512
+
+// Max connections kept open at once by the event loop
+#define TCP_MAX_CONNECTIONS 1024
+
 // Default path for client assets
 #define CLIENT_ASSET_DEFAULT_PATH ""
 
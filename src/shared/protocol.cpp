@@ -1,5 +1,15 @@
 #include "protocol.hpp"
 
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <charconv>
+
 /**
  * @file protocol.cpp
  * @brief This file contains the implementation of the Protocol used in the
@@ -7,515 +17,864 @@
  */
 
 // -----------------------------------
-// | Reading functions				 |
+// | Message adapters				 |
 // -----------------------------------
 
 /**
- * @brief  Reads a character from the buffer.
- * @param  &buffer: adapter
- * @throws InvalidMessageException
- * @retval char
+ * @brief  Writes bytes to a file until all of them are written.
+ * @param  fd: File descriptor.
+ * @param  *data: Bytes to write.
+ * @param  len: Number of bytes.
+ * @throws FileException
+ * @retval None
  */
-char ProtocolMessage::readChar(MessageAdapter &buffer) {
-	char c;
-	c = buffer.get();
-	if (!buffer.good()) {
-		throw InvalidMessageException();
+static void write_file_data(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			throw FileException();
+		}
+		data += n;
+		len -= static_cast<size_t>(n);
 	}
-	return c;
 }
 
 /**
- * @brief  Reads a character from the buffer and compares it to a given char,
- * expecting them to be equal.
- * @param  &buffer: adapter
- * @throws InvalidMessageException
- * @retval char
+ * @brief  Finds the first space or delimiter among some bytes, one at a time.
+ * @param  *data: Bytes to search.
+ * @param  len: Number of bytes.
+ * @param  max_len: Position at which the search stops.
+ * @retval Position of the first space or delimiter, or the smallest of len and
+ * max_len if there is none before it.
  */
-void ProtocolMessage::readChar(MessageAdapter &buffer, char c) {
-	char read = readChar(buffer);
-	if (read != c) {
-		throw InvalidMessageException();
+static size_t find_delimiter_scalar(const char *data, size_t len,
+                                    size_t max_len) {
+	size_t end = std::min(len, max_len);
+	size_t i = 0;
+	while (i < end && data[i] != ' ' && data[i] != '\n') {
+		i++;
 	}
+	return i;
 }
 
+#if defined(__x86_64__)
 /**
- * @brief  Reads a character from the buffer and compares it to a given char
- * evaluating if they are equal.
- * @param  &buffer: adapter
- * @retval true if equal, false otherwise
+ * @brief  Finds the first space or delimiter among some bytes, 16 at a time.
+ * SSE2 is part of every x86-64 processor. Blocks are only loaded while they
+ * are whole, the bytes after the last one are searched one at a time.
+ * @param  *data: Bytes to search.
+ * @param  len: Number of bytes.
+ * @param  max_len: Position at which the search stops.
+ * @retval Position of the first space or delimiter, or the smallest of len and
+ * max_len if there is none before it.
  */
-bool ProtocolMessage::readCharEqual(MessageAdapter &buffer, char c) {
-	char read = readChar(buffer);
-	if (read != c) {
-		buffer.unget();
-		return false;
-	} else {
-		return true;
+static size_t find_delimiter_sse2(const char *data, size_t len,
+                                  size_t max_len) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t i = 0;
+	for (; i < max_len && i + 16 <= len; i += 16) {
+		__m128i block =
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+		__m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, space),
+		                             _mm_cmpeq_epi8(block, newline));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+		if (mask != 0) {
+			return std::min(i + static_cast<size_t>(__builtin_ctz(mask)),
+			                max_len);
+		}
+	}
+	if (i >= max_len) {
+		return max_len;
 	}
+	return i + find_delimiter_scalar(data + i, len - i, max_len - i);
 }
 
 /**
- * @brief  Reads a messageID from the buffer and compares it to a given protocol
- * code expecting them to be equal.
- * @param  &buffer: adapter
- * @throws UnexpectedMessageException
- * @throws ERRCodeMessageException
- * @retval None
+ * @brief  Finds the first space or delimiter among some bytes, 32 at a time,
+ * leaving the bytes after the last whole block to find_delimiter_sse2. Only
+ * called if the processor supports AVX2.
+ * @param  *data: Bytes to search.
+ * @param  len: Number of bytes.
+ * @param  max_len: Position at which the search stops.
+ * @retval Position of the first space or delimiter, or the smallest of len and
+ * max_len if there is none before it.
  */
-void ProtocolMessage::readMessageId(MessageAdapter &buffer,
-                                    std::string protocol_code) {
-	char current_char;
-	std::string errcheck;
+__attribute__((target("avx2"))) static size_t find_delimiter_avx2(
+	const char *data, size_t len, size_t max_len) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i newline = _mm256_set1_epi8('\n');
 	size_t i = 0;
-	while (protocol_code[i] != '\0') {
-		current_char = readChar(buffer);
-		errcheck += current_char;
-		if (!buffer.good() || current_char != protocol_code[i]) {
-			throw UnexpectedMessageException();
-			if (errcheck == CODE_ERROR) {
-				throw ERRCodeMessageException();
-			}
+	for (; i < max_len && i + 32 <= len; i += 32) {
+		__m256i block =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+		__m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+		                                _mm256_cmpeq_epi8(block, newline));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found));
+		if (mask != 0) {
+			return std::min(i + static_cast<size_t>(__builtin_ctz(mask)),
+			                max_len);
 		}
-		++i;
 	}
+	if (i >= max_len) {
+		return max_len;
+	}
+	// Clears the upper halves first, SSE code is much slower while they are
+	// in use
+	_mm256_zeroupper();
+	return i + find_delimiter_sse2(data + i, len - i, max_len - i);
 }
+#endif
 
+#if defined(__x86_64__)
 /**
- * @brief  Reads a space from the buffer.
- * @param  &buffer: adapter
- * @retval None
+ * @brief  Whether the processor supports AVX2.
+ * @retval true if find_delimiter_avx2 can be called.
  */
-void ProtocolMessage::readSpace(MessageAdapter &buffer) {
-	readChar(buffer, ' ');
+static bool cpu_has_avx2() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
 }
 
+// Checked once, when the program starts
+static const bool use_avx2 = cpu_has_avx2();
+#endif
+
 /**
- * @brief  Reads a delimiter ('\n') from the buffer.
- * @param  &buffer: adapter
- * @retval None
+ * @brief  Finds the first space or delimiter among some bytes with the fastest
+ * search the processor supports. The search is picked with a branch rather
+ * than through a pointer, since an indirect call for every token costs more
+ * than the search itself. Bytes too few for a whole block, such as the last
+ * fields of most requests, go straight to the scalar search.
+ * @param  *data: Bytes to search.
+ * @param  len: Number of bytes.
+ * @param  max_len: Position at which the search stops.
+ * @retval Position of the first space or delimiter, or the smallest of len and
+ * max_len if there is none before it.
  */
-void ProtocolMessage::readDelimiter(MessageAdapter &buffer) {
-	readChar(buffer, '\n');
+static inline size_t find_delimiter(const char *data, size_t len,
+                                    size_t max_len) {
+#if defined(__x86_64__)
+	if (use_avx2 && len >= 32) {
+		return find_delimiter_avx2(data, len, max_len);
+	}
+	if (len >= 16) {
+		return find_delimiter_sse2(data, len, max_len);
+	}
+	return find_delimiter_scalar(data, len, max_len);
+#else
+	return find_delimiter_scalar(data, len, max_len);
+#endif
 }
 
 /**
- * @brief  Reads a string of a maximum size from the buffer. The function will
- * stop reading when it finds a space or a delimiter, even if it is below the
- * max length.
- * @param  &buffer: adapter
- * @retval string read
+ * @brief  Takes the bytes up to the next space or delimiter, which is left to
+ * read, one at a time.
+ * @param  max_len: Max number of bytes taken.
+ * @throws InvalidMessageException if the message ends first.
+ * @retval The bytes, valid until the next call.
  */
-std::string ProtocolMessage::readString(MessageAdapter &buffer,
-                                        uint32_t max_len) {
-	std::string str;
-	for (uint32_t i = 0; i < max_len; i++) {
-		char c = (char) buffer.get();
-		if (!buffer.good()) {
+std::string_view MessageAdapter::getToken(size_t max_len) {
+	_token.clear();
+	for (size_t i = 0; i < max_len; i++) {
+		char c = get();
+		if (!good()) {
 			throw InvalidMessageException();
 		}
 		if (c == ' ' || c == '\n') {
-			// Stops reading
-			buffer.unget();
+			unget();
 			break;
 		}
-		str += c;
+		_token.push_back(c);
 	}
+	return _token;
+}
 
-	return str;
+/**
+ * @brief  Writes the next bytes of the stream to a file, a large block at a
+ * time.
+ * @param  fd: File descriptor.
+ * @param  n: Number of bytes.
+ * @throws InvalidMessageException if the stream ends first.
+ * @throws FileException
+ * @retval None
+ */
+void StreamMessage::copyTo(int fd, size_t n) {
+	size_t chunk = static_cast<size_t>(FILE_COPY_BUFFER_LEN);
+	std::vector<char> buf(std::min(n, chunk));
+	while (n > 0) {
+		size_t len = std::min(n, buf.size());
+		_stream.read(buf.data(), static_cast<std::streamsize>(len));
+		if (static_cast<size_t>(_stream.gcount()) != len) {
+			throw InvalidMessageException();
+		}
+		write_file_data(fd, buf.data(), len);
+		n -= len;
+	}
 }
 
 /**
- * @brief  Reads a userid from the buffer.
- * @param  &buffer: adapter
- * @retval (uint32_t) user_id
+ * @brief  Takes the next n bytes of the message.
+ * @param  n: Number of bytes.
+ * @retval The bytes, fewer if the message ends first (good() is then false).
  */
-uint32_t ProtocolMessage::readUserId(MessageAdapter &buffer) {
-	std::string id_str = readString(buffer, USER_ID_SIZE);
-	return convert_user_id(id_str);
+std::string BufferMessage::getn(int n) {
+	size_t len = static_cast<size_t>(std::max(n, 0));
+	if (len > _data.size() - _pos) {
+		len = _data.size() - _pos;
+		_good = false;
+	}
+	std::string str(_data.substr(_pos, len));
+	_pos += len;
+	return str;
 }
 
 /**
- * @brief  Reads a auction id from the buffer.
- * @param  &buffer: adapter
- * @retval (uint32_t) auction id
+ * @brief  Writes the next bytes of the message to a file.
+ * @param  fd: File descriptor.
+ * @param  n: Number of bytes.
+ * @throws InvalidMessageException if the message ends first.
+ * @throws FileException
+ * @retval None
  */
-uint32_t ProtocolMessage::readAuctionId(MessageAdapter &buffer) {
-	std::string id_str = readString(buffer, AUCTION_ID_SIZE);
-	return convert_auction_id(id_str);
+void BufferMessage::copyTo(int fd, size_t n) {
+	if (n > _data.size() - _pos) {
+		_good = false;
+		throw InvalidMessageException();
+	}
+	write_file_data(fd, _data.data() + _pos, n);
+	_pos += n;
 }
 
 /**
- * @brief  Reads a auction value from the buffer.
- * @param  &buffer: adapter
- * @retval (uint32_t) auction value
+ * @brief  Takes the bytes up to the next space or delimiter, which is left to
+ * read, in place.
+ * @param  max_len: Max number of bytes taken.
+ * @throws InvalidMessageException if the message ends first.
+ * @retval The bytes, valid as long as the message.
  */
-uint32_t ProtocolMessage::readAuctionValue(MessageAdapter &buffer) {
-	std::string value_str = readString(buffer, MAX_AUCTION_VALUE_SIZE);
-	return convert_auction_value(value_str);
+std::string_view BufferMessage::getToken(size_t max_len) {
+	size_t left = _data.size() - _pos;
+	size_t len = find_delimiter(_data.data() + _pos, left, max_len);
+	if (len < max_len && len == left) {
+		_good = false;
+		throw InvalidMessageException();
+	}
+	std::string_view token = _data.substr(_pos, len);
+	_pos += len;
+	return token;
+}
+
+/**
+ * @brief  Reads the next block of the socket after the bytes still to take,
+ * moving them to the start of the buffer if there is no room after them.
+ * @retval Bytes read, 0 or less if the peer closed the connection or the read
+ * failed.
+ */
+ssize_t TcpMessage::readSocket() {
+	if (_start == _end) {
+		_start = 0;
+		_end = 0;
+	} else if (_end == _buffer.size()) {
+		memmove(_buffer.data(), _buffer.data() + _start, _end - _start);
+		_end -= _start;
+		_start = 0;
+		if (_end == _buffer.size()) {
+			_buffer.resize(_buffer.size() + _read_len);
+		}
+	}
+	ssize_t n = read(_fd, _buffer.data() + _end, _buffer.size() - _end);
+	if (n > 0) {
+		_end += static_cast<size_t>(n);
+	}
+	return n;
 }
 
 /**
- * @brief  Reads a password from the buffer.
- * @param  &buffer: adapter
- * @retval (string) password
+ * @brief  Reads the next block of the message from the socket.
+ * @throws MessageReceiveException if nothing was ever read.
+ * @throws InvalidMessageException if the peer stopped sending mid message.
+ * @retval None
  */
-std::string ProtocolMessage::readPassword(MessageAdapter &buffer) {
-	std::string password_str = readString(buffer, PASSWORD_SIZE);
-	return convert_password(password_str);
+void TcpMessage::fillBuffer() {
+	ssize_t n = readSocket();
+	if (n <= 0 && _read) {
+		throw InvalidMessageException();
+	}
+	if (n <= 0) {
+		throw MessageReceiveException();
+	}
+	_read = true;
 }
 
 /**
- * @brief  Reads a pair of auction id and state in a string format from the
- * buffer.
- * @param  &buffer: adapter
- * @retval (sting) 'auction_id state'
+ * @brief  Bytes read from the socket and not taken yet, reading the next block
+ * if there are none. They stay in the buffer until consumed.
+ * @throws MessageReceiveException
+ * @throws InvalidMessageException
+ * @retval At least one byte, valid until the next read.
  */
-std::string ProtocolMessage::readAuctionAndState(MessageAdapter &buffer) {
-	if (checkIfOver(buffer) == true) {
-		return "";
+std::string_view TcpMessage::peek() {
+	if (_start == _end) {
+		fillBuffer();
 	}
+	return std::string_view(_buffer.data() + _start, _end - _start);
+}
 
-	readSpace(buffer);
-	std::string auction_str = readString(buffer, AUCTION_ID_SIZE);
-	readSpace(buffer);
-	std::string state_str = readString(buffer, 1);
-	if (state_str == "1") {
-		state_str = "ACTIVE";
-	} else if (state_str == "0") {
-		state_str = "OVER";
+/**
+ * @brief  Takes bytes returned by peek().
+ * @param  n: Number of bytes, at most the size of the last peek().
+ * @retval None
+ */
+void TcpMessage::consume(size_t n) {
+	if (n == 0) {
+		return;
 	}
-	return "AID: " + auction_str + " --- STATUS: " + state_str;
+	_start += n;
+	_delimited = _buffer[_start - 1] == '\n';
+}
+
+/**
+ * @brief  Takes the next n bytes of the message. The bytes in the buffer are
+ * copied at once and, if many more are missing, they are read from the socket
+ * straight into the string.
+ * @param  n: Number of bytes.
+ * @throws MessageReceiveException
+ * @throws InvalidMessageException if the peer stops sending first.
+ * @retval The bytes.
+ */
+std::string TcpMessage::getn(int n) {
+	size_t len = static_cast<size_t>(std::max(n, 0));
+	std::string str(len, '\0');
+	size_t got = 0;
+	while (got < len) {
+		if (_start == _end && len - got >= _read_len) {
+			ssize_t in = read(_fd, &str[got], len - got);
+			if (in <= 0) {
+				if (_read) {
+					throw InvalidMessageException();
+				}
+				throw MessageReceiveException();
+			}
+			_read = true;
+			got += static_cast<size_t>(in);
+			continue;
+		}
+		std::string_view bytes = peek();
+		size_t taken = std::min(len - got, bytes.size());
+		memcpy(&str[got], bytes.data(), taken);
+		_start += taken;
+		got += taken;
+	}
+	if (len > 0) {
+		_delimited = str.back() == '\n';
+	}
+	return str;
 }
 
 /**
- * @brief  Tries to read a delimiter from the buffer to see if the message has
- * ended.
- * @param  &buffer: adapter
- * * @retval true if the delimiter was found, false otherwise
+ * @brief  Takes the bytes up to the next space or delimiter, which is left to
+ * read. The bytes are taken in place if they were all read from the socket
+ * already.
+ * @param  max_len: Max number of bytes taken.
+ * @throws MessageReceiveException
+ * @throws InvalidMessageException if the peer stops sending first.
+ * @retval The bytes, valid until the next call.
  */
-bool ProtocolMessage::checkIfOver(MessageAdapter &buffer) {
-	char c = '\n';
-	if (readChar(buffer) == c) {
-		buffer.unget();
-		return true;
-	} else {
-		buffer.unget();
-		return false;
+std::string_view TcpMessage::getToken(size_t max_len) {
+	std::string_view bytes = peek();
+	size_t len = find_delimiter(bytes.data(), bytes.size(), max_len);
+	if (len < max_len && len == bytes.size()) {
+		return MessageAdapter::getToken(max_len);  // Split between reads
 	}
+	_start += len;
+	_delimited = false;
+	return bytes.substr(0, len);
 }
 
 /**
- * @brief  Reads a date in format Datetime from the buffer.
- * @param  &buffer: adapter
- * @retval (Datetime) date and time
+ * @brief  Waits for the next message of a persistent connection.
+ * @retval true if the peer closed the connection or the read timed out.
  */
-Datetime ProtocolMessage::readDate(MessageAdapter &buffer) {
-	Datetime date;
-	date.year = readString(buffer, 4);
-	readChar(buffer, '-');
-	date.month = readString(buffer, 2);
-	readChar(buffer, '-');
-	date.day = readString(buffer, 2);
-	readChar(buffer, ' ');
-	date.hours = readString(buffer, 2);
-	readChar(buffer, ':');
-	date.minutes = readString(buffer, 2);
-	readChar(buffer, ':');
-	date.seconds = readString(buffer, 2);
-	return date;
+bool TcpMessage::closed() {
+	if (_start != _end) {
+		return false;
+	}
+	return readSocket() <= 0;
 }
 
 /**
- * @brief  Reads file data of specified size from the buffer.
- * @param  &buffer: adapter
- * @retval (string) file data
+ * @brief  Writes the next bytes of the message to a file. The bytes already
+ * read from the socket are written first, the rest is moved from the socket
+ * to the file through a pipe with splice(), so it never goes through user
+ * space. Falls back to reading and writing if the file doesn't support it.
+ * @param  fd: File descriptor.
+ * @param  n: Number of bytes.
+ * @throws InvalidMessageException if the peer stops sending first.
+ * @throws FileException
+ * @retval None
  */
-std::string ProtocolMessage::readFile(MessageAdapter &buffer,
-                                      uint32_t max_len) {
-	if (max_len > MAX_FILE_SIZE) {
-		throw FileException();
-		return "";
+void TcpMessage::copyTo(int fd, size_t n) {
+	size_t buffered = std::min(n, _end - _start);
+	write_file_data(fd, _buffer.data() + _start, buffered);
+	_start += buffered;
+	n -= buffered;
+	_read = true;
+	_delimited = false;
+
+	size_t chunk = static_cast<size_t>(FILE_COPY_BUFFER_LEN);
+	int pipe_fds[2];
+	if (n > 0 && pipe2(pipe_fds, O_CLOEXEC) == 0) {
+		while (n > 0) {
+			ssize_t in = splice(_fd, NULL, pipe_fds[1], NULL,
+			                    std::min(n, chunk), SPLICE_F_MOVE);
+			if (in < 0 && errno == EINTR) {
+				continue;
+			}
+			if (in < 0 && errno == EINVAL) {
+				break;  // Not supported, the pipe is empty
+			}
+			if (in <= 0) {
+				close(pipe_fds[0]);
+				close(pipe_fds[1]);
+				throw InvalidMessageException();
+			}
+			size_t pending = static_cast<size_t>(in);
+			while (pending > 0) {
+				ssize_t out = splice(pipe_fds[0], NULL, fd, NULL, pending,
+				                     SPLICE_F_MOVE);
+				if (out < 0 && errno == EINTR) {
+					continue;
+				}
+				if (out <= 0) {
+					close(pipe_fds[0]);
+					close(pipe_fds[1]);
+					throw FileException();
+				}
+				pending -= static_cast<size_t>(out);
+			}
+			n -= static_cast<size_t>(in);
+		}
+		close(pipe_fds[0]);
+		close(pipe_fds[1]);
 	}
 
-	std::string str;
-	for (uint32_t i = 0; i < max_len; i++) {
-		char c = (char) buffer.get();
-		if (!buffer.good()) {
+	std::vector<char> buf(std::min(n, chunk));
+	while (n > 0) {
+		ssize_t in = read(_fd, buf.data(), std::min(n, buf.size()));
+		if (in < 0 && errno == EINTR) {
+			continue;
+		}
+		if (in <= 0) {
 			throw InvalidMessageException();
 		}
-		str += c;
+		write_file_data(fd, buf.data(), static_cast<size_t>(in));
+		n -= static_cast<size_t>(in);
 	}
-
-	return str;
 }
 
 // -----------------------------------
-// | Types of protocol messages		 |
+// | Message writer					 |
 // -----------------------------------
 
-// ---------- LOGIN
+/**
+ * @brief  Makes room for more bytes, moving the message to a string if the
+ * buffer of the caller is full.
+ * @param  n: Number of bytes.
+ * @retval None
+ */
+void MessageWriter::reserve(size_t n) {
+	if (_len + n <= _capacity) {
+		return;
+	}
+	size_t capacity = std::max(2 * _capacity, _len + n);
+	if (_data != _overflow.data()) {
+		_overflow.assign(_data, _len);
+	}
+	_overflow.resize(capacity);
+	_data = _overflow.data();
+	_capacity = capacity;
+}
+
+/**
+ * @brief  Writes a character.
+ * @param  c: Character.
+ * @retval The writer.
+ */
+MessageWriter &MessageWriter::operator<<(char c) {
+	reserve(1);
+	_data[_len++] = c;
+	return *this;
+}
 
 /**
- * @brief  Serializes a message of a Login request made by the client.
- * @retval (stringstream) Serialized message
+ * @brief  Writes text.
+ * @param  text: Text.
+ * @retval The writer.
  */
-std::stringstream ClientLoginUser::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << " " << password << std::endl;
-	return buffer;
+MessageWriter &MessageWriter::operator<<(std::string_view text) {
+	reserve(text.size());
+	memcpy(_data + _len, text.data(), text.size());
+	_len += text.size();
+	return *this;
 }
 
 /**
- * @brief  Reads a message of a Login request made by the client.
- * @retval None
+ * @brief  Writes text.
+ * @param  *text: Null terminated text.
+ * @retval The writer.
  */
-void ClientLoginUser::readMessage(MessageAdapter &buffer) {
-	// Server already read the message ID
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readSpace(buffer);
-	password = readPassword(buffer);
-	readDelimiter(buffer);
+MessageWriter &MessageWriter::operator<<(const char *text) {
+	return *this << std::string_view(text);
 }
 
 /**
- * @brief  Serializes a message of a Login answer made by the server.
- * @retval (stringstream) Serialized message
+ * @brief  Writes a number in decimal.
+ * @param  number: Number.
+ * @retval The writer.
  */
-std::stringstream ServerLoginUser::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
-	if (status == ServerLoginUser::status::OK) {
-		buffer << "OK";
-	} else if (status == ServerLoginUser::status::NOK) {
-		buffer << "NOK";
-	} else if (status == ServerLoginUser::status::REG) {
-		buffer << "REG";
-	} else if (status == ServerLoginUser::status::ERR) {
-		buffer << "ERR";
-	} else {
-		throw MessageBuildingException();
-	}
-	buffer << std::endl;
-	return buffer;
+MessageWriter &MessageWriter::operator<<(uint32_t number) {
+	return *this << static_cast<uint64_t>(number);
+}
+
+/**
+ * @brief  Writes a number in decimal.
+ * @param  number: Number.
+ * @retval The writer.
+ */
+MessageWriter &MessageWriter::operator<<(uint64_t number) {
+	return *this << ZeroPadded{number, 0};
+}
+
+/**
+ * @brief  Writes a number in decimal with leading zeros.
+ * @param  padded: Number and width.
+ * @retval The writer.
+ */
+MessageWriter &MessageWriter::operator<<(ZeroPadded padded) {
+	char digits[20];
+	std::to_chars_result result =
+		std::to_chars(digits, digits + sizeof(digits), padded.number);
+	size_t len = static_cast<size_t>(result.ptr - digits);
+	size_t zeros = padded.width > len ? padded.width - len : 0;
+	reserve(zeros + len);
+	memset(_data + _len, '0', zeros);
+	memcpy(_data + _len + zeros, digits, len);
+	_len += zeros + len;
+	return *this;
+}
+
+/**
+ * @brief  Writes a date as 'YYYY-MM-DD HH:MM:SS'.
+ * @param  &date: Date.
+ * @retval The writer.
+ */
+MessageWriter &MessageWriter::operator<<(const Datetime &date) {
+	return *this << date.year << '-' << date.month << '-' << date.day << ' '
+	             << date.hours << ':' << date.minutes << ':' << date.seconds;
 }
 
 /**
- * @brief  Reads a message of a Login answer made by the server.
+ * @brief  Adds file data to the message without copying it. It is copied
+ * after all if the message already has MESSAGE_MAX_PAYLOADS of them.
+ * @param  payload: File data, must outlive the writer.
  * @retval None
  */
-void ServerLoginUser::readMessage(MessageAdapter &buffer) {
-	readMessageId(buffer, ServerLoginUser::protocol_code);
-	readSpace(buffer);
-	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
-	if (status_str == "OK") {
-		status = OK;
-	} else if (status_str == "NOK") {
-		status = NOK;
-	} else if (status_str == "REG") {
-		status = REG;
-	} else if (status_str == "ERR") {
-		status = ERR;
-	} else {
-		throw InvalidMessageException();
+void MessageWriter::writePayload(std::string_view payload) {
+	if (_payload_count == MESSAGE_MAX_PAYLOADS) {
+		*this << payload;
+		return;
 	}
-	readDelimiter(buffer);
+	_payloads[_payload_count] = payload;
+	_payload_at[_payload_count] = _len;
+	_payload_count++;
+	_payload_len += payload.size();
 }
 
-// ---------- LOGOUT
+/**
+ * @brief  Size of the message.
+ * @retval Number of bytes.
+ */
+size_t MessageWriter::size() {
+	return _len + _payload_len;
+}
 
 /**
- * @brief  Serializes a message of a Logout request made by the client.
- * @retval (stringstream) Serialized message
+ * @brief  Points iovecs at the parts of the message, in order.
+ * @param  *iov: At least MESSAGE_MAX_IOVECS iovecs.
+ * @retval Number of iovecs used.
  */
-std::stringstream ClientLogout::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << " " << password << std::endl;
-	return buffer;
+size_t MessageWriter::iovecs(struct iovec *iov) {
+	size_t count = 0;
+	size_t at = 0;
+	for (size_t i = 0; i < _payload_count; i++) {
+		if (_payload_at[i] > at) {
+			iov[count].iov_base = _data + at;
+			iov[count].iov_len = _payload_at[i] - at;
+			count++;
+			at = _payload_at[i];
+		}
+		iov[count].iov_base = const_cast<char *>(_payloads[i].data());
+		iov[count].iov_len = _payloads[i].size();
+		count++;
+	}
+	if (_len > at || count == 0) {
+		iov[count].iov_base = _data + at;
+		iov[count].iov_len = _len - at;
+		count++;
+	}
+	return count;
 }
 
 /**
- * @brief  Reads a message of a Logout request made by the client.
+ * @brief  Appends the message to a string.
+ * @param  &out: String.
  * @retval None
  */
-void ClientLogout::readMessage(MessageAdapter &buffer) {
-	// Serverbound messages don't read their ID
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readSpace(buffer);
-	password = readPassword(buffer);
-	readDelimiter(buffer);
+void MessageWriter::appendTo(std::string &out) {
+	struct iovec iov[MESSAGE_MAX_IOVECS];
+	size_t count = iovecs(iov);
+	out.reserve(out.size() + size());
+	for (size_t i = 0; i < count; i++) {
+		out.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+	}
 }
 
 /**
- * @brief  Serializes a message of a Logout answer made by the server.
- * @retval (stringstream) Serialized message
+ * @brief  Copies the message to a string.
+ * @retval The message.
  */
-std::stringstream ServerLogout::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
-	if (status == ServerLogout::status::OK) {
-		buffer << "OK";
-	} else if (status == ServerLogout::status::NOK) {
-		buffer << "NOK";
-	} else if (status == ServerLogout::status::UNR) {
-		buffer << "UNR";
-	} else if (status == ServerLogout::status::ERR) {
-		buffer << "ERR";
-	} else {
-		throw MessageBuildingException();
-	}
-	buffer << std::endl;
-	return buffer;
+std::string MessageWriter::str() {
+	std::string out;
+	appendTo(out);
+	return out;
 }
 
+// -----------------------------------
+// | Reading functions				 |
+// -----------------------------------
+
 /**
- * @brief  Reads a message of a Logout answer made by the server.
+ * @brief  Reads a messageID from the buffer and compares it to a given protocol
+ * code expecting them to be equal.
+ * @param  &buffer: adapter
+ * @throws UnexpectedMessageException
+ * @throws ERRCodeMessageException
  * @retval None
  */
-void ServerLogout::readMessage(MessageAdapter &buffer) {
-	readMessageId(buffer, ServerLogout::protocol_code);
-	readSpace(buffer);
-	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
-	if (status_str == "OK") {
-		status = OK;
-	} else if (status_str == "NOK") {
-		status = NOK;
-	} else if (status_str == "UNR") {
-		status = UNR;
-	} else if (status_str == "ERR") {
-		status = ERR;
-	} else {
-		throw InvalidMessageException();
+template <typename Adapter>
+void ProtocolMessage::readMessageId(Adapter &buffer,
+                                    std::string protocol_code) {
+	char current_char;
+	std::string errcheck;
+	size_t i = 0;
+	while (protocol_code[i] != '\0') {
+		current_char = readChar(buffer);
+		errcheck += current_char;
+		if (!buffer.good() || current_char != protocol_code[i]) {
+			throw UnexpectedMessageException();
+			if (errcheck == CODE_ERROR) {
+				throw ERRCodeMessageException();
+			}
+		}
+		++i;
 	}
-	readDelimiter(buffer);
 }
 
-// ---------- UNREGISTER
+/**
+ * @brief  Reads a string of a maximum size from the buffer. The function will
+ * stop reading when it finds a space or a delimiter, even if it is below the
+ * max length.
+ * @param  &buffer: adapter
+ * @retval string read
+ */
+template <typename Adapter>
+std::string ProtocolMessage::readString(Adapter &buffer, uint32_t max_len) {
+	return std::string(readToken(buffer, max_len));
+}
 
 /**
- * @brief  Serializes a message of a Unregister request made by the client.
- * @retval (stringstream) Serialized message
+ * @brief  Reads a userid from the buffer.
+ * @param  &buffer: adapter
+ * @retval (uint32_t) user_id
  */
-std::stringstream ClientUnregister::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << " " << password << std::endl;
-	return buffer;
+template <typename Adapter>
+uint32_t ProtocolMessage::readUserId(Adapter &buffer) {
+	return convert_user_id(readToken(buffer, USER_ID_SIZE));
 }
 
 /**
- * @brief  Reads a message of a Unregister request made by the client.
- * @retval None
+ * @brief  Reads a auction id from the buffer.
+ * @param  &buffer: adapter
+ * @retval (uint32_t) auction id
+ */
+template <typename Adapter>
+uint32_t ProtocolMessage::readAuctionId(Adapter &buffer) {
+	return convert_auction_id(readToken(buffer, AUCTION_ID_SIZE));
+}
+
+/**
+ * @brief  Reads a auction value from the buffer.
+ * @param  &buffer: adapter
+ * @retval (uint32_t) auction value
  */
-void ClientUnregister::readMessage(MessageAdapter &buffer) {
-	// Serverbound packets don't read their ID
+template <typename Adapter>
+uint32_t ProtocolMessage::readAuctionValue(Adapter &buffer) {
+	return convert_auction_value(readToken(buffer, MAX_AUCTION_VALUE_SIZE));
+}
+
+/**
+ * @brief  Reads a password from the buffer.
+ * @param  &buffer: adapter
+ * @retval (string) password
+ */
+template <typename Adapter>
+std::string ProtocolMessage::readPassword(Adapter &buffer) {
+	return convert_password(readToken(buffer, PASSWORD_SIZE));
+}
+
+/**
+ * @brief  Reads a pair of auction id and state in a string format from the
+ * buffer.
+ * @param  &buffer: adapter
+ * @retval (sting) 'auction_id state'
+ */
+template <typename Adapter>
+std::string ProtocolMessage::readAuctionAndState(Adapter &buffer) {
+	if (checkIfOver(buffer) == true) {
+		return "";
+	}
+
 	readSpace(buffer);
-	user_id = readUserId(buffer);
+	std::string auction_str = readString(buffer, AUCTION_ID_SIZE);
 	readSpace(buffer);
-	password = readPassword(buffer);
-	readDelimiter(buffer);
+	std::string state_str = readString(buffer, 1);
+	if (state_str == "1") {
+		state_str = "ACTIVE";
+	} else if (state_str == "0") {
+		state_str = "OVER";
+	}
+	return "AID: " + auction_str + " --- STATUS: " + state_str;
+}
+
+/**
+ * @brief  Tries to read a delimiter from the buffer to see if the message has
+ * ended.
+ * @param  &buffer: adapter
+ * * @retval true if the delimiter was found, false otherwise
+ */
+template <typename Adapter>
+bool ProtocolMessage::checkIfOver(Adapter &buffer) {
+	char c = '\n';
+	if (readChar(buffer) == c) {
+		buffer.unget();
+		return true;
+	} else {
+		buffer.unget();
+		return false;
+	}
+}
+
+/**
+ * @brief  Reads a date in format Datetime from the buffer.
+ * @param  &buffer: adapter
+ * @retval (Datetime) date and time
+ */
+template <typename Adapter>
+Datetime ProtocolMessage::readDate(Adapter &buffer) {
+	Datetime date;
+	date.year = readString(buffer, 4);
+	readChar(buffer, '-');
+	date.month = readString(buffer, 2);
+	readChar(buffer, '-');
+	date.day = readString(buffer, 2);
+	readChar(buffer, ' ');
+	date.hours = readString(buffer, 2);
+	readChar(buffer, ':');
+	date.minutes = readString(buffer, 2);
+	readChar(buffer, ':');
+	date.seconds = readString(buffer, 2);
+	return date;
 }
 
 /**
- * @brief  Serializes a message of a Unregister answer made by the server.
- * @retval (stringstream) Serialized message
+ * @brief  Reads file data of specified size from the buffer.
+ * @param  &buffer: adapter
+ * @retval (string) file data
  */
-std::stringstream ServerUnregister::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
-	if (status == ServerUnregister::status::OK) {
-		buffer << "OK";
-	} else if (status == ServerUnregister::status::NOK) {
-		buffer << "NOK";
-	} else if (status == ServerUnregister::status::UNR) {
-		buffer << "UNR";
-	} else if (status == ServerUnregister::status::ERR) {
-		buffer << "ERR";
-	} else {
-		throw MessageBuildingException();
+template <typename Adapter>
+std::string ProtocolMessage::readFile(Adapter &buffer, uint32_t max_len) {
+	if (max_len > MAX_FILE_SIZE) {
+		throw FileException();
+		return "";
 	}
-	buffer << std::endl;
-	return buffer;
-}
 
-/**
- * @brief  Reads a message of a Unregister answer made by the server.
- * @retval None
- */
-void ServerUnregister::readMessage(MessageAdapter &buffer) {
-	readMessageId(buffer, ServerUnregister::protocol_code);
-	readSpace(buffer);
-	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
-	if (status_str == "OK") {
-		status = OK;
-	} else if (status_str == "NOK") {
-		status = NOK;
-	} else if (status_str == "UNR") {
-		status = UNR;
-	} else if (status_str == "ERR") {
-		status = ERR;
-	} else {
+	std::string str = buffer.getn(static_cast<int>(max_len));
+	if (!buffer.good()) {
 		throw InvalidMessageException();
 	}
-	readDelimiter(buffer);
+
+	return str;
 }
 
-// ---------- LIST MYAUCTIONS
+// Instantiates the read functions defined here for an adapter
+#define INSTANTIATE_READ_FUNCTIONS(Adapter)                                   \
+	template void ProtocolMessage::readMessageId(Adapter &, std::string);     \
+	template std::string ProtocolMessage::readString(Adapter &, uint32_t);    \
+	template uint32_t ProtocolMessage::readUserId(Adapter &);                 \
+	template uint32_t ProtocolMessage::readAuctionId(Adapter &);              \
+	template uint32_t ProtocolMessage::readAuctionValue(Adapter &);           \
+	template std::string ProtocolMessage::readPassword(Adapter &);            \
+	template std::string ProtocolMessage::readAuctionAndState(Adapter &);     \
+	template bool ProtocolMessage::checkIfOver(Adapter &);                    \
+	template Datetime ProtocolMessage::readDate(Adapter &);                   \
+	template std::string ProtocolMessage::readFile(Adapter &, uint32_t);
+
+INSTANTIATE_READ_FUNCTIONS(MessageAdapter)
+INSTANTIATE_READ_FUNCTIONS(StreamMessage)
+INSTANTIATE_READ_FUNCTIONS(BufferMessage)
+INSTANTIATE_READ_FUNCTIONS(TcpMessage)
 
-/**
- * @brief  Serializes a message of a List My Auctions request made by the
- * client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientListStartedAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << std::endl;
-	return buffer;
-}
+// -----------------------------------
+// | Types of protocol messages		 |
+// -----------------------------------
 
-/**
- * @brief  Reads a message of a List My Auctions request made by the client.
- * @retval None
- */
-void ClientListStartedAuctions::readMessage(MessageAdapter &buffer) {
-	// Serverbound packets don't read their ID
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readDelimiter(buffer);
-}
+// ---------- LIST MYAUCTIONS
 
 /**
  * @brief  Serializes a message of a List My Auctions answer made by the
  * server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerListStartedAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerListStartedAuctions::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerListStartedAuctions::status::OK) {
-		buffer << "OK";
-		for (std::string auction : auctions) {
-			buffer << " " << auction;
+		writer << "OK";
+		for (const std::string &auction : auctions) {
+			writer << " " << auction;
 		}
 	} else if (status == ServerListStartedAuctions::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
 	} else if (status == ServerListStartedAuctions::status::NLG) {
-		buffer << "NLG";
+		writer << "NLG";
 	} else if (status == ServerListStartedAuctions::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a List My Auctions answer made by the server.
  * @retval None
  */
-void ServerListStartedAuctions::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerListStartedAuctions::readFields(Adapter &buffer) {
 	readMessageId(buffer, ServerListStartedAuctions::protocol_code);
 	readSpace(buffer);
 	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
@@ -540,59 +899,47 @@ void ServerListStartedAuctions::readMessage(MessageAdapter &buffer) {
 	readDelimiter(buffer);
 }
 
-// ---------- LIST MYBIDDEDAUCTIONS
-
-/**
- * @brief  Serializes a message of a List My Bids request made by the client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientListBiddedAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << std::endl;
-	return buffer;
-}
-
 /**
- * @brief  Reads a message of a List My Bids request made by the client.
+ * @brief  Reads a message of a List My Auctions answer made by the server,
+ * through the concrete type of the adapter.
  * @retval None
  */
-void ClientListBiddedAuctions::readMessage(MessageAdapter &buffer) {
-	// Serverbound packets don't read their ID
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readDelimiter(buffer);
+void ServerListStartedAuctions::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
 }
 
+// ---------- LIST MYBIDDEDAUCTIONS
+
 /**
  * @brief  Serializes a message of a List My Bids answer made by the server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerListBiddedAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerListBiddedAuctions::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerListBiddedAuctions::status::OK) {
-		buffer << "OK";
-		for (std::string auction : auctions) {
-			buffer << " " << auction;
+		writer << "OK";
+		for (const std::string &auction : auctions) {
+			writer << " " << auction;
 		}
 	} else if (status == ServerListBiddedAuctions::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
 	} else if (status == ServerListBiddedAuctions::status::NLG) {
-		buffer << "NLG";
+		writer << "NLG";
 	} else if (status == ServerListBiddedAuctions::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a List My Bids answer made by the server.
  * @retval None
  */
-void ServerListBiddedAuctions::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerListBiddedAuctions::readFields(Adapter &buffer) {
 	readMessageId(buffer, ServerListBiddedAuctions::protocol_code);
 	readSpace(buffer);
 	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
@@ -617,57 +964,46 @@ void ServerListBiddedAuctions::readMessage(MessageAdapter &buffer) {
 	readDelimiter(buffer);
 }
 
-// ---------- LIST ALL AUCTIONS
-
-/**
- * @brief  Serializes a message of a List All Auctions request made by the
- * client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientListAllAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << std::endl;
-	return buffer;
-}
-
 /**
- * @brief  Reads a message of a List My Auctions request made by the client.
+ * @brief  Reads a message of a List My Bids answer made by the server, through
+ * the concrete type of the adapter.
  * @retval None
  */
-void ClientListAllAuctions::readMessage(MessageAdapter &buffer) {
-	// Serverbound packets don't read their ID
-	readDelimiter(buffer);
+void ServerListBiddedAuctions::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
 }
 
+// ---------- LIST ALL AUCTIONS
+
 /**
  * @brief  Serializes a message of a List All Auctions answer made by the
  * server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerListAllAuctions::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerListAllAuctions::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerListAllAuctions::status::OK) {
-		buffer << "OK";
-		for (std::string auction : auctions) {
-			buffer << " " << auction;
+		writer << "OK";
+		for (const std::string &auction : auctions) {
+			writer << " " << auction;
 		}
 	} else if (status == ServerListAllAuctions::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
 	} else if (status == ServerListAllAuctions::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a List All Auctions answer made by the server.
  * @retval None
  */
-void ServerListAllAuctions::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerListAllAuctions::readFields(Adapter &buffer) {
 	readMessageId(buffer, ServerListAllAuctions::protocol_code);
 	readSpace(buffer);
 	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
@@ -690,71 +1026,58 @@ void ServerListAllAuctions::readMessage(MessageAdapter &buffer) {
 	readDelimiter(buffer);
 }
 
-// ---------- SHOW RECORD
-
-/**
- * @brief  Serializes a message of a Show Record request made by the client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientShowRecord::buildMessage() {
-	std::stringstream buffer;
-	char aid[4];
-	sprintf(aid, "%03d", auction_id);
-	buffer << protocol_code << " " << aid << std::endl;
-	return buffer;
-}
-
 /**
- * @brief  Reads a message of a Show Record request made by the client.
+ * @brief  Reads a message of a List All Auctions answer made by the server,
+ * through the concrete type of the adapter.
  * @retval None
  */
-void ClientShowRecord::readMessage(MessageAdapter &buffer) {
-	readSpace(buffer);
-	auction_id = readAuctionId(buffer);
-	readDelimiter(buffer);
+void ServerListAllAuctions::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
 }
 
+// ---------- SHOW RECORD
+
 /**
  * @brief  Serializes a message of a Show Record answer made by the server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerShowRecord::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerShowRecord::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerShowRecord::status::OK) {
-		buffer << "OK ";
-		buffer << host_UID;
-		buffer << " " << auction_name;
-		buffer << " " << asset_fname;
-		buffer << " " << start_value;
-		buffer << " " << convert_date_to_str(start_date_time);
-		buffer << " " << timeactive;
-		for (Bid bid : bids) {
-			buffer << " B " << bid.bidder_UID;
-			buffer << " " << bid.bid_value;
-			buffer << " " << convert_date_to_str(bid.bid_date_time);
-			buffer << " " << bid.bid_sec_time;
+		writer << "OK ";
+		writer << host_UID;
+		writer << " " << auction_name;
+		writer << " " << asset_fname;
+		writer << " " << start_value;
+		writer << " " << start_date_time;
+		writer << " " << timeactive;
+		for (const Bid &bid : bids) {
+			writer << " B " << bid.bidder_UID;
+			writer << " " << bid.bid_value;
+			writer << " " << bid.bid_date_time;
+			writer << " " << bid.bid_sec_time;
 		}
 		if (end_sec_time > 0) {
-			buffer << " E " << convert_date_to_str(end_date_time);
-			buffer << " " << end_sec_time;
+			writer << " E " << end_date_time;
+			writer << " " << end_sec_time;
 		}
 	} else if (status == ServerShowRecord::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
 	} else if (status == ServerShowRecord::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a Show Record answer made by the server.
  * @retval None
  */
-void ServerShowRecord::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerShowRecord::readFields(Adapter &buffer) {
 	bool skip;
 	readMessageId(buffer, ServerShowRecord::protocol_code);
 	readSpace(buffer);
@@ -813,25 +1136,57 @@ void ServerShowRecord::readMessage(MessageAdapter &buffer) {
 	}
 }
 
+/**
+ * @brief  Reads a message of a Show Record answer made by the server, through
+ * the concrete type of the adapter.
+ * @retval None
+ */
+void ServerShowRecord::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
+}
+
 // ---------- OPEN AUCTION
 
 /**
  * @brief  Serializes a message of a Open Auction request made by the client.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ClientOpenAuction::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " " << user_id << " " << password << " " << name
-		   << " " << start_value << " " << timeactive << " " << assetf_name
-		   << " " << Fsize << " " << fdata << std::endl;
-	return buffer;
+void ClientOpenAuction::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " " << user_id << " " << password << " " << name
+	       << " " << start_value << " " << timeactive << " " << assetf_name
+	       << " " << Fsize << " ";
+	writer.writePayload(fdata);
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a Open Auction request made by the client.
  * @retval None
  */
+template <typename Adapter>
+void ClientOpenAuction::readFields(Adapter &buffer) {
+	readHeaderFields(buffer);
+	fdata = readFile(buffer, static_cast<uint32_t>(Fsize));
+	readDelimiter(buffer);
+}
+
+/**
+ * @brief  Reads a message of a Open Auction request made by the client, through
+ * the concrete type of the adapter.
+ * @retval None
+ */
 void ClientOpenAuction::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
+}
+
+/**
+ * @brief  Reads a message of a Open Auction request made by the client up to
+ * the file data, so that the file data can be written to disk as it arrives.
+ * @retval None
+ */
+template <typename Adapter>
+void ClientOpenAuction::readHeaderFields(Adapter &buffer) {
 	readSpace(buffer);
 	user_id = readUserId(buffer);
 	readSpace(buffer);
@@ -848,37 +1203,63 @@ void ClientOpenAuction::readMessage(MessageAdapter &buffer) {
 	readSpace(buffer);
 	Fsize = (size_t) stol(readString(buffer, MAX_FILE_SIZE_LENGTH));
 	readSpace(buffer);
-	fdata = readFile(buffer, static_cast<uint32_t>(Fsize));
+}
+
+/**
+ * @brief  Reads the header of an Open Auction request, through the concrete
+ * type of the adapter.
+ * @retval None
+ */
+void ClientOpenAuction::readHeader(MessageAdapter &buffer) {
+	visit_adapter(buffer,
+	              [this](auto &adapter) { readHeaderFields(adapter); });
+}
+
+/**
+ * @brief  Reads the file data of a Open Auction request straight into a file,
+ * after readHeader, and the end of the message.
+ * @param  fd: File the data is written to, -1 if the data was already
+ * received apart from the message.
+ * @throws FileException if the file is too big or can't be written.
+ * @retval None
+ */
+void ClientOpenAuction::readAsset(MessageAdapter &buffer, int fd) {
+	if (fd != -1) {
+		if (Fsize > MAX_FILE_SIZE) {
+			throw FileException();
+		}
+		buffer.copyTo(fd, Fsize);
+	}
 	readDelimiter(buffer);
 }
 
 /**
  * @brief  Serializes a message of a Open Auction answer made by the server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerOpenAuction::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerOpenAuction::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerOpenAuction::status::OK) {
-		char aid[4];
-		sprintf(aid, "%03d", auction_id);
-		buffer << "OK " << aid;
+		writer << "OK " << ZeroPadded{auction_id, AUCTION_ID_SIZE};
 	} else if (status == ServerOpenAuction::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
+	} else if (status == ServerOpenAuction::status::NLG) {
+		writer << "NLG";
 	} else if (status == ServerOpenAuction::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
 }
 
 /**
  * @brief  Reads a message of a Open Auction answer made by the server.
  * @retval None
  */
-void ServerOpenAuction::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerOpenAuction::readFields(Adapter &buffer) {
 	readMessageId(buffer, ServerOpenAuction::protocol_code);
 	readSpace(buffer);
 	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
@@ -890,6 +1271,9 @@ void ServerOpenAuction::readMessage(MessageAdapter &buffer) {
 	} else if (status_str == "NOK") {
 		status = NOK;
 		readDelimiter(buffer);
+	} else if (status_str == "NLG") {
+		status = NLG;
+		readDelimiter(buffer);
 	} else if (status_str == "ERR") {
 		status = ERR;
 		readDelimiter(buffer);
@@ -898,140 +1282,54 @@ void ServerOpenAuction::readMessage(MessageAdapter &buffer) {
 	}
 }
 
-// ---------- CLOSE AUCTION
-
-/**
- * @brief  Serializes a message of a Close Auction request made by the client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientCloseAuction::buildMessage() {
-	std::stringstream buffer;
-	char aid[4];
-	sprintf(aid, "%03d", auction_id);
-	buffer << protocol_code << " " << user_id << " " << password << " " << aid
-		   << std::endl;
-	return buffer;
-}
-
-/**
- * @brief  Reads a message of a Close Auction request made by the client.
- * @retval None
- */
-void ClientCloseAuction::readMessage(MessageAdapter &buffer) {
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readSpace(buffer);
-	password = readPassword(buffer);
-	readSpace(buffer);
-	auction_id = readAuctionId(buffer);
-	readDelimiter(buffer);
-}
-
-/**
- * @brief  Serializes a message of a Close Auction answer made by the server.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ServerCloseAuction::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
-	if (status == ServerCloseAuction::status::OK) {
-		buffer << "OK";
-	} else if (status == ServerCloseAuction::status::NLG) {
-		buffer << "NLG";
-	} else if (status == ServerCloseAuction::status::EAU) {
-		buffer << "EAU";
-	} else if (status == ServerCloseAuction::status::EOW) {
-		buffer << "EOW";
-	} else if (status == ServerCloseAuction::status::END) {
-		buffer << "END";
-	} else if (status == ServerCloseAuction::status::NOK) {
-		buffer << "NOK";
-	} else if (status == ServerCloseAuction::status::ERR) {
-		buffer << "ERR";
-	} else {
-		throw MessageBuildingException();
-	}
-	buffer << std::endl;
-	return buffer;
-}
-
 /**
- * @brief  Reads a message of a Close Auction answer made by the server.
+ * @brief  Reads a message of a Open Auction answer made by the server, through
+ * the concrete type of the adapter.
  * @retval None
  */
-void ServerCloseAuction::readMessage(MessageAdapter &buffer) {
-	readMessageId(buffer, ServerCloseAuction::protocol_code);
-	readSpace(buffer);
-	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
-	readDelimiter(buffer);
-	if (status_str == "OK") {
-		status = OK;
-	} else if (status_str == "NLG") {
-		status = NLG;
-	} else if (status_str == "EAU") {
-		status = EAU;
-	} else if (status_str == "EOW") {
-		status = EOW;
-	} else if (status_str == "END") {
-		status = END;
-	} else if (status_str == "NOK") {
-		status = NOK;
-	} else if (status_str == "ERR") {
-		status = ERR;
-	} else {
-		throw InvalidMessageException();
-	}
+void ServerOpenAuction::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
 }
 
 // ---------- SHOW ASSET
 
-/**
- * @brief  Serializes a message of a Show Asset request made by the client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientShowAsset::buildMessage() {
-	std::stringstream buffer;
-	char aid[4];
-	sprintf(aid, "%03d", auction_id);
-	buffer << protocol_code << " " << aid << std::endl;
-	return buffer;
-}
-
-/**
- * @brief  Reads a message of a Show Asset request made by the client.
- * @retval None
- */
-void ClientShowAsset::readMessage(MessageAdapter &buffer) {
-	readSpace(buffer);
-	auction_id = readAuctionId(buffer);
-	readDelimiter(buffer);
-}
-
 /**
  * @brief  Serializes a message of a Show Asset answer made by the server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerShowAsset::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
+void ServerShowAsset::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << " ";
 	if (status == ServerShowAsset::status::OK) {
-		buffer << "OK " << fname << " " << fsize << " " << fdata;
+		writer << "OK " << fname << " " << fsize << " ";
+		writer.writePayload(fdata);
 	} else if (status == ServerShowAsset::status::NOK) {
-		buffer << "NOK";
+		writer << "NOK";
 	} else if (status == ServerShowAsset::status::ERR) {
-		buffer << "ERR";
+		writer << "ERR";
 	} else {
 		throw MessageBuildingException();
 	}
-	buffer << std::endl;
-	return buffer;
+	writer << '\n';
+}
+
+/**
+ * @brief  Serializes the part of an OK Show Asset answer before the file data,
+ * so that the file can be sent on its own after it. The answer ends with a
+ * delimiter after the file data.
+ * @param  &writer: Where the header is written.
+ * @retval None
+ */
+void ServerShowAsset::buildHeader(MessageWriter &writer) {
+	writer << protocol_code << " OK " << fname << " " << fsize << " ";
 }
 
 /**
  * @brief  Reads a message of a Show Asset answer made by the server.
  * @retval None
  */
-void ServerShowAsset::readMessage(MessageAdapter &buffer) {
+template <typename Adapter>
+void ServerShowAsset::readFields(Adapter &buffer) {
 	readMessageId(buffer, ServerShowAsset::protocol_code);
 	readSpace(buffer);
 	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
@@ -1056,104 +1354,24 @@ void ServerShowAsset::readMessage(MessageAdapter &buffer) {
 	}
 }
 
-// ---------- BID
-
-/**
- * @brief  Serializes a message of a Bid request made by the client.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ClientBid::buildMessage() {
-	std::stringstream buffer;
-	char aid[4];
-	sprintf(aid, "%03d", auction_id);
-	buffer << protocol_code << " " << user_id << " " << password << " " << aid
-		   << " " << value << std::endl;
-	return buffer;
-}
-
-/**
- * @brief  Reads a message of a Bid request made by the client.
- * @retval None
- */
-void ClientBid::readMessage(MessageAdapter &buffer) {
-	readSpace(buffer);
-	user_id = readUserId(buffer);
-	readSpace(buffer);
-	password = readPassword(buffer);
-	readSpace(buffer);
-	auction_id = readAuctionId(buffer);
-	readSpace(buffer);
-	value = readAuctionValue(buffer);
-	readDelimiter(buffer);
-}
-
-/**
- * @brief  Serializes a message of a Bid answer made by the server.
- * @retval (stringstream) Serialized message
- */
-std::stringstream ServerBid::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << " ";
-	if (status == ServerBid::status::NOK) {
-		buffer << "NOK";
-	} else if (status == ServerBid::status::NLG) {
-		buffer << "NLG";
-	} else if (status == ServerBid::status::ACC) {
-		buffer << "ACC";
-	} else if (status == ServerBid::status::REF) {
-		buffer << "REF";
-	} else if (status == ServerBid::status::ILG) {
-		buffer << "ILG";
-	} else if (status == ServerBid::status::ERR) {
-		buffer << "ERR";
-	} else {
-		throw MessageBuildingException();
-	}
-	buffer << std::endl;
-	return buffer;
-}
-
 /**
- * @brief  Reads a message of a Bid answer made by the server.
+ * @brief  Reads a message of a Show Asset answer made by the server, through
+ * the concrete type of the adapter.
  * @retval None
  */
-void ServerBid::readMessage(MessageAdapter &buffer) {
-	readMessageId(buffer, ServerBid::protocol_code);
-	readSpace(buffer);
-	std::string status_str = readString(buffer, MAX_STATUS_SIZE);
-	if (status_str == "NOK") {
-		status = NOK;
-		readDelimiter(buffer);
-	} else if (status_str == "NLG") {
-		status = NLG;
-		readDelimiter(buffer);
-	} else if (status_str == "ACC") {
-		status = ACC;
-		readDelimiter(buffer);
-	} else if (status_str == "REF") {
-		status = REF;
-		readDelimiter(buffer);
-	} else if (status_str == "ILG") {
-		status = ILG;
-		readDelimiter(buffer);
-	} else if (status_str == "ERR") {
-		status = ERR;
-		readDelimiter(buffer);
-	} else {
-		throw InvalidMessageException();
-	}
+void ServerShowAsset::readMessage(MessageAdapter &buffer) {
+	visit_adapter(buffer, [this](auto &adapter) { readFields(adapter); });
 }
 
 // ---------- ERROR MESSAGE
 
 /**
  * @brief  Serializes a message of a err code answer made by the server.
- * @retval (stringstream) Serialized message
+ * @param  &writer: Where the message is written.
+ * @retval None
  */
-std::stringstream ServerError::buildMessage() {
-	std::stringstream buffer;
-	buffer << protocol_code << std::endl;
-	return buffer;
+void ServerError::buildMessage(MessageWriter &writer) {
+	writer << protocol_code << '\n';
 }
 
 /**
@@ -1170,6 +1388,52 @@ void ServerError::readMessage(MessageAdapter &buffer) {
 // | Send and receive messages		 |
 // -----------------------------------
 
+/**
+ * @brief  Prints the start of a message sent by the server.
+ * @param  &writer: The message.
+ * @retval None
+ */
+static void print_outgoing_message(MessageWriter &writer) {
+	std::string message_s = writer.str();
+	std::string extra = message_s.length() > 100 ? "...\n" : "";
+	std::cout << "\t[INFO] Outgoing Answer (first 100 characters):\n\t-> "
+			  << message_s.substr(0, 100) << extra << std::endl;
+}
+
+/**
+ * @brief  Sends the parts of a message through a socket until all of them are
+ * sent.
+ * @param  socket_fd: Socket file descriptor.
+ * @param  *iov: Parts of the message, changed as they are sent.
+ * @param  count: Number of parts.
+ * @param  flags: Flags of sendmsg().
+ * @throws MessageSendException
+ * @retval None
+ */
+static void send_iovecs(int socket_fd, struct iovec *iov, size_t count,
+                        int flags) {
+	struct msghdr header;
+	memset(&header, 0, sizeof(header));
+	while (count > 0) {
+		header.msg_iov = iov;
+		header.msg_iovlen = count;
+		ssize_t sent = sendmsg(socket_fd, &header, flags);
+		if (sent < 0) {
+			throw MessageSendException();
+		}
+		size_t left = static_cast<size_t>(sent);
+		while (count > 0 && left >= iov->iov_len) {
+			left -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+			iov->iov_len -= left;
+		}
+	}
+}
+
 /**
  * @brief Sends a message through a UDP socket.
  * @param  &message: message to send
@@ -1181,44 +1445,64 @@ void ServerError::readMessage(MessageAdapter &buffer) {
  */
 void send_udp_message(ProtocolMessage &message, int socketfd,
                       struct sockaddr *addr, socklen_t addrlen, bool verbose) {
-	const std::stringstream buffer = message.buildMessage();
-	ssize_t n = sendto(socketfd, buffer.str().c_str(), buffer.str().length(), 0,
-	                   addr, addrlen);
-	if (n == -1) {
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	message.buildMessage(writer);
+
+	struct iovec iov[MESSAGE_MAX_IOVECS];
+	struct msghdr header;
+	memset(&header, 0, sizeof(header));
+	header.msg_name = addr;
+	header.msg_namelen = addrlen;
+	header.msg_iov = iov;
+	header.msg_iovlen = writer.iovecs(iov);
+	if (sendmsg(socketfd, &header, 0) == -1) {
 		throw MessageSendException();
 	}
 	if (verbose) {
-		std::string extra = buffer.str().length() > 100 ? "...\n" : "";
-		std::cout << "\t[INFO] Outgoing Answer (first 100 characters):\n\t-> "
-				  << buffer.str().substr(0, 100) << extra << std::endl;
+		print_outgoing_message(writer);
 	}
 }
 
 /**
- * @brief  Sends a message through a TCP socket.
+ * @brief  Sends a message through a TCP socket. File data in the message is
+ * sent from where it is, without being copied.
  * @param  &message: message to be sent
  * @param  socket_fd: TCP socket file descriptor
  * @param  verbose: if true, prints the message to stdout (used on server only)
  * @retval None
  */
 void send_tcp_message(ProtocolMessage &message, int socket_fd, bool verbose) {
-	std::string message_s = message.buildMessage().str();
-	const char *message_str = message_s.data();
-	size_t bytes_to_send = message_s.length();
-	size_t bytes_sent = 0;
-	while (bytes_sent < bytes_to_send) {
-		ssize_t sent = write(socket_fd, message_str + bytes_sent,
-		                     (size_t) (bytes_to_send - bytes_sent));
-		if (sent < 0) {
-			throw MessageSendException();
-		}
-		bytes_sent += static_cast<size_t>(sent);
-	}
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	message.buildMessage(writer);
+
+	struct iovec iov[MESSAGE_MAX_IOVECS];
+	send_iovecs(socket_fd, iov, writer.iovecs(iov), 0);
 	if (verbose) {
-		std::string extra = message_s.length() > 100 ? "...\n" : "";
-		std::cout << "\t[INFO] Outgoing Answer (first 100 characters):\n\t-> "
-				  << message_s.substr(0, 100) << extra << std::endl;
+		print_outgoing_message(writer);
+	}
+}
+
+/**
+ * @brief  Sends many messages through TCP in one write, without waiting for
+ * their answers.
+ * @param  &messages: messages to send
+ * @param  socket_fd: TCP socket file descriptor
+ * @throws MessageSendException
+ * @retval None
+ */
+void send_tcp_messages(std::vector<ProtocolMessage *> &messages,
+                       int socket_fd) {
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	for (ProtocolMessage *message : messages) {
+		message->buildMessage(writer);
 	}
+
+	// A session closed by the peer fails the send instead of raising SIGPIPE
+	struct iovec iov[MESSAGE_MAX_IOVECS];
+	send_iovecs(socket_fd, iov, writer.iovecs(iov), MSG_NOSIGNAL);
 }
 
 /**
@@ -1244,7 +1528,6 @@ void await_udp_message(ProtocolMessage &message, int socketfd) {
 		throw MessageReceiveException();
 	}
 
-	std::stringstream data;
 	char buffer[UDP_SOCKET_BUFFER_LEN];
 
 	ssize_t n =
@@ -1253,9 +1536,8 @@ void await_udp_message(ProtocolMessage &message, int socketfd) {
 		throw MessageReceiveException();
 	}
 
-	data.write(buffer, n);
-	StreamMessage strm_message(data);
-	message.readMessage(strm_message);
+	BufferMessage buf_message(buffer, static_cast<size_t>(n));
+	message.readMessage(buf_message);
 }
 
 /**
@@ -1267,4 +1549,20 @@ void await_udp_message(ProtocolMessage &message, int socketfd) {
 void await_tcp_message(ProtocolMessage &message, int socketfd) {
 	TcpMessage tcp_message(socketfd);
 	message.readMessage(tcp_message);
-}
\ No newline at end of file
+}
+/**
+ * @brief  Reads the code at the start of a message, without copying it.
+ * @param  &message: adapter
+ * @retval The packed code, see pack_protocol_code. Bytes past the end of a
+ * shorter message are read as '\0'.
+ */
+uint32_t read_protocol_code(MessageAdapter &message) {
+	char code[PROTOCOL_SIZE];
+	for (size_t i = 0; i < PROTOCOL_SIZE; i++) {
+		code[i] = message.get();
+		if (!message.good()) {
+			code[i] = '\0';
+		}
+	}
+	return pack_protocol_code(std::string_view(code, PROTOCOL_SIZE));
+}
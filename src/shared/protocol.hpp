@@ -8,12 +8,16 @@
  */
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <cstring>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "config.hpp"
@@ -57,8 +61,26 @@
 #define CODE_BID_CLIENT "BID"
 #define CODE_BID_SERVER "RBD"
 
+#define CODE_SESSION_CLIENT "SES"
+#define CODE_SESSION_SERVER "RSE"
+
 #define CODE_ERROR "ERR"
 
+/**
+ * @brief  Packs a protocol code in an integer, so that codes are compared and
+ * switched on as a whole.
+ * @param  code: Protocol code.
+ * @retval The packed code, 0 if it doesn't have PROTOCOL_SIZE characters.
+ */
+constexpr uint32_t pack_protocol_code(std::string_view code) {
+	if (code.size() != PROTOCOL_SIZE) {
+		return 0;
+	}
+	return static_cast<uint32_t>(static_cast<unsigned char>(code[0])) |
+	       (static_cast<uint32_t>(static_cast<unsigned char>(code[1])) << 8) |
+	       (static_cast<uint32_t>(static_cast<unsigned char>(code[2])) << 16);
+}
+
 // -----------------------------------
 // | Exceptions                      |
 // -----------------------------------
@@ -128,6 +150,12 @@ class ConnectionTimeoutException : public std::runtime_error {
 // | Classes   	                     |
 // -----------------------------------
 
+// Concrete types of adapters, see visit_adapter
+#define ADAPTER_VIRTUAL 0  // Read through the virtual functions only
+#define ADAPTER_STREAM  1
+#define ADAPTER_BUFFER  2
+#define ADAPTER_TCP     3
+
 /**
  * @brief  This class is an adapter that generalizes the reading of messages. It
  * gives an interface that is common between reading from a TCP socket or a
@@ -135,11 +163,24 @@ class ConnectionTimeoutException : public std::runtime_error {
  * can be used independently of the type of message.
  */
 class MessageAdapter {
+   protected:
+	std::string _token;  // Holds the last token if it isn't in place
+	int _type;
+
    public:
+	MessageAdapter(int type = ADAPTER_VIRTUAL) : _type(type){};
+	int type() {
+		return _type;
+	};
 	virtual char get() = 0;
 	virtual bool good() = 0;
 	virtual void unget() = 0;
 	virtual std::string getn(int n) = 0;
+	// Writes the next n bytes to a file instead of returning them
+	virtual void copyTo(int fd, size_t n) = 0;
+	// Takes the bytes up to the next space or delimiter, valid until the next
+	// call
+	virtual std::string_view getToken(size_t max_len);
 };
 
 /**
@@ -147,12 +188,13 @@ class MessageAdapter {
  * reading a UDP message from a stringstream. The methods used almost correspond
  * to those of the stringstream.
  */
-class StreamMessage : public MessageAdapter {
+class StreamMessage final : public MessageAdapter {
    private:
 	std::stringstream &_stream;
 
    public:
-	StreamMessage(std::stringstream &stream) : _stream(stream){};
+	StreamMessage(std::stringstream &stream)
+		: MessageAdapter(ADAPTER_STREAM), _stream(stream){};
 	char get() {
 		return (char) _stream.get();
 	};
@@ -169,54 +211,76 @@ class StreamMessage : public MessageAdapter {
 		_stream.read(&str[0], n);
 		return str;
 	}
+	void copyTo(int fd, size_t n);
 };
 
 /**
  * @brief  This class is the specification of the Adapter for the case of
- * reading a TCP message from the socket. The methods used read directly from
- * the socket or from a buffer that is used to simulate the behaviour of a
- * stringstream.
+ * reading a message received whole, such as a UDP datagram. The message is
+ * read in place, without being copied, so it must outlive the adapter.
  */
-class TcpMessage : public MessageAdapter {
+class BufferMessage final : public MessageAdapter {
    private:
-	int _fd;
-	std::vector<char> _buffer;
-	char _last;
-	bool _read = false;
+	std::string_view _data;
+	size_t _pos = 0;
+	bool _good = true;
 
    public:
-	TcpMessage(int fd) : _fd(fd){};
-	void fillBuffer() {
-		char buf[SOCKET_BUFFER_LEN];
-		ssize_t n = read(_fd, &buf, SOCKET_BUFFER_LEN);
-
-		if (n > 0 && !_read) {
-			_read = true;
+	BufferMessage(const char *data, size_t len)
+		: MessageAdapter(ADAPTER_BUFFER), _data(data, len){};
+	char get() {
+		if (_pos == _data.size()) {
+			_good = false;
+			return '\0';
 		}
-
-		if (n <= 0 && _read) {
-			throw InvalidMessageException();
+		return _data[_pos++];
+	};
+	bool good() {
+		return _good;
+	};
+	void unget() {
+		if (_good && _pos > 0) {
+			_pos--;
 		}
+	};
+	std::string getn(int n);
+	void copyTo(int fd, size_t n);
+	std::string_view getToken(size_t max_len);
+};
 
-		if (n <= 0 && !_read) {
-			throw MessageReceiveException();
-		}
+/**
+ * @brief  This class is the specification of the Adapter for the case of
+ * reading a TCP message from the socket. The bytes are read from the socket a
+ * large block at a time into a contiguous buffer, from which they are taken in
+ * order, one at a time or many at once.
+ */
+class TcpMessage final : public MessageAdapter {
+   private:
+	int _fd;
+	std::vector<char> _buffer;
+	size_t _start = 0;  // Next byte to take
+	size_t _end = 0;    // End of the bytes read
+	size_t _read_len;   // Bytes read from the socket at once
+	bool _read = false;
+	bool _delimited = false;  // Whether the last character read ended a message
 
-		// The vector is filled in reverse order so that the pop_back() method
-		// retrieves the next character from the beginning of the message.
-		for (ssize_t i = n - 1; i >= 0; i--) {
-			_buffer.push_back(buf[i]);
-		}
-	}
+	ssize_t readSocket();
+
+   public:
+	TcpMessage(int fd, size_t read_len = TCP_READ_BUFFER_LEN)
+		: MessageAdapter(ADAPTER_TCP),
+		  _fd(fd),
+		  _buffer(read_len),
+		  _read_len(read_len){};
+	void fillBuffer();
 
 	char get() {
-		if (_buffer.size() == 0) {
+		if (_start == _end) {
 			fillBuffer();
 		}
-		_last = _buffer.back();
-		_buffer.pop_back();
-
-		return _last;
+		char c = _buffer[_start++];
+		_delimited = c == '\n';
+		return c;
 	};
 
 	bool good() {
@@ -224,50 +288,358 @@ class TcpMessage : public MessageAdapter {
 	};
 
 	void unget() {
-		_buffer.push_back(_last);
+		// The last byte taken is still in the buffer
+		_start--;
+		_delimited = false;
 	};
 
-	std::string getn(int n) {
-		std::string str;
-		for (int i = 0; i < n; i++) {
-			str.push_back(get());
+	std::string_view peek();
+	void consume(size_t n);
+	std::string getn(int n);
+	void copyTo(int fd, size_t n);
+	std::string_view getToken(size_t max_len);
+
+	/**
+	 * @brief  Discards what is left of a message that wasn't read up to its
+	 * delimiter, so that the next message is read from its beginning.
+	 */
+	void skipMessage() {
+		while (!_delimited) {
+			get();
 		}
-		return str;
 	}
+
+	bool closed();
+};
+
+/**
+ * @brief  Calls a function with an adapter as its concrete type, so that the
+ * reads made through it are resolved at compile time and the byte accesses
+ * inlined. Adapters of other types are passed as they are and read through
+ * their virtual functions.
+ * @param  &buffer: adapter
+ * @param  &&function: Called with the adapter.
+ * @retval None
+ */
+template <typename Function>
+void visit_adapter(MessageAdapter &buffer, Function &&function) {
+	switch (buffer.type()) {
+		case ADAPTER_STREAM:
+			function(static_cast<StreamMessage &>(buffer));
+			break;
+		case ADAPTER_BUFFER:
+			function(static_cast<BufferMessage &>(buffer));
+			break;
+		case ADAPTER_TCP:
+			function(static_cast<TcpMessage &>(buffer));
+			break;
+		default:
+			function(buffer);
+			break;
+	}
+}
+
+/**
+ * @brief  A number written with leading zeros up to a width, such as the id of
+ * an auction.
+ */
+class ZeroPadded {
+   public:
+	uint64_t number;
+	size_t width;
+};
+
+/**
+ * @brief  This class serializes a message into a buffer given by the caller,
+ * large enough for any message but those with file data. Numbers are formatted
+ * in place. File data isn't copied, it is sent from where it is in the iovecs
+ * of the message, so it must outlive the writer. If the buffer gets full, the
+ * message moves to a string.
+ */
+class MessageWriter {
+   private:
+	char *_data;
+	size_t _capacity;
+	size_t _len = 0;
+	std::string _overflow;
+	std::string_view _payloads[MESSAGE_MAX_PAYLOADS];
+	size_t _payload_at[MESSAGE_MAX_PAYLOADS];  // Bytes written before each
+	size_t _payload_count = 0;
+	size_t _payload_len = 0;
+
+	void reserve(size_t n);
+
+   public:
+	MessageWriter(char *buffer, size_t capacity)
+		: _data(buffer), _capacity(capacity){};
+	MessageWriter &operator<<(char c);
+	MessageWriter &operator<<(std::string_view text);
+	MessageWriter &operator<<(const char *text);
+	MessageWriter &operator<<(uint32_t number);
+	MessageWriter &operator<<(uint64_t number);
+	MessageWriter &operator<<(ZeroPadded padded);
+	MessageWriter &operator<<(const Datetime &date);
+	void writePayload(std::string_view payload);
+
+	size_t size();
+	size_t iovecs(struct iovec *iov);
+	void appendTo(std::string &out);
+	std::string str();
 };
 
+template <bool ReadsId, typename... Fields>
+class MessageSchema;
+
 /**
  * @brief  This class is the generalization of a Protocol Message. It specifies
  * all the methods required to read a message properly given a message adapter.
  * It also specifies the methods to build a message and to read it.
  */
 class ProtocolMessage {
+	template <bool ReadsId, typename... Fields>
+	friend class MessageSchema;
+
    protected:
-	char readChar(MessageAdapter &buffer);
-	void readChar(MessageAdapter &buffer, char chr);
-	bool readCharEqual(MessageAdapter &buffer, char chr);
-	void readMessageId(MessageAdapter &buffer, std::string protocol_code);
-	void readSpace(MessageAdapter &buffer);
-	void readDelimiter(MessageAdapter &buffer);
-	std::string readString(MessageAdapter &buffer, uint32_t max_len);
-	uint32_t readUserId(MessageAdapter &buffer);
-	uint32_t readAuctionId(MessageAdapter &buffer);
-	uint32_t readAuctionValue(MessageAdapter &buffer);
-	std::string readPassword(MessageAdapter &buffer);
-	std::string readAuctionAndState(MessageAdapter &buffer);
-	bool checkIfOver(MessageAdapter &buffer);
-	Datetime readDate(MessageAdapter &buffer);
+	/**
+	 * @brief  Reads a character from the buffer.
+	 * @param  &buffer: adapter
+	 * @throws InvalidMessageException
+	 * @retval char
+	 */
+	template <typename Adapter>
+	char readChar(Adapter &buffer) {
+		char c = buffer.get();
+		if (!buffer.good()) {
+			throw InvalidMessageException();
+		}
+		return c;
+	};
+
+	/**
+	 * @brief  Reads a character from the buffer and compares it to a given
+	 * char, expecting them to be equal.
+	 * @param  &buffer: adapter
+	 * @throws InvalidMessageException
+	 * @retval None
+	 */
+	template <typename Adapter>
+	void readChar(Adapter &buffer, char c) {
+		if (readChar(buffer) != c) {
+			throw InvalidMessageException();
+		}
+	};
+
+	/**
+	 * @brief  Reads a character from the buffer and compares it to a given
+	 * char, leaving it to read if they aren't equal.
+	 * @param  &buffer: adapter
+	 * @retval true if equal, false otherwise
+	 */
+	template <typename Adapter>
+	bool readCharEqual(Adapter &buffer, char c) {
+		if (readChar(buffer) != c) {
+			buffer.unget();
+			return false;
+		}
+		return true;
+	};
+
+	/**
+	 * @brief  Reads a space from the buffer.
+	 * @param  &buffer: adapter
+	 * @retval None
+	 */
+	template <typename Adapter>
+	void readSpace(Adapter &buffer) {
+		readChar(buffer, ' ');
+	};
+
+	/**
+	 * @brief  Reads a delimiter ('\n') from the buffer.
+	 * @param  &buffer: adapter
+	 * @retval None
+	 */
+	template <typename Adapter>
+	void readDelimiter(Adapter &buffer) {
+		readChar(buffer, '\n');
+	};
+
+	/**
+	 * @brief  Reads a token of a maximum size from the buffer, without copying
+	 * it if the adapter can help it. The function will stop reading when it
+	 * finds a space or a delimiter, even if it is below the max length.
+	 * @param  &buffer: adapter
+	 * @throws InvalidMessageException
+	 * @retval token read, valid until the next read
+	 */
+	template <typename Adapter>
+	std::string_view readToken(Adapter &buffer, uint32_t max_len) {
+		return buffer.getToken(max_len);
+	};
+
+	// Defined for every adapter in protocol.cpp
+	template <typename Adapter>
+	void readMessageId(Adapter &buffer, std::string protocol_code);
+	template <typename Adapter>
+	std::string readString(Adapter &buffer, uint32_t max_len);
+	template <typename Adapter>
+	uint32_t readUserId(Adapter &buffer);
+	template <typename Adapter>
+	uint32_t readAuctionId(Adapter &buffer);
+	template <typename Adapter>
+	uint32_t readAuctionValue(Adapter &buffer);
+	template <typename Adapter>
+	std::string readPassword(Adapter &buffer);
+	template <typename Adapter>
+	std::string readAuctionAndState(Adapter &buffer);
+	template <typename Adapter>
+	bool checkIfOver(Adapter &buffer);
+	template <typename Adapter>
+	Datetime readDate(Adapter &buffer);
 	void parseDate(Datetime date, std::string date_str);
-	std::string readFile(MessageAdapter &buffer, uint32_t max_len);
+	template <typename Adapter>
+	std::string readFile(Adapter &buffer, uint32_t max_len);
 
    public:
-	// Creates a string stream with the formatted message
-	virtual std::stringstream buildMessage() = 0;
+	// Writes the formatted message
+	virtual void buildMessage(MessageWriter &writer) = 0;
 
 	// Fills the instance of the class with data from read from the adapter
 	virtual void readMessage(MessageAdapter &buffer) = 0;
 };
 
+// -----------------------------------
+// | Message schemas				 |
+// -----------------------------------
+
+// Types of the fields a message can be described with
+enum class FieldType { UserId, Password, AuctionId, AuctionValue, Status };
+
+/**
+ * @brief  Field of a message, preceded by a space on the wire. Member points to
+ * the member of the message holding it. A status is written as the word at its
+ * index in the status_names of the message.
+ */
+template <FieldType Type, auto Member>
+class Field {
+   public:
+	static constexpr FieldType type = Type;
+	static constexpr auto member = Member;
+};
+
+template <auto Member>
+using UserIdField = Field<FieldType::UserId, Member>;
+template <auto Member>
+using PasswordField = Field<FieldType::Password, Member>;
+template <auto Member>
+using AuctionIdField = Field<FieldType::AuctionId, Member>;
+template <auto Member>
+using AuctionValueField = Field<FieldType::AuctionValue, Member>;
+template <auto Member>
+using StatusField = Field<FieldType::Status, Member>;
+
+/**
+ * @brief  Layout of a message made of fields of fixed types only: its code,
+ * the fields in order and the delimiter. The parser and the serializer of the
+ * message are generated from it at compile time, a read or a write per field
+ * with no branching on the type of the field. Messages sent to the server
+ * don't read their code, the server reads it to find the message.
+ */
+template <bool ReadsId, typename... Fields>
+class MessageSchema {
+	template <typename F, typename Message, typename Adapter>
+	static void readField(Message &message, ProtocolMessage &base,
+	                      Adapter &buffer) {
+		auto &value = message.*F::member;
+		base.readSpace(buffer);
+		if constexpr (F::type == FieldType::UserId) {
+			value = base.readUserId(buffer);
+		} else if constexpr (F::type == FieldType::Password) {
+			value = base.readPassword(buffer);
+		} else if constexpr (F::type == FieldType::AuctionId) {
+			value = base.readAuctionId(buffer);
+		} else if constexpr (F::type == FieldType::AuctionValue) {
+			value = base.readAuctionValue(buffer);
+		} else {
+			using Status = std::remove_reference_t<decltype(value)>;
+			std::string_view word = base.readToken(buffer, MAX_STATUS_SIZE);
+			for (size_t i = 0; i < std::size(Message::status_names); i++) {
+				if (word == Message::status_names[i]) {
+					value = static_cast<Status>(i);
+					return;
+				}
+			}
+			throw InvalidMessageException();
+		}
+	}
+
+	template <typename F, typename Message>
+	static void writeField(Message &message, MessageWriter &writer) {
+		const auto &value = message.*F::member;
+		writer << ' ';
+		if constexpr (F::type == FieldType::AuctionId) {
+			writer << ZeroPadded{value, AUCTION_ID_SIZE};
+		} else if constexpr (F::type == FieldType::Status) {
+			size_t i = static_cast<size_t>(value);
+			if (i >= std::size(Message::status_names)) {
+				throw MessageBuildingException();
+			}
+			writer << Message::status_names[i];
+		} else {
+			writer << value;
+		}
+	}
+
+	template <typename Message, typename Adapter>
+	static void readFields(Message &message, Adapter &buffer) {
+		ProtocolMessage &base = message;
+		if constexpr (ReadsId) {
+			base.readMessageId(buffer, message.protocol_code);
+		}
+		(readField<Fields>(message, base, buffer), ...);
+		base.readDelimiter(buffer);
+	}
+
+   public:
+	/**
+	 * @brief  Reads the fields of a message, through the concrete type of the
+	 * adapter.
+	 * @param  &message: Message to fill.
+	 * @param  &buffer: adapter
+	 * @throws InvalidMessageException
+	 * @throws UnexpectedMessageException
+	 * @retval None
+	 */
+	template <typename Message>
+	static void read(Message &message, MessageAdapter &buffer) {
+		visit_adapter(buffer, [&message](auto &adapter) {
+			readFields(message, adapter);
+		});
+	}
+
+	/**
+	 * @brief  Serializes a message.
+	 * @param  &message: Message to serialize.
+	 * @param  &writer: Where the message is written.
+	 * @throws MessageBuildingException
+	 * @retval None
+	 */
+	template <typename Message>
+	static void build(Message &message, MessageWriter &writer) {
+		writer << message.protocol_code;
+		(writeField<Fields>(message, writer), ...);
+		writer << '\n';
+	}
+};
+
+// Schema of a message sent to the server
+template <typename... Fields>
+using RequestSchema = MessageSchema<false, Fields...>;
+
+// Schema of a message sent to the client
+template <typename... Fields>
+using AnswerSchema = MessageSchema<true, Fields...>;
+
 // -----------------------------------
 // | Client Messages for each command |
 // -----------------------------------
@@ -282,8 +654,15 @@ class ClientLoginUser : public ProtocolMessage {
 	uint32_t user_id;
 	std::string password;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<UserIdField<&ClientLoginUser::user_id>,
+	                             PasswordField<&ClientLoginUser::password>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -296,8 +675,15 @@ class ClientLogout : public ProtocolMessage {
 	uint32_t user_id;
 	std::string password;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<UserIdField<&ClientLogout::user_id>,
+	                             PasswordField<&ClientLogout::password>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -310,8 +696,15 @@ class ClientUnregister : public ProtocolMessage {
 	uint32_t user_id;
 	std::string password;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<UserIdField<&ClientUnregister::user_id>,
+	                             PasswordField<&ClientUnregister::password>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -324,8 +717,15 @@ class ClientListStartedAuctions : public ProtocolMessage {
 	std::string protocol_code = CODE_LIST_AUC_USER;
 	uint32_t user_id;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema =
+		RequestSchema<UserIdField<&ClientListStartedAuctions::user_id>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -337,8 +737,15 @@ class ClientListBiddedAuctions : public ProtocolMessage {
 	std::string protocol_code = CODE_LIST_MYB_USER;
 	uint32_t user_id;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema =
+		RequestSchema<UserIdField<&ClientListBiddedAuctions::user_id>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -350,8 +757,14 @@ class ClientListAllAuctions : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_LIST_ALLAUC_USER;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -363,8 +776,14 @@ class ClientShowRecord : public ProtocolMessage {
 	std::string protocol_code = CODE_SHOWREC_USER;
 	uint32_t auction_id;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<AuctionIdField<&ClientShowRecord::auction_id>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -372,6 +791,11 @@ class ClientShowRecord : public ProtocolMessage {
  * Message sent by the client to the server representing a open auction command.
  */
 class ClientOpenAuction : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+	template <typename Adapter>
+	void readHeaderFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_OPEN_AUC_CLIENT;
 	uint32_t user_id;
@@ -383,8 +807,10 @@ class ClientOpenAuction : public ProtocolMessage {
 	size_t Fsize;
 	std::string fdata;
 
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
+	void readHeader(MessageAdapter &buffer);
+	void readAsset(MessageAdapter &buffer, int fd);
 };
 
 /**
@@ -399,8 +825,17 @@ class ClientCloseAuction : public ProtocolMessage {
 	std::string password;
 	uint32_t auction_id;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema =
+		RequestSchema<UserIdField<&ClientCloseAuction::user_id>,
+	                  PasswordField<&ClientCloseAuction::password>,
+	                  AuctionIdField<&ClientCloseAuction::auction_id>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -412,8 +847,14 @@ class ClientShowAsset : public ProtocolMessage {
 	std::string protocol_code = CODE_SHOW_ASSET_CLIENT;
 	uint32_t auction_id;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<AuctionIdField<&ClientShowAsset::auction_id>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -428,8 +869,36 @@ class ClientBid : public ProtocolMessage {
 	uint32_t auction_id;
 	uint32_t value;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = RequestSchema<UserIdField<&ClientBid::user_id>,
+	                             PasswordField<&ClientBid::password>,
+	                             AuctionIdField<&ClientBid::auction_id>,
+	                             AuctionValueField<&ClientBid::value>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
+};
+
+/**
+ * @brief  Open Session (SES) -> TCP
+ * Message sent by the client to keep the TCP connection open for the next
+ * requests. Their answers are sent in the same order as the requests.
+ */
+class ClientOpenSession : public ProtocolMessage {
+   public:
+	std::string protocol_code = CODE_SESSION_CLIENT;
+
+	using Schema = RequestSchema<>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 // ------------------------------------
@@ -445,10 +914,19 @@ class ServerLoginUser : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_LOGIN_SERVER;
 	enum status { OK, NOK, REG, ERR };
+	static constexpr std::string_view status_names[] = {
+		"OK", "NOK", "REG", "ERR"};
 
 	status status;
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+
+	using Schema = AnswerSchema<StatusField<&ServerLoginUser::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -460,10 +938,19 @@ class ServerLogout : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_LOGOUT_SERVER;
 	enum status { OK, NOK, UNR, ERR };
+	static constexpr std::string_view status_names[] = {
+		"OK", "NOK", "UNR", "ERR"};
 
 	status status;
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+
+	using Schema = AnswerSchema<StatusField<&ServerLogout::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -475,10 +962,19 @@ class ServerUnregister : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_UNREGISTER_SERVER;
 	enum status { OK, NOK, UNR, ERR };
+	static constexpr std::string_view status_names[] = {
+		"OK", "NOK", "UNR", "ERR"};
 
 	status status;
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+
+	using Schema = AnswerSchema<StatusField<&ServerUnregister::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -487,13 +983,16 @@ class ServerUnregister : public ProtocolMessage {
  * Auctions command.
  */
 class ServerListStartedAuctions : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_LIST_AUC_SERVER;
 	enum status { OK, NOK, NLG, ERR };
 	std::vector<std::string> auctions;
 
 	status status;
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -503,13 +1002,16 @@ class ServerListStartedAuctions : public ProtocolMessage {
  * Bids command.
  */
 class ServerListBiddedAuctions : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_LIST_MYB_SERVER;
 	enum status { OK, NOK, NLG, ERR };
 	std::vector<std::string> auctions;
 
 	status status;
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -519,13 +1021,16 @@ class ServerListBiddedAuctions : public ProtocolMessage {
  * All Auctions command.
  */
 class ServerListAllAuctions : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_LIST_ALLAUC_SERVER;
 	enum status { OK, NOK, ERR };
 	std::vector<std::string> auctions;
 
 	status status;
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -535,6 +1040,9 @@ class ServerListAllAuctions : public ProtocolMessage {
  * Record command.
  */
 class ServerShowRecord : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_SHOWREC_SERVER;
 	enum status { OK, NOK, ERR };
@@ -549,7 +1057,7 @@ class ServerShowRecord : public ProtocolMessage {
 	uint32_t end_sec_time = 0;
 	status status;
 
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -559,13 +1067,16 @@ class ServerShowRecord : public ProtocolMessage {
  * Auction command.
  */
 class ServerOpenAuction : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_OPEN_AUC_SERVER;
 	enum status { OK, NOK, NLG, ERR };
 	uint32_t auction_id;
 	status status;
 
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -578,10 +1089,18 @@ class ServerCloseAuction : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_CLOSE_AUC_SERVER;
 	enum status { OK, NLG, EAU, EOW, END, ERR, NOK };
+	static constexpr std::string_view status_names[] = {
+		"OK", "NLG", "EAU", "EOW", "END", "ERR", "NOK"};
 	status status;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = AnswerSchema<StatusField<&ServerCloseAuction::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -590,6 +1109,9 @@ class ServerCloseAuction : public ProtocolMessage {
  * Asset command.
  */
 class ServerShowAsset : public ProtocolMessage {
+	template <typename Adapter>
+	void readFields(Adapter &buffer);
+
    public:
 	std::string protocol_code = CODE_SHOW_ASSET_SERVER;
 	enum status { OK, NOK, ERR };
@@ -598,7 +1120,8 @@ class ServerShowAsset : public ProtocolMessage {
 	std::string fdata;
 	status status;
 
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
+	void buildHeader(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -611,10 +1134,40 @@ class ServerBid : public ProtocolMessage {
    public:
 	std::string protocol_code = CODE_BID_SERVER;
 	enum status { NOK, NLG, ACC, REF, ILG, ERR };
+	static constexpr std::string_view status_names[] = {
+		"NOK", "NLG", "ACC", "REF", "ILG", "ERR"};
 	status status;
 
-	std::stringstream buildMessage();
-	void readMessage(MessageAdapter &buffer);
+	using Schema = AnswerSchema<StatusField<&ServerBid::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
+};
+
+/**
+ * @brief Open Session (RSE) -> TCP
+ * Message sent by the server to the client representing the answer to an Open
+ * Session command.
+ */
+class ServerOpenSession : public ProtocolMessage {
+   public:
+	std::string protocol_code = CODE_SESSION_SERVER;
+	enum status { OK, ERR };
+	static constexpr std::string_view status_names[] = {"OK", "ERR"};
+	status status;
+
+	using Schema = AnswerSchema<StatusField<&ServerOpenSession::status>>;
+
+	void buildMessage(MessageWriter &writer) {
+		Schema::build(*this, writer);
+	};
+	void readMessage(MessageAdapter &buffer) {
+		Schema::read(*this, buffer);
+	};
 };
 
 /**
@@ -628,7 +1181,7 @@ class ServerError : public ProtocolMessage {
 	enum status { ERR };
 	status status = ERR;
 
-	std::stringstream buildMessage();
+	void buildMessage(MessageWriter &writer);
 	void readMessage(MessageAdapter &buffer);
 };
 
@@ -641,5 +1194,7 @@ void send_udp_message(ProtocolMessage &message, int socket,
                       bool verbose);
 void await_udp_message(ProtocolMessage &Message, int socketfd);
 void send_tcp_message(ProtocolMessage &message, int socketfd, bool verbose);
+void send_tcp_messages(std::vector<ProtocolMessage *> &messages, int socketfd);
 void await_tcp_message(ProtocolMessage &Message, int socketfd);
+uint32_t read_protocol_code(MessageAdapter &message);
 #endif
\ No newline at end of file
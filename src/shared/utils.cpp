@@ -1,5 +1,7 @@
 #include "utils.hpp"
 
+#include <charconv>
+
 #include "protocol.hpp"
 
 // -----------------------------------
@@ -32,17 +34,33 @@ std::string extractTime(Datetime datetime) {
 // | Convert types					 |
 // -----------------------------------
 
+/**
+ * @brief  Parses a decimal number, without copying it.
+ * @param  string: The digits of the number.
+ * @throws InvalidMessageException if it isn't only digits or doesn't fit.
+ * @retval The number.
+ */
+static uint32_t parse_number(std::string_view string) {
+	uint32_t number = 0;
+	const char *end = string.data() + string.size();
+	std::from_chars_result result = std::from_chars(string.data(), end, number);
+	if (result.ec != std::errc() || result.ptr != end) {
+		throw InvalidMessageException();
+	}
+	return number;
+}
+
 /**
  * @brief  Converts a user id in the form of a string into a uint32_t.
  * @param  string: The user id to convert.
  * @throws InvalidMessageException if the user id isn't valid.
  * @retval The user id as a uint32_t.
  */
-uint32_t convert_user_id(std::string string) {
+uint32_t convert_user_id(std::string_view string) {
 	if (verify_user_id(string) == -1) {
 		throw InvalidMessageException();
 	}
-	return (static_cast<uint32_t>(std::stol(string)));
+	return parse_number(string);
 }
 
 /**
@@ -63,11 +81,11 @@ std::string convert_user_id_to_str(uint32_t uid) {
  * @throws InvalidMessageException if the auction id isn't valid.
  * @retval The auction id as a uint32_t.
  */
-uint32_t convert_auction_id(std::string string) {
+uint32_t convert_auction_id(std::string_view string) {
 	if (verify_auction_id(string) == -1) {
 		throw InvalidMessageException();
 	}
-	return (static_cast<uint32_t>(std::stoi(string)));
+	return parse_number(string);
 }
 
 /**
@@ -88,8 +106,8 @@ std::string convert_auction_id_to_str(uint32_t aid) {
  * @throws InvalidMessageException if the value isn't valid.
  * @retval The value as a uint32_t.
  */
-uint32_t convert_auction_value(std::string string) {
-	uint32_t value = static_cast<uint32_t>(std::stol(string));
+uint32_t convert_auction_value(std::string_view string) {
+	uint32_t value = parse_number(string);
 	if (verify_value(value) == -1) {
 		throw InvalidMessageException();
 	}
@@ -102,11 +120,11 @@ uint32_t convert_auction_value(std::string string) {
  * @throws InvalidMessageException if the ppassword isn't valid.
  * @retval The verified password.
  */
-std::string convert_password(std::string string) {
+std::string convert_password(std::string_view string) {
 	if (verify_password(string) == -1) {
 		throw InvalidMessageException();
 	}
-	return string;
+	return std::string(string);
 }
 
 /**
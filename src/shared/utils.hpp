@@ -10,6 +10,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 
 #include "verifications.hpp"
 
@@ -53,12 +54,12 @@ std::string extractTime(Datetime datetime);
 // | Convert types					 |
 // -----------------------------------
 
-uint32_t convert_user_id(std::string string);
+uint32_t convert_user_id(std::string_view string);
 std::string convert_user_id_to_str(uint32_t uid);
-uint32_t convert_auction_id(std::string string);
+uint32_t convert_auction_id(std::string_view string);
 std::string convert_auction_id_to_str(uint32_t aid);
-uint32_t convert_auction_value(std::string string);
-std::string convert_password(std::string string);
+uint32_t convert_auction_value(std::string_view string);
+std::string convert_password(std::string_view string);
 std::string convert_date_to_str(Datetime date);
 Datetime convert_str_to_date(std::string str);
 
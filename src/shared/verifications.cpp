@@ -8,27 +8,80 @@
 
 #include "config.hpp"
 
+// Character classes, as bits of char_classes
+#define CHAR_DIGIT 0x01  // 0-9
+#define CHAR_ALNUM 0x02  // 0-9, A-Z and a-z
+#define CHAR_PRINT 0x04  // Printable characters, space included
+#define CHAR_FNAME 0x08  // Characters of file names, alnum and '-', '_', '.'
+
+/**
+ * @brief  Classes of a character in the C locale.
+ * @param  c: The character.
+ * @retval The classes, as CHAR_* bits.
+ */
+static constexpr uint8_t classify_char(int c) {
+	bool digit = c >= '0' && c <= '9';
+	bool alpha = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+	uint8_t classes = 0;
+	if (digit) {
+		classes |= CHAR_DIGIT;
+	}
+	if (digit || alpha) {
+		classes |= CHAR_ALNUM | CHAR_FNAME;
+	}
+	if (c == '-' || c == '_' || c == '.') {
+		classes |= CHAR_FNAME;
+	}
+	if (c >= ' ' && c <= '~') {
+		classes |= CHAR_PRINT;
+	}
+	return classes;
+}
+
+/**
+ * @brief  Table of the classes of every byte, built when compiling.
+ */
+static constexpr struct CharClasses {
+	uint8_t of[256];
+
+	constexpr CharClasses() : of() {
+		for (int c = 0; c < 256; c++) {
+			of[c] = classify_char(c);
+		}
+	}
+} char_classes;
+
+/**
+ * @brief  Checks if every character of a string is of a class. The classes
+ * are looked up in a table and combined without branching, so the loop is
+ * unrolled for the fixed sizes of ids and passwords.
+ * @param  str: The string.
+ * @param  class_bit: One of the CHAR_* bits.
+ * @retval true if every character is of the class.
+ */
+static inline bool all_of_class(std::string_view str, uint8_t class_bit) {
+	uint8_t classes = class_bit;
+	for (char c : str) {
+		classes &= char_classes.of[static_cast<unsigned char>(c)];
+	}
+	return classes != 0;
+}
+
 /**
  * @brief  Checks if the given user id fits the required parameters.
  * @param  user_id: The user id.
  * @retval -1 if it doesn't fit the parameters.
  * @retval 0 if it fits the parameters.
  */
-int verify_user_id(std::string user_id) {
+int verify_user_id(std::string_view user_id) {
 	if (user_id.size() != 6) {
 		return -1;
 	}
 
-	if (user_id == "000000") {
+	if (user_id == "000000" || !all_of_class(user_id, CHAR_DIGIT)) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < 6; i++) {
-		if (!isdigit(user_id[i])) {
-			return -1;
-		}
-	}
-
 	return 0;
 }
 
@@ -38,15 +91,13 @@ int verify_user_id(std::string user_id) {
  * @retval -1 if it doesn't fit the parameters.
  * @retval 0 if it fits the parameters.
  */
-int verify_password(std::string password) {
+int verify_password(std::string_view password) {
 	if (password.size() != 8) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < 8; i++) {
-		if (isalnum(password[i]) == false) {
-			return -1;
-		}
+	if (!all_of_class(password, CHAR_ALNUM)) {
+		return -1;
 	}
 
 	return 0;
@@ -58,15 +109,10 @@ int verify_password(std::string password) {
  * @retval -1 if it doesn't fit the parameters.
  * @retval 0 if it fits the parameters.
  */
-int verify_name(std::string name) {
-	if (name.size() > MAX_FILENAME_SIZE) {
+int verify_name(std::string_view name) {
+	if (name.size() > MAX_FILENAME_SIZE || !all_of_class(name, CHAR_PRINT)) {
 		return -1;
 	}
-	for (size_t i = 0; i < name.size(); i++) {
-		if (isprint(name[i]) == false) {
-			return -1;
-		}
-	}
 
 	return 0;
 }
@@ -97,7 +143,8 @@ int verify_asset_fname(std::string asset_path) {
 	std::string assetf_name =
 		asset_path.substr(asset_path.find_last_of("/\\") + 1);
 
-	if (assetf_name.size() > MAX_FILENAME_SIZE) {
+	if (assetf_name.size() > MAX_FILENAME_SIZE ||
+	    !all_of_class(assetf_name, CHAR_FNAME)) {
 		return -1;
 	}
 
@@ -128,10 +175,8 @@ int verify_start_value(std::string start_value) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < start_value.size(); i++) {
-		if (isdigit(start_value[i]) == false) {
-			return -1;
-		}
+	if (!all_of_class(start_value, CHAR_DIGIT)) {
+		return -1;
 	}
 
 	return 0;
@@ -152,10 +197,8 @@ int verify_timeactive(std::string timeactive) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < timeactive.size(); i++) {
-		if (isdigit(timeactive[i]) == false) {
-			return -1;
-		}
+	if (!all_of_class(timeactive, CHAR_DIGIT)) {
+		return -1;
 	}
 
 	return 0;
@@ -167,15 +210,13 @@ int verify_timeactive(std::string timeactive) {
  * @retval -1 if it doesn't fit the parameters.
  * @retval 0 if it fits the parameters.
  */
-int verify_auction_id(std::string a_id) {
+int verify_auction_id(std::string_view a_id) {
 	if (a_id.size() != 3) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < 3; i++) {
-		if (isdigit(a_id[i]) == false) {
-			return -1;
-		}
+	if (!all_of_class(a_id, CHAR_DIGIT)) {
+		return -1;
 	}
 
 	return 0;
@@ -214,4 +255,29 @@ int verify_port_number(std::string &port) {
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+/**
+ * @brief  Checks if a numeric command line option is a number between 1 and
+ * max.
+ * @param  &option: The option value.
+ * @param  max: Largest value accepted.
+ * @retval -1 if it doesn't fit the parameters.
+ * @retval 0 if it fits the parameters.
+ */
+int verify_count_option(std::string &option, int max) {
+	if (option.empty() || option.size() > 9) {
+		return -1;
+	}
+	for (char c : option) {
+		if (!std::isdigit(static_cast<unsigned char>(c))) {
+			return -1;
+		}
+	}
+
+	int32_t parsed = std::stoi(option);
+	if (parsed <= 0 || parsed > max) {
+		return -1;
+	}
+
+	return 0;
+}
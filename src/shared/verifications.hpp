@@ -8,18 +8,20 @@
  */
 
 #include <string>
+#include <string_view>
 
 // All the functions responsible for verifying whther an input is correctly
 // formatted.
-int verify_user_id(std::string user_id);
-int verify_password(std::string password);
-int verify_name(std::string name);
+int verify_user_id(std::string_view user_id);
+int verify_password(std::string_view password);
+int verify_name(std::string_view name);
 int check_fname_not_forbidden(std::string fname);
 int verify_asset_fname(std::string asset_fname);
 int verify_start_value(std::string start_value);
 int verify_timeactive(std::string timeactive);
-int verify_auction_id(std::string a_id);
+int verify_auction_id(std::string_view a_id);
 int verify_value(uint32_t value);
 int verify_port_number(std::string &port);
+int verify_count_option(std::string &option, int max);
 
 #endif
\ No newline at end of file
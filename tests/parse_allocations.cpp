@@ -0,0 +1,94 @@
+/**
+ * @file parse_allocations.cpp
+ * @brief Checks that parsing the small UDP requests from a received datagram
+ * doesn't allocate: the fields are taken as string_views in place through
+ * BufferMessage::getToken and ProtocolMessage::readToken. Every allocation of
+ * the program goes through a counting operator new.
+ */
+#include <string.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "shared/protocol.hpp"
+#include "test.hpp"
+
+#define PARSES 1000
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+	allocations++;
+	void *memory = malloc(size);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, size_t size) noexcept {
+	(void) size;
+	free(memory);
+}
+
+static int failures = 0;
+
+/**
+ * @brief  Parses a request as the UDP workers do, from its code, a number of
+ * times and checks that no allocation was made.
+ * @param  *datagram: The request, as received.
+ * @retval None
+ */
+template <typename Message>
+static void check_parse(const char *datagram) {
+	size_t before = allocations;
+	for (int i = 0; i < PARSES; i++) {
+		BufferMessage buffer(datagram, strlen(datagram));
+		read_protocol_code(buffer);
+		Message message;
+		read_message(message, buffer);
+	}
+	size_t made = allocations - before;
+	printf("%s %.3s: %zu allocations in %d parses\n",
+	       made == 0 ? "OK  " : "FAIL", datagram, made, PARSES);
+	if (made != 0) {
+		failures++;
+	}
+}
+
+/**
+ * @brief  Takes every field of a message with getToken and checks that no
+ * allocation was made.
+ * @param  *datagram: The message.
+ * @retval None
+ */
+static void check_tokens(const char *datagram) {
+	size_t before = allocations;
+	size_t taken = 0;
+	for (int i = 0; i < PARSES; i++) {
+		BufferMessage buffer(datagram, strlen(datagram));
+		taken += buffer.getToken(PROTOCOL_SIZE).size();
+		while (buffer.get() == ' ') {
+			taken += buffer.getToken(MAX_FILENAME_SIZE).size();
+		}
+	}
+	size_t made = allocations - before;
+	printf("%s getToken: %zu allocations in %d messages\n",
+	       made == 0 && taken > 0 ? "OK  " : "FAIL", made, PARSES);
+	if (made != 0 || taken == 0) {
+		failures++;
+	}
+}
+
+int main() {
+	check_parse<ClientLoginUser>("LIN 100001 password\n");
+	check_parse<ClientListAllAuctions>("LST\n");
+	check_parse<ClientShowRecord>("SRC 001\n");
+	check_tokens("LIN 100001 password\n");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
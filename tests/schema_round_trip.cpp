@@ -0,0 +1,162 @@
+/**
+ * @file schema_round_trip.cpp
+ * @brief Checks the messages whose layout is generated from a MessageSchema
+ * against the wire format they had when they were written by hand: each
+ * request, and each answer with every one of its statuses, is built and
+ * compared byte for byte with the expected message, then read back and built
+ * again. Every field of these messages is written, so the second build only
+ * matches if each field was read back as it was.
+ */
+#include <string.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+
+#include "shared/protocol.hpp"
+#include "test.hpp"
+
+static int failures = 0;
+
+/**
+ * @brief  Builds a message.
+ * @param  &message: The message, with its fields set.
+ * @retval The message as sent.
+ */
+static std::string build_message(ProtocolMessage &message) {
+	char buffer[MESSAGE_BUFFER_LEN];
+	MessageWriter writer(buffer, sizeof(buffer));
+	message.buildMessage(writer);
+	return writer.str();
+}
+
+/**
+ * @brief  Prints the result of a check, counting it if it failed.
+ * @param  passed: Whether the check passed.
+ * @param  *wire: The message expected.
+ * @param  *step: What was checked.
+ * @param  &got: The message built.
+ * @retval None
+ */
+static void report(bool passed, const char *wire, const char *step,
+                   const std::string &got) {
+	std::string expected(wire, strlen(wire) - 1);
+	if (passed) {
+		printf("OK   %-28s %s\n", expected.c_str(), step);
+		return;
+	}
+	printf("FAIL %-28s %s: \"%s\"\n", expected.c_str(), step, got.c_str());
+	failures++;
+}
+
+/**
+ * @brief  Builds a message and compares it with its wire format, then reads
+ * the wire format back and builds it again. Requests are read from after
+ * their code, which the server reads first; answers read their own code.
+ * @param  &message: The message, with its fields set.
+ * @param  *wire: The message expected.
+ * @retval None
+ */
+template <typename Message>
+static void check_round_trip(Message &message, const char *wire) {
+	std::string built = build_message(message);
+	report(built == wire, wire, "build", built);
+
+	Message parsed;
+	std::string rebuilt;
+	try {
+		BufferMessage buffer(wire, strlen(wire));
+		if (message.protocol_code[0] != 'R') {
+			read_protocol_code(buffer);
+		}
+		read_message(parsed, buffer);
+		rebuilt = build_message(parsed);
+	} catch (...) {
+		rebuilt = "exception";
+	}
+	report(rebuilt == wire, wire, "read and build", rebuilt);
+}
+
+/**
+ * @brief  Checks an answer with each of its statuses.
+ * @param  wires: The answer expected with each status, in the order of the
+ * status enum.
+ * @retval None
+ */
+template <typename Message>
+static void check_statuses(std::initializer_list<const char *> wires) {
+	int status = 0;
+	for (const char *wire : wires) {
+		Message message;
+		message.status = static_cast<decltype(message.status)>(status++);
+		check_round_trip(message, wire);
+	}
+}
+
+int main() {
+	ClientLoginUser lin;
+	lin.user_id = 100001;
+	lin.password = "password";
+	check_round_trip(lin, "LIN 100001 password\n");
+
+	ClientLogout lou;
+	lou.user_id = 100001;
+	lou.password = "password";
+	check_round_trip(lou, "LOU 100001 password\n");
+
+	ClientUnregister unr;
+	unr.user_id = 123456;
+	unr.password = "abcd1234";
+	check_round_trip(unr, "UNR 123456 abcd1234\n");
+
+	ClientListStartedAuctions lma;
+	lma.user_id = 100001;
+	check_round_trip(lma, "LMA 100001\n");
+
+	ClientListBiddedAuctions lmb;
+	lmb.user_id = 999999;
+	check_round_trip(lmb, "LMB 999999\n");
+
+	ClientListAllAuctions lst;
+	check_round_trip(lst, "LST\n");
+
+	ClientShowRecord src;
+	src.auction_id = 7;
+	check_round_trip(src, "SRC 007\n");
+
+	ClientCloseAuction cls;
+	cls.user_id = 100001;
+	cls.password = "password";
+	cls.auction_id = 42;
+	check_round_trip(cls, "CLS 100001 password 042\n");
+
+	ClientShowAsset sas;
+	sas.auction_id = 999;
+	check_round_trip(sas, "SAS 999\n");
+
+	ClientBid bid;
+	bid.user_id = 100001;
+	bid.password = "password";
+	bid.auction_id = 7;
+	bid.value = 500;
+	check_round_trip(bid, "BID 100001 password 007 500\n");
+
+	ClientOpenSession ses;
+	check_round_trip(ses, "SES\n");
+
+	check_statuses<ServerLoginUser>(
+		{"RLI OK\n", "RLI NOK\n", "RLI REG\n", "RLI ERR\n"});
+	check_statuses<ServerLogout>(
+		{"RLO OK\n", "RLO NOK\n", "RLO UNR\n", "RLO ERR\n"});
+	check_statuses<ServerUnregister>(
+		{"RUR OK\n", "RUR NOK\n", "RUR UNR\n", "RUR ERR\n"});
+	check_statuses<ServerCloseAuction>({"RCL OK\n", "RCL NLG\n", "RCL EAU\n",
+	                                    "RCL EOW\n", "RCL END\n", "RCL ERR\n",
+	                                    "RCL NOK\n"});
+	check_statuses<ServerBid>({"RBD NOK\n", "RBD NLG\n", "RBD ACC\n",
+	                           "RBD REF\n", "RBD ILG\n", "RBD ERR\n"});
+	check_statuses<ServerOpenSession>({"RSE OK\n", "RSE ERR\n"});
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,26 @@
+#ifndef __TEST__
+#define __TEST__
+
+/**
+ * @file test.hpp
+ * @brief Helpers shared by the test programs.
+ */
+
+#include "shared/protocol.hpp"
+
+/**
+ * @brief  Reads a message through the adapter interface, as the handlers do
+ * from another translation unit. Inlined into a test, GCC follows the branches
+ * of visit_adapter for the adapters other than the one given, finds their
+ * reads out of bounds of it and warns (-Warray-bounds), which -Werror turns
+ * into an error.
+ * @param  &message: The message read.
+ * @param  &buffer: The adapter.
+ * @retval None
+ */
+__attribute__((noinline)) inline void read_message(ProtocolMessage &message,
+                                                   MessageAdapter &buffer) {
+	message.readMessage(buffer);
+}
+
+#endif